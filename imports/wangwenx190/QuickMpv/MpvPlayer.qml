@@ -926,6 +926,9 @@ Item {
         and \c MpvDeclarativeObject::Asynchronous.
 
         The default is \c MpvDeclarativeObject::Synchronous.
+
+        This only applies to commands and property reads. Property changes
+        are coalesced and always sent asynchronously, see \l beginUpdate().
     */
     property alias mpvCallType: mpvObject.mpvCallType
 
@@ -999,6 +1002,194 @@ Item {
     */
     property alias estimatedVfFps: mpvObject.estimatedVfFps
 
+    /*!
+        \qmlproperty enumeration MpvPlayer::memoryPriority
+
+        How much of the process-wide demuxer cache budget this player gets
+        compared to other players, one of \c MpvObject.Low, \c MpvObject.Normal
+        and \c MpvObject.High. Players that have the active focus always get the
+        biggest share and hidden players always get the smallest one.
+
+        The default is \c MpvObject.Normal.
+
+        \sa demuxerCacheLimit, demuxerCacheUsage
+    */
+    property alias memoryPriority: mpvObject.memoryPriority
+
+    /*!
+        \qmlproperty qlonglong MpvPlayer::demuxerCacheLimit
+
+        The demuxer cache size (forward and backward buffers together) in \b bytes
+        this player was given by the process-wide memory budget.
+    */
+    property alias demuxerCacheLimit: mpvObject.demuxerCacheLimit
+
+    /*!
+        \qmlproperty qlonglong MpvPlayer::demuxerCacheUsage
+
+        The amount of \b bytes the demuxer cache currently holds.
+    */
+    property alias demuxerCacheUsage: mpvObject.demuxerCacheUsage
+
+    /*!
+        \qmlproperty MpvPlaylistModel MpvPlayer::playlist
+
+        A read-only list model of the internal playlist. Roles: \c fileName,
+        \c url, \c title, \c current, \c playing and \c entryId.
+
+        Entries added with \l playlistAppend() are opened in the background
+        while the previous entry is still playing, so there is no gap between
+        them.
+    */
+    property alias playlist: mpvObject.playlist
+
+    /*!
+        \qmlproperty int MpvPlayer::playlistPos
+
+        Current position on the playlist. The first entry is on position \c 0.
+        Changing it starts playing the entry at the new position.
+    */
+    property alias playlistPos: mpvObject.playlistPos
+
+    /*!
+        \qmlproperty int MpvPlayer::playlistCount
+
+        Number of total playlist entries.
+    */
+    property alias playlistCount: mpvObject.playlistCount
+
+    /*!
+        \qmlproperty bool MpvPlayer::loopPlaylist
+
+        Loop the whole playlist forever.
+
+        The default is \c false.
+    */
+    property alias loopPlaylist: mpvObject.loopPlaylist
+
+    /*!
+        \qmlproperty int MpvPlayer::standbyCapacity
+
+        Maximum number of hidden standby players armed with \l armStandby().
+        Each one is a complete player instance, so keep this small.
+
+        The default is \c 2.
+    */
+    property alias standbyCapacity: mpvObject.standbyCapacity
+
+    /*!
+        \qmlproperty list<url> MpvPlayer::standbySources
+
+        Sources of all armed standby players, the most recently used last.
+    */
+    property alias standbySources: mpvObject.standbySources
+
+    /*!
+        \qmlproperty var MpvPlayer::loadTimings
+
+        Timeline of the most recent load, in milliseconds: \c startFile,
+        \c fileLoaded, \c videoReconfig, \c playbackRestart, \c firstFrame
+        and \c firstAudio, together with \c codec, \c container,
+        \c sourceType, \c url and \c complete. Phases that never happened are
+        missing. All loads are aggregated by the \c MpvLoadStatistics
+        singleton.
+    */
+    readonly property alias loadTimings: mpvObject.loadTimings
+
+    /*!
+        \qmlproperty int MpvPlayer::stallThreshold
+
+        Synchronous player calls taking longer than this (in milliseconds)
+        are logged, counted in \l stallStatistics() and reported through
+        \l stallDetected().
+
+        The default is \c 10.
+    */
+    property alias stallThreshold: mpvObject.stallThreshold
+
+    /*!
+        \qmlproperty bool MpvPlayer::autoAsync
+
+        If \c true, operations that stalled the GUI thread repeatedly switch
+        to asynchronous calls: commands and property writes are queued,
+        property reads return the last known value and refresh it in the
+        background.
+
+        The default is \c false.
+    */
+    property alias autoAsync: mpvObject.autoAsync
+
+    /*!
+        \qmlproperty bool MpvPlayer::scrubbing
+
+        \c true between \l beginScrub() and \l endScrub().
+    */
+    readonly property alias scrubbing: mpvObject.scrubbing
+
+    /*!
+        \qmlproperty bool MpvPlayer::backwardStepCache
+
+        Whether \l stepBack() uses mpv's backward playback mode, which
+        decodes whole keyframe ranges once and keeps their frames, so that
+        holding a "previous frame" key steps backwards at interactive rates
+        even on long-GOP material. Otherwise every step decodes from the
+        previous keyframe again.
+
+        The default is \c true.
+    */
+    property alias backwardStepCache: mpvObject.backwardStepCache
+
+    /*!
+        \qmlproperty int MpvPlayer::warmUpCount
+
+        Whenever a file has been loaded, the local files among the next
+        \c warmUpCount playlist entries are read ahead in the background
+        (see the \c MpvWarmUp singleton), so that they start without
+        waiting for cold storage.
+
+        The default is \c 0, which turns it off.
+    */
+    property alias warmUpCount: mpvObject.warmUpCount
+
+    /*!
+        \qmlproperty bool MpvPlayer::displaySync
+
+        Times the video to the refresh rate of the screen the player is
+        shown on instead of to the audio clock (\c video-sync is set to
+        \c display-resample), which removes the judder of repeated and
+        dropped frames. Every buffer swap of the window is reported to mpv
+        and the refresh rate of the screen is passed to it, also after the
+        window moved to another screen. The audio is resampled slightly to
+        stay in sync.
+
+        The default is \c false.
+    */
+    property alias displaySync: mpvObject.displaySync
+
+    /*!
+        \qmlproperty real MpvPlayer::vsyncJitter
+
+        How irregular the reported buffer swaps are, relative to the
+        refresh interval. Only measured while \c displaySync is on.
+    */
+    readonly property alias vsyncJitter: mpvObject.vsyncJitter
+
+    /*!
+        \qmlproperty int MpvPlayer::mistimedFrameCount
+
+        The number of frames shown for a different number of refreshes
+        than they should have been, while \c displaySync is on.
+    */
+    readonly property alias mistimedFrameCount: mpvObject.mistimedFrameCount
+
+    /*!
+        \qmlproperty int MpvPlayer::voDelayedFrameCount
+
+        The number of frames that reached the screen late, while
+        \c displaySync is on.
+    */
+    readonly property alias voDelayedFrameCount: mpvObject.voDelayedFrameCount
+
     /*!
         \qmlsignal MpvPlayer::initFinished()
 
@@ -1045,12 +1236,135 @@ Item {
     signal stopped
 
     /*!
-        \qmlmethod MpvPlayer::open(url)
+        \qmlsignal MpvPlayer::standbyReady(url url, real prepareTime)
+
+        This signal is emitted when the standby player of \a url has decoded
+        its first frame. \a prepareTime is the time it took since
+        \l armStandby() was called, in milliseconds.
+
+        The corresponding handler is \c onStandbyReady.
+    */
+    signal standbyReady(url url, real prepareTime)
+
+    /*!
+        \qmlsignal MpvPlayer::standbyFailed(url url)
+
+        This signal is emitted when the standby player of \a url failed to
+        open it.
+
+        The corresponding handler is \c onStandbyFailed.
+    */
+    signal standbyFailed(url url)
+
+    /*!
+        \qmlsignal MpvPlayer::standbyActivated(url url)
+
+        This signal is emitted when the standby player of \a url has been
+        swapped in and is visible now.
+
+        The corresponding handler is \c onStandbyActivated.
+    */
+    signal standbyActivated(url url)
+
+    /*!
+        \qmlsignal MpvPlayer::ready(real prepareTime)
+
+        This signal is emitted when media opened with options (see \l open())
+        is ready to be played. \a prepareTime is the time it took since
+        \l open() was called, in milliseconds, or \c -1 if the media
+        couldn't be loaded.
+
+        The corresponding handler is \c onReady.
+    */
+    signal ready(real prepareTime)
+
+    /*!
+        \qmlsignal MpvPlayer::frameGrabbed(int requestId, var image)
+
+        This signal is emitted when the frame requested by \l grabFrame() is
+        available. \a image is null if grabbing failed.
+
+        The corresponding handler is \c onFrameGrabbed.
+    */
+    signal frameGrabbed(int requestId, var image)
+
+    /*!
+        \qmlsignal MpvPlayer::frameCaptured(int captureId, string filePath, real position)
+
+        This signal is emitted for every still written by a capture started
+        with \l captureInterval(), \l captureBurst() or
+        \l captureSceneChanges(). \a position is in seconds.
+
+        The corresponding handler is \c onFrameCaptured.
+    */
+    signal frameCaptured(int captureId, string filePath, real position)
+
+    /*!
+        \qmlsignal MpvPlayer::captureFinished(int captureId, int frameCount, bool success)
+
+        This signal is emitted when a capture is done. \a success is
+        \c false if it was cancelled or any frame could not be written.
+
+        The corresponding handler is \c onCaptureFinished.
+    */
+    signal captureFinished(int captureId, int frameCount, bool success)
+
+    /*!
+        \qmlsignal MpvPlayer::stallDetected(string operation, string caller, real duration)
+
+        This signal is emitted after a synchronous call blocked for longer
+        than \l stallThreshold. \a duration is in milliseconds.
+
+        The corresponding handler is \c onStallDetected.
+    */
+    signal stallDetected(string operation, string caller, real duration)
+
+    /*!
+        \qmlsignal MpvPlayer::mpvError(string message)
+
+        This signal is emitted when the player logs a fatal error. Playback
+        is most likely broken, what to do about it is up to the
+        application. All log messages can be read back from the \c MpvLog
+        singleton.
+
+        The corresponding handler is \c onMpvError.
+    */
+    signal mpvError(string message)
+
+    /*!
+        \qmlmethod MpvPlayer::open(url, options)
 
         Load the given \a url and start the playback immediately.
+
+        \a options is optional and may contain:
+
+        \table
+        \header
+            \li Option
+            \li Description
+        \row
+            \li startPaused
+            \li Load the media but don't start the playback.
+        \row
+            \li prerollSeconds
+            \li Read at least this many seconds into the cache before the
+                media is reported as ready.
+        \endtable
+
+        If any option is given, \l ready() is emitted once the media is loaded,
+        its first frame is shown and the requested amount of data is cached, so
+        that \l play() starts within one frame:
+
+        \qml
+        mpvPlayer.open("clip.mp4", {startPaused: true, prerollSeconds: 2})
+        \endqml
     */
-    function open(url) {
-        mpvObject.open(url);
+    function open(url, options) {
+        if (options === undefined) {
+            mpvObject.open(url);
+        } else {
+            mpvObject.open(url, options);
+        }
     }
 
     /*!
@@ -1152,6 +1466,323 @@ Item {
         mpvObject.screenshotToFile(path);
     }
 
+    /*!
+        \qmlmethod MpvPlayer::playlistAppend(url)
+
+        Append \a url to the end of the playlist. If nothing is being played,
+        playback starts with it.
+    */
+    function playlistAppend(url) {
+        return mpvObject.playlistAppend(url);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::playlistAppendList(urls)
+
+        Append all \a urls to the end of the playlist.
+    */
+    function playlistAppendList(urls) {
+        return mpvObject.playlistAppendList(urls);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::playlistRemove(index)
+
+        Remove the playlist entry at \a index.
+    */
+    function playlistRemove(index) {
+        return mpvObject.playlistRemove(index);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::playlistMove(from, to)
+
+        Move the playlist entry at \a from to \a to.
+    */
+    function playlistMove(from, to) {
+        return mpvObject.playlistMove(from, to);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::playlistClear()
+
+        Remove every playlist entry except the currently playing one.
+    */
+    function playlistClear() {
+        return mpvObject.playlistClear();
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::playlistNext()
+
+        Go to the next entry of the playlist.
+    */
+    function playlistNext() {
+        return mpvObject.playlistNext();
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::playlistPrev()
+
+        Go to the previous entry of the playlist.
+    */
+    function playlistPrev() {
+        return mpvObject.playlistPrev();
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::playlistPlay(index)
+
+        Start playing the playlist entry at \a index.
+    */
+    function playlistPlay(index) {
+        return mpvObject.playlistPlay(index);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::armStandby(url)
+
+        Open \a url paused on a hidden standby player, so that its first frame
+        is decoded and its cache is filled before it's needed. Can only be used
+        after \l initFinished() has been emitted.
+
+        \sa activateStandby(), standbyCapacity
+    */
+    function armStandby(url) {
+        return mpvObject.armStandby(url);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::disarmStandby(url)
+
+        Drop the standby player of \a url.
+    */
+    function disarmStandby(url) {
+        return mpvObject.disarmStandby(url);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::isStandbyReady(url)
+
+        Returns \c true if the standby player of \a url has decoded its first
+        frame.
+    */
+    function isStandbyReady(url) {
+        return mpvObject.isStandbyReady(url);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::activateStandby(url)
+
+        Show the standby player of \a url instead of the current media. The
+        switch happens on the next frame. The media that was shown before
+        becomes a standby player itself, so switching back is just as fast.
+    */
+    function activateStandby(url) {
+        return mpvObject.activateStandby(url);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::thumbnailSource(position)
+
+        Returns an image url showing the current media at \a position (in
+        seconds), meant for seek bar previews:
+
+        \code
+        Image {
+            source: player.thumbnailSource(hoveredPosition)
+        }
+        \endcode
+
+        Thumbnails are decoded in the background and cached, see the
+        \c MpvThumbnailEngine singleton.
+    */
+    function thumbnailSource(position) {
+        return mpvObject.thumbnailSource(position);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::grabFrame(mode)
+
+        Grab the current frame into memory, without writing an image file.
+        \a mode is \c "video" (the default), \c "subtitles" or \c "window".
+        Returns a request id, the image arrives through \l frameGrabbed()
+        with the same id. Returns \c -1 if nothing is being played.
+    */
+    function grabFrame(mode) {
+        return mpvObject.grabFrame(mode === undefined ? "video" : mode);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::captureInterval(interval, options)
+
+        Write a still of the current media every \a interval seconds, in the
+        background. The files follow \l screenshotFormat,
+        \l screenshotJpegQuality, \l screenshotTemplate and
+        \l screenshotDirectory unless \a options overrides them (keys
+        \c format, \c jpegQuality, \c pngCompression, \c template,
+        \c directory), \c start and \c end limit the time range. Returns a
+        capture id, or \c -1 on failure.
+    */
+    function captureInterval(interval, options) {
+        return mpvObject.captureInterval(interval, options === undefined ? {} : options);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::captureBurst(position, framesBefore, framesAfter, options)
+
+        Write \a framesBefore + 1 + \a framesAfter consecutive frames around
+        \a position (in seconds). See \l captureInterval() for \a options.
+    */
+    function captureBurst(position, framesBefore, framesAfter, options) {
+        return mpvObject.captureBurst(position, framesBefore, framesAfter,
+                                      options === undefined ? {} : options);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::captureSceneChanges(threshold, options)
+
+        Write one still per scene change. \a threshold (0.0-1.0, default
+        0.3) is the scene change score. See \l captureInterval() for
+        \a options.
+    */
+    function captureSceneChanges(threshold, options) {
+        return mpvObject.captureSceneChanges(threshold === undefined ? 0.3 : threshold,
+                                             options === undefined ? {} : options);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::cancelCapture(captureId)
+
+        Stop the given capture. Stills that have been written are kept.
+    */
+    function cancelCapture(captureId) {
+        mpvObject.cancelCapture(captureId);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::metricsSnapshot()
+
+        Returns what the wrapper itself costs for this player: synchronous
+        property reads and the time they blocked, property changes per
+        property, event queue drains, asynchronous requests in flight and
+        render passes. Use the \c MpvMetrics singleton for all players of
+        the process at once.
+    */
+    function metricsSnapshot() {
+        return mpvObject.metricsSnapshot();
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::stallStatistics()
+
+        Returns every operation that stalled at least once, the one that
+        blocked the longest in total first, with its caller, the number of
+        slow calls, their total and maximum time in milliseconds and
+        whether it has been switched to asynchronous calls.
+    */
+    function stallStatistics() {
+        return mpvObject.stallStatistics();
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::resetStallStatistics()
+
+        Forgets all stalls, operations switched by \l autoAsync go back to
+        synchronous calls.
+    */
+    function resetStallStatistics() {
+        mpvObject.resetStallStatistics();
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::beginUpdate()
+
+        Starts a transaction: property changes made until the matching
+        \l commitUpdate() are sent to mpv together, and only the last value
+        of each property is sent. Transactions can be nested.
+
+        Methods that send commands, such as \l seek() or \l open(), are not
+        part of the transaction. They take effect right away, after the
+        property changes made before them.
+
+        Property changes are coalesced until the end of the current event
+        loop iteration even without a transaction, so binding a slider to
+        \l volume costs at most one write per frame.
+    */
+    function beginUpdate() {
+        mpvObject.beginUpdate();
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::commitUpdate()
+
+        Ends the transaction started by \l beginUpdate().
+    */
+    function commitUpdate() {
+        mpvObject.commitUpdate();
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::setProperties(properties)
+
+        Sets all the given mpv properties (a map of mpv property names to
+        values) within one transaction. Returns \c false if any of them is
+        invalid.
+    */
+    function setProperties(properties) {
+        return mpvObject.setProperties(properties);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::beginScrub()
+
+        Starts interactive seeking, typically when a seek bar is pressed.
+    */
+    function beginScrub() {
+        return mpvObject.beginScrub();
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::scrubTo(position)
+
+        Seeks to \a position (in seconds) while scrubbing. At most one fast
+        keyframe seek is in flight, positions that arrive in the meantime
+        replace each other and only the latest one is sent, so the picture
+        follows the handle instead of lagging behind it.
+    */
+    function scrubTo(position) {
+        return mpvObject.scrubTo(position);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::endScrub()
+
+        Ends scrubbing with one exact seek to the last position.
+    */
+    function endScrub() {
+        return mpvObject.endScrub();
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::stepFrames(frames)
+
+        Pauses and shows the frame \a frames frames ahead of the current one.
+    */
+    function stepFrames(frames) {
+        return mpvObject.stepFrames(frames === undefined ? 1 : frames);
+    }
+
+    /*!
+        \qmlmethod MpvPlayer::stepBack(frames)
+
+        Pauses and shows the frame \a frames frames before the current one,
+        see \l backwardStepCache.
+    */
+    function stepBack(frames) {
+        return mpvObject.stepBack(frames === undefined ? 1 : frames);
+    }
+
     /*!
         \qmlmethod MpvPlayer::isPlaying()
 
@@ -1187,5 +1818,14 @@ Item {
         onPlaying: mpvPlayer.playing()
         onPaused: mpvPlayer.paused()
         onStopped: mpvPlayer.stopped()
+        onStandbyReady: mpvPlayer.standbyReady(url, prepareTime)
+        onStandbyFailed: mpvPlayer.standbyFailed(url)
+        onStandbyActivated: mpvPlayer.standbyActivated(url)
+        onReady: mpvPlayer.ready(prepareTime)
+        onFrameGrabbed: mpvPlayer.frameGrabbed(requestId, image)
+        onFrameCaptured: mpvPlayer.frameCaptured(captureId, filePath, position)
+        onCaptureFinished: mpvPlayer.captureFinished(captureId, frameCount, success)
+        onStallDetected: mpvPlayer.stallDetected(operation, caller, duration)
+        onMpvError: mpvPlayer.mpvError(message)
     }
 }
@@ -32,7 +32,48 @@ win32: !mingw {
     CONFIG += link_pkgconfig
     PKGCONFIG += mpv
 }
-HEADERS += mpvobject.h mpvqthelper.hpp
-SOURCES += mpvobject.cpp plugin.cpp
+HEADERS += \
+    mpvobject.h \
+    mpvqthelper.hpp \
+    mpvmemorybudget.h \
+    mpvplaylistmodel.h \
+    mpvhistogram.hpp \
+    mpvloadstatistics.h \
+    mpvheadlessplayer.h \
+    mpvthumbnailengine.h \
+    mpvthumbnailprovider.h \
+    mpvspritesheetcache.h \
+    mpvframecapture.h \
+    mpvframetap.h \
+    mpvstatsoverlay.h \
+    mpvmetrics.h \
+    mpvlog.h \
+    mpvtracer.h \
+    mpvstreamsource.h \
+    mpvwarmup.h \
+    mpvmediaprobe.h \
+    mpvmediascanner.h \
+    mpvplaybackgroup.h
+SOURCES += \
+    mpvobject.cpp \
+    plugin.cpp \
+    mpvmemorybudget.cpp \
+    mpvplaylistmodel.cpp \
+    mpvloadstatistics.cpp \
+    mpvheadlessplayer.cpp \
+    mpvthumbnailengine.cpp \
+    mpvthumbnailprovider.cpp \
+    mpvspritesheetcache.cpp \
+    mpvframecapture.cpp \
+    mpvframetap.cpp \
+    mpvstatsoverlay.cpp \
+    mpvmetrics.cpp \
+    mpvlog.cpp \
+    mpvtracer.cpp \
+    mpvstreamsource.cpp \
+    mpvwarmup.cpp \
+    mpvmediaprobe.cpp \
+    mpvmediascanner.cpp \
+    mpvplaybackgroup.cpp
 uri = wangwenx190.QuickMpv
 include(qmlplugin.pri)
@@ -0,0 +1,371 @@
+#include "mpvframecapture.h"
+#include "mpvheadlessplayer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QPointer>
+#include <QThread>
+#include <QTime>
+
+namespace {
+
+constexpr int captureTimeout = 30000;
+// Scene changes may be minutes apart.
+constexpr int sceneChangeTimeout = 120000;
+
+} // namespace
+
+MpvFrameCapture::MpvFrameCapture(QObject *parent) : QObject(parent) {
+    decoderPool.setMaxThreadCount(2);
+    // Leave one core to playback.
+    encoderPool.setMaxThreadCount(qMax(QThread::idealThreadCount() - 1, 1));
+}
+
+MpvFrameCapture::~MpvFrameCapture() {
+    {
+        QMutexLocker locker(&mutex);
+        for (auto &&capture : std::as_const(captures)) {
+            capture->cancelled = true;
+        }
+    }
+    decoderPool.clear();
+    decoderPool.waitForDone();
+    encoderPool.waitForDone();
+}
+
+MpvFrameCapture *MpvFrameCapture::instance() {
+    static QPointer<MpvFrameCapture> capture;
+    if (capture.isNull()) {
+        capture = new MpvFrameCapture(QCoreApplication::instance());
+    }
+    return capture;
+}
+
+int MpvFrameCapture::encoderThreads() const {
+    return encoderPool.maxThreadCount();
+}
+
+int MpvFrameCapture::activeCaptures() const {
+    QMutexLocker locker(&mutex);
+    return captures.count();
+}
+
+void MpvFrameCapture::setEncoderThreads(int encoderThreads) {
+    encoderThreads = qMax(encoderThreads, 1);
+    if (encoderThreads == encoderPool.maxThreadCount()) {
+        return;
+    }
+    encoderPool.setMaxThreadCount(encoderThreads);
+    Q_EMIT encoderThreadsChanged();
+}
+
+int MpvFrameCapture::captureInterval(const QUrl &source, qreal interval,
+                                     const QVariantMap &options) {
+    if (interval <= 0.0) {
+        return -1;
+    }
+    auto capture = CapturePtr::create();
+    capture->mode = Mode::Interval;
+    capture->source = source;
+    capture->parameter = interval;
+    return startCapture(capture, options);
+}
+
+int MpvFrameCapture::captureBurst(const QUrl &source, qreal position,
+                                  int framesBefore, int framesAfter,
+                                  const QVariantMap &options) {
+    if ((framesBefore < 0) || (framesAfter < 0)) {
+        return -1;
+    }
+    auto capture = CapturePtr::create();
+    capture->mode = Mode::Burst;
+    capture->source = source;
+    capture->parameter = qMax(position, 0.0);
+    capture->framesBefore = framesBefore;
+    capture->framesAfter = framesAfter;
+    return startCapture(capture, options);
+}
+
+int MpvFrameCapture::captureSceneChanges(const QUrl &source, qreal threshold,
+                                         const QVariantMap &options) {
+    if ((threshold <= 0.0) || (threshold >= 1.0)) {
+        return -1;
+    }
+    auto capture = CapturePtr::create();
+    capture->mode = Mode::SceneChange;
+    capture->source = source;
+    capture->parameter = threshold;
+    return startCapture(capture, options);
+}
+
+void MpvFrameCapture::cancel(int captureId) {
+    QMutexLocker locker(&mutex);
+    const CapturePtr capture = captures.value(captureId);
+    if (!capture.isNull()) {
+        capture->cancelled = true;
+    }
+}
+
+int MpvFrameCapture::startCapture(const CapturePtr &capture,
+                                  const QVariantMap &options) {
+    if (!capture->source.isValid()) {
+        return -1;
+    }
+    const QString format = options.value(QString::fromUtf8("format"))
+                               .toString()
+                               .toLower();
+    if (format == QString::fromUtf8("png")) {
+        capture->format = format;
+        // Qt maps 0-100 onto zlib's levels 9-0.
+        const int compression = qBound(
+            0,
+            options.value(QString::fromUtf8("pngCompression"), 7).toInt(), 9);
+        capture->quality = 100 - ((compression * 100) / 9);
+    } else {
+        capture->format = (format == QString::fromUtf8("webp"))
+            ? format
+            : QString::fromUtf8("jpg");
+        capture->quality = qBound(
+            0, options.value(QString::fromUtf8("jpegQuality"), 90).toInt(),
+            100);
+    }
+    capture->fileNameTemplate =
+        options.value(QString::fromUtf8("template")).toString();
+    if (capture->fileNameTemplate.isEmpty()) {
+        capture->fileNameTemplate = QString::fromUtf8("mpv-shot%n");
+    } else if (!capture->fileNameTemplate.contains(
+                   QString::fromUtf8("%n"))) {
+        capture->fileNameTemplate += QString::fromUtf8("-%n");
+    }
+    capture->directory =
+        options.value(QString::fromUtf8("directory")).toString();
+    if (capture->directory.isEmpty()) {
+        capture->directory = QDir::currentPath();
+    }
+    if (!QDir().mkpath(capture->directory)) {
+        qWarning().noquote()
+            << "Failed to create the capture directory:" << capture->directory;
+        return -1;
+    }
+    capture->start =
+        qMax(options.value(QString::fromUtf8("start"), 0.0).toReal(), 0.0);
+    capture->end = options.value(QString::fromUtf8("end"), -1.0).toReal();
+    {
+        QMutexLocker locker(&mutex);
+        capture->id = ++captureSerial;
+        captures.insert(capture->id, capture);
+    }
+    decoderPool.start([this, capture]() { decode(capture); });
+    Q_EMIT activeCapturesChanged();
+    return capture->id;
+}
+
+void MpvFrameCapture::decode(const CapturePtr &capture) {
+    // Full size frames, the stills are the product here.
+    MpvHeadlessPlayer player;
+    if (capture->mode == Mode::SceneChange) {
+        // Every frame that isn't the first one of a new scene is dropped
+        // by the filter, so each frame step lands on the next scene.
+        player.setProperty(
+            "vf", QString::fromUtf8("lavfi=[select='gt(scene,%1)']")
+                      .arg(capture->parameter));
+    }
+    if (!player.load(capture->source, captureTimeout)) {
+        capture->failed = true;
+    } else {
+        switch (capture->mode) {
+        case Mode::Interval:
+            decodeInterval(capture, player);
+            break;
+        case Mode::Burst:
+            decodeBurst(capture, player);
+            break;
+        case Mode::SceneChange:
+            decodeSceneChanges(capture, player);
+            break;
+        }
+    }
+    release(capture);
+}
+
+void MpvFrameCapture::decodeInterval(const CapturePtr &capture,
+                                     MpvHeadlessPlayer &player) {
+    const qreal duration = player.property("duration").toReal();
+    const qreal end = (capture->end < 0.0) ? duration
+                                           : qMin(capture->end, duration);
+    for (qreal position = capture->start; position <= end;
+         position += capture->parameter) {
+        if (!player.seek(position, false, captureTimeout)) {
+            capture->failed = true;
+            continue;
+        }
+        if (!enqueue(capture, player)) {
+            return;
+        }
+    }
+}
+
+void MpvFrameCapture::decodeBurst(const CapturePtr &capture,
+                                  MpvHeadlessPlayer &player) {
+    qreal fps = player.property("container-fps").toReal();
+    if (fps <= 0.0) {
+        fps = 25.0;
+    }
+    const qreal first =
+        qMax(capture->parameter - (capture->framesBefore / fps), 0.0);
+    if (!player.seek(first, false, captureTimeout)) {
+        capture->failed = true;
+        return;
+    }
+    const int frameCount = capture->framesBefore + 1 + capture->framesAfter;
+    for (int frame = 0; frame != frameCount; ++frame) {
+        if (!enqueue(capture, player)) {
+            return;
+        }
+        // Running into the end of the file is not an error.
+        if (((frame + 1) != frameCount) && !player.frameStep(captureTimeout)) {
+            return;
+        }
+    }
+}
+
+void MpvFrameCapture::decodeSceneChanges(const CapturePtr &capture,
+                                         MpvHeadlessPlayer &player) {
+    // Completes as soon as the first scene change at or after the start has
+    // made it through the filter.
+    if (!player.seek(capture->start, false, sceneChangeTimeout)) {
+        return;
+    }
+    while (true) {
+        const qreal position = player.property("time-pos").toReal();
+        if ((capture->end >= 0.0) && (position > capture->end)) {
+            return;
+        }
+        if (!enqueue(capture, player)) {
+            return;
+        }
+        if (!player.frameStep(sceneChangeTimeout)) {
+            return;
+        }
+    }
+}
+
+bool MpvFrameCapture::enqueue(const CapturePtr &capture,
+                              MpvHeadlessPlayer &player) {
+    // Backpressure: don't decode further ahead than the encoders can keep
+    // up with.
+    while (!queueSpace.tryAcquire(1, 100)) {
+        if (capture->cancelled) {
+            return false;
+        }
+    }
+    if (capture->cancelled) {
+        queueSpace.release();
+        return false;
+    }
+    const QImage image = player.grab();
+    const qreal position = player.property("time-pos").toReal();
+    if (image.isNull()) {
+        queueSpace.release();
+        capture->failed = true;
+        return true;
+    }
+    const int sequence = ++capture->sequence;
+    const QString filePath = capture->directory + QChar::fromLatin1('/') +
+        expandTemplate(capture->fileNameTemplate, capture->source, sequence,
+                       position) +
+        QChar::fromLatin1('.') + capture->format;
+    ++capture->outstanding;
+    encoderPool.start([this, capture, image, filePath, position]() {
+        if (!capture->cancelled) {
+            if (image.save(filePath, capture->format.toLatin1().constData(),
+                           capture->quality)) {
+                ++capture->written;
+                const int captureId = capture->id;
+                QMetaObject::invokeMethod(
+                    this,
+                    [this, captureId, filePath, position]() {
+                        Q_EMIT frameCaptured(captureId, filePath, position);
+                    },
+                    Qt::QueuedConnection);
+            } else {
+                qWarning().noquote() << "Failed to write:" << filePath;
+                capture->failed = true;
+            }
+        }
+        queueSpace.release();
+        release(capture);
+    });
+    return true;
+}
+
+void MpvFrameCapture::release(const CapturePtr &capture) {
+    if (--capture->outstanding != 0) {
+        return;
+    }
+    {
+        QMutexLocker locker(&mutex);
+        captures.remove(capture->id);
+    }
+    const int captureId = capture->id;
+    const int frameCount = capture->written;
+    const bool success = !capture->failed && !capture->cancelled;
+    QMetaObject::invokeMethod(
+        this,
+        [this, captureId, frameCount, success]() {
+            Q_EMIT activeCapturesChanged();
+            Q_EMIT captureFinished(captureId, frameCount, success);
+        },
+        Qt::QueuedConnection);
+}
+
+QString MpvFrameCapture::expandTemplate(const QString &fileNameTemplate,
+                                        const QUrl &source, int sequence,
+                                        qreal position) {
+    const QString fileName = source.isLocalFile()
+        ? QFileInfo(source.toLocalFile()).fileName()
+        : source.fileName();
+    const QTime time =
+        QTime::fromMSecsSinceStartOfDay(qRound(qMax(position, 0.0) * 1000.0));
+    QString result;
+    result.reserve(fileNameTemplate.size() + fileName.size());
+    for (int i = 0; i < fileNameTemplate.size(); ++i) {
+        const QChar character = fileNameTemplate.at(i);
+        if ((character != QChar::fromLatin1('%')) ||
+            ((i + 1) >= fileNameTemplate.size())) {
+            result += character;
+            continue;
+        }
+        const char specifier = fileNameTemplate.at(++i).toLatin1();
+        switch (specifier) {
+        case 'F':
+            result += QFileInfo(fileName).completeBaseName();
+            break;
+        case 'f':
+            result += fileName;
+            break;
+        case 'n':
+            result += QString::number(sequence).rightJustified(
+                4, QChar::fromLatin1('0'));
+            break;
+        case 'p':
+            result += time.toString(QString::fromUtf8("HH-mm-ss"));
+            break;
+        case 'P':
+            result += time.toString(QString::fromUtf8("HH-mm-ss.zzz"));
+            break;
+        case '%':
+            result += QChar::fromLatin1('%');
+            break;
+        default:
+            // Everything else is left alone, like mpv does.
+            result += character;
+            result += fileNameTemplate.at(i);
+            break;
+        }
+    }
+    return result;
+}
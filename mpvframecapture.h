@@ -0,0 +1,131 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QUrl>
+#include <QVariant>
+#include <atomic>
+
+class MpvHeadlessPlayer;
+
+// Exports stills of a file in the background: one every N seconds, a burst
+// of frames around a position, or one per scene change. Frames are decoded
+// by a headless player of their own, so the visible players never stall,
+// and encoded to image files on a bounded thread pool. Decoding waits
+// whenever too many frames are queued for encoding, which keeps memory
+// usage flat no matter how many stills are written.
+class MpvFrameCapture : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvFrameCapture)
+
+    Q_PROPERTY(int encoderThreads READ encoderThreads WRITE setEncoderThreads
+                   NOTIFY encoderThreadsChanged)
+    Q_PROPERTY(int activeCaptures READ activeCaptures NOTIFY
+                   activeCapturesChanged)
+
+public:
+    explicit MpvFrameCapture(QObject *parent = nullptr);
+    ~MpvFrameCapture() override;
+
+    static MpvFrameCapture *instance();
+
+    // Maximum number of images encoded in parallel.
+    int encoderThreads() const;
+    int activeCaptures() const;
+
+    void setEncoderThreads(int encoderThreads);
+
+    // Maximum number of decoded frames waiting for an encoder.
+    static constexpr int queueLimit = 8;
+
+public Q_SLOTS:
+    // All capture functions return a capture id, or -1 if the arguments are
+    // unusable. Supported options, mirroring mpv's screenshot options:
+    // format (string): "png", "jpg" or "webp", defaults to "jpg".
+    // jpegQuality (int): 0-100, also used for WebP, defaults to 90.
+    // pngCompression (int): 0-9, defaults to 7.
+    // template (string): file name without extension, %F (file name
+    // without extension), %f (file name), %n (sequence number), %p
+    // (position) and %P (position with milliseconds) are expanded.
+    // Defaults to "mpv-shot%n", "-%n" is appended if %n is missing.
+    // directory (string): defaults to the current directory.
+    // start, end (real): time range in seconds, for interval and scene
+    // change captures.
+
+    // One still every interval seconds.
+    int captureInterval(const QUrl &source, qreal interval,
+                        const QVariantMap &options = QVariantMap());
+    // framesBefore + 1 + framesAfter consecutive frames around position.
+    int captureBurst(const QUrl &source, qreal position, int framesBefore,
+                     int framesAfter,
+                     const QVariantMap &options = QVariantMap());
+    // One still per scene change. threshold is the scene change score
+    // (0.0-1.0) of libavfilter's select filter.
+    int captureSceneChanges(const QUrl &source, qreal threshold = 0.3,
+                            const QVariantMap &options = QVariantMap());
+    void cancel(int captureId);
+
+private:
+    enum class Mode { Interval, Burst, SceneChange };
+
+    struct Capture {
+        int id = -1;
+        Mode mode = Mode::Interval;
+        QUrl source;
+        // Interval in seconds, or the scene change threshold.
+        qreal parameter = 0.0;
+        qreal start = 0.0;
+        qreal end = -1.0;
+        int framesBefore = 0;
+        int framesAfter = 0;
+        QString format;
+        int quality = -1;
+        QString fileNameTemplate;
+        QString directory;
+        int sequence = 0;
+        std::atomic_bool cancelled{false};
+        std::atomic_bool failed{false};
+        std::atomic_int written{0};
+        // The decoding job holds one reference, every queued frame another
+        // one. Whoever drops the last one finishes the capture.
+        std::atomic_int outstanding{1};
+    };
+    using CapturePtr = QSharedPointer<Capture>;
+
+    int startCapture(const CapturePtr &capture, const QVariantMap &options);
+    void decode(const CapturePtr &capture);
+    void decodeInterval(const CapturePtr &capture, MpvHeadlessPlayer &player);
+    void decodeBurst(const CapturePtr &capture, MpvHeadlessPlayer &player);
+    void decodeSceneChanges(const CapturePtr &capture,
+                            MpvHeadlessPlayer &player);
+    // Queues the current frame of the player, blocks while the queue is
+    // full. Returns false once the capture should stop.
+    bool enqueue(const CapturePtr &capture, MpvHeadlessPlayer &player);
+    void release(const CapturePtr &capture);
+
+    static QString expandTemplate(const QString &fileNameTemplate,
+                                  const QUrl &source, int sequence,
+                                  qreal position);
+
+private:
+    mutable QMutex mutex;
+    QHash<int, CapturePtr> captures;
+    int captureSerial = 0;
+    // Decoding and encoding have separate pools, so a decoder waiting for
+    // queue space can never starve the encoders.
+    QThreadPool decoderPool;
+    QThreadPool encoderPool;
+    QSemaphore queueSpace{queueLimit};
+
+Q_SIGNALS:
+    void encoderThreadsChanged();
+    void activeCapturesChanged();
+    void frameCaptured(int captureId, const QString &filePath,
+                       qreal position);
+    // success is false if the capture was cancelled or any frame failed.
+    void captureFinished(int captureId, int frameCount, bool success);
+};
@@ -0,0 +1,348 @@
+#include "mpvframetap.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QThread>
+#include <cstring>
+
+struct MpvFrameTap::Pool {
+    struct Ticket {
+        QSharedPointer<Pool> pool;
+        uchar *data = nullptr;
+        QSize size;
+    };
+
+    QMutex mutex;
+    QSize size;
+    int capacity = 0;
+    int outstanding = 0;
+    QVector<uchar *> buffers;
+
+    ~Pool() {
+        for (auto &&buffer : std::as_const(buffers)) {
+            delete[] buffer;
+        }
+    }
+
+    // QImage cleanup function.
+    static void release(void *info) {
+        const auto ticket = static_cast<Ticket *>(info);
+        {
+            QMutexLocker locker(&ticket->pool->mutex);
+            --ticket->pool->outstanding;
+            if ((ticket->size == ticket->pool->size) &&
+                (ticket->pool->buffers.count() < ticket->pool->capacity)) {
+                ticket->pool->buffers.append(ticket->data);
+                ticket->data = nullptr;
+            }
+        }
+        delete[] ticket->data;
+        delete ticket;
+    }
+};
+
+MpvFrameTap::MpvFrameTap(MpvFrameConsumer *consumer,
+                         const MpvFrameTapOptions &options)
+    : frameConsumer(consumer), tapOptions(options),
+      pool(QSharedPointer<Pool>::create()) {
+    tapOptions.queueDepth = qMax(tapOptions.queueDepth, 1);
+    // The read back ring, the queue and the frame being consumed.
+    pool->capacity = tapOptions.queueDepth + 4;
+    thread = QThread::create([this]() { deliver(); });
+    thread->start();
+}
+
+MpvFrameTap::~MpvFrameTap() {
+    stop();
+    // Only left for the destructor if stop() was called from the delivery
+    // thread.
+    if (thread != nullptr) {
+        thread->wait();
+        delete thread;
+        thread = nullptr;
+    }
+}
+
+MpvFrameConsumer *MpvFrameTap::consumer() const { return frameConsumer; }
+
+MpvFrameTapOptions MpvFrameTap::options() const { return tapOptions; }
+
+quint64 MpvFrameTap::droppedFrames() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+void MpvFrameTap::stop() {
+    {
+        QMutexLocker locker(&mutex);
+        if (stopped) {
+            return;
+        }
+        stopped = true;
+        queue.clear();
+        condition.wakeAll();
+    }
+    // Waiting for itself would never end, deliver() returns as soon as
+    // the running consumeFrame() has.
+    if (QThread::currentThread() == thread) {
+        return;
+    }
+    thread->wait();
+    delete thread;
+    thread = nullptr;
+}
+
+bool MpvFrameTap::isDue(qint64 renderTime) {
+    if (tapOptions.rate <= 0.0) {
+        return true;
+    }
+    const auto interval = static_cast<qint64>(1000000000.0 / tapOptions.rate);
+    const qint64 elapsed = renderTime - lastTapTime;
+    if (elapsed < interval) {
+        return false;
+    }
+    // Keep the cadence, unless the player hasn't rendered for a while.
+    lastTapTime =
+        (elapsed >= (2 * interval)) ? renderTime : (lastTapTime + interval);
+    return true;
+}
+
+QImage MpvFrameTap::acquireImage(const QSize &size) {
+    if (size.isEmpty()) {
+        return QImage();
+    }
+    uchar *data = nullptr;
+    {
+        QMutexLocker locker(&pool->mutex);
+        if (size != pool->size) {
+            // Buffers of the old size are freed when they come back.
+            for (auto &&buffer : std::as_const(pool->buffers)) {
+                delete[] buffer;
+            }
+            pool->buffers.clear();
+            pool->size = size;
+        }
+        if (!pool->buffers.isEmpty()) {
+            data = pool->buffers.takeLast();
+        } else if (pool->outstanding < pool->capacity) {
+            data = new uchar[static_cast<size_t>(size.width()) *
+                             static_cast<size_t>(size.height()) * 4];
+        } else {
+            return QImage();
+        }
+        ++pool->outstanding;
+    }
+    const auto ticket = new Pool::Ticket;
+    ticket->pool = pool;
+    ticket->data = data;
+    ticket->size = size;
+    return QImage(data, size.width(), size.height(), size.width() * 4,
+                  QImage::Format_RGBA8888, Pool::release, ticket);
+}
+
+void MpvFrameTap::push(const MpvVideoFrame &frame) {
+    QMutexLocker locker(&mutex);
+    if (stopped) {
+        return;
+    }
+    while (queue.count() >= tapOptions.queueDepth) {
+        queue.dequeue();
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    queue.enqueue(frame);
+    condition.wakeOne();
+}
+
+void MpvFrameTap::drop() { dropped.fetch_add(1, std::memory_order_relaxed); }
+
+void MpvFrameTap::deliver() {
+    while (true) {
+        MpvVideoFrame frame;
+        {
+            QMutexLocker locker(&mutex);
+            while (!stopped && queue.isEmpty()) {
+                condition.wait(&mutex);
+            }
+            if (stopped) {
+                return;
+            }
+            frame = queue.dequeue();
+        }
+        frameConsumer->consumeFrame(frame);
+    }
+}
+
+MpvFrameTapReadback::MpvFrameTapReadback(const MpvFrameTapPtr &tap)
+    : frameTap(tap) {}
+
+MpvFrameTapReadback::~MpvFrameTapReadback() { release(); }
+
+MpvFrameTapPtr MpvFrameTapReadback::tap() const { return frameTap; }
+
+void MpvFrameTapReadback::collect() {
+    if (!asynchronous) {
+        return;
+    }
+    QOpenGLExtraFunctions *functions =
+        QOpenGLContext::currentContext()->extraFunctions();
+    // Oldest transfer first, they complete in order.
+    for (int i = 0; i != ringSize; ++i) {
+        Slot &slot = ring[(nextSlot + i) % ringSize];
+        if (slot.fence == nullptr) {
+            continue;
+        }
+        const GLenum status =
+            functions->glClientWaitSync(slot.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            // Later ones can't be done either.
+            return;
+        }
+        functions->glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        QImage image = frameTap->acquireImage(targetSize);
+        if ((status == GL_WAIT_FAILED) || image.isNull()) {
+            frameTap->drop();
+            continue;
+        }
+        const auto length = static_cast<GLsizeiptr>(image.sizeInBytes());
+        functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void *pixels = functions->glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, length, GL_MAP_READ_BIT);
+        if (pixels != nullptr) {
+            std::memcpy(image.bits(), pixels, static_cast<size_t>(length));
+            functions->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (pixels == nullptr) {
+            frameTap->drop();
+            continue;
+        }
+        MpvVideoFrame frame;
+        frame.image = image;
+        frame.pts = slot.pts;
+        frame.renderTime = slot.renderTime;
+        frame.sequence = slot.sequence;
+        frameTap->push(frame);
+    }
+}
+
+void MpvFrameTapReadback::capture(QOpenGLFramebufferObject *source,
+                                  qreal pts, qint64 renderTime) {
+    if (source == nullptr) {
+        return;
+    }
+    const QSize size = frameTap->options().size.isEmpty()
+        ? source->size()
+        : frameTap->options().size;
+    if ((size != targetSize) && !initialize(size)) {
+        return;
+    }
+    const quint64 sequence = ++captured;
+    if (!asynchronous) {
+        QImage image = frameTap->acquireImage(targetSize);
+        if (image.isNull()) {
+            frameTap->drop();
+            return;
+        }
+        // Synchronous, but at least scaled by the GPU when possible.
+        QImage pixels;
+        if (QOpenGLFramebufferObject::hasOpenGLFramebufferBlit()) {
+            QOpenGLFramebufferObject::blitFramebuffer(
+                target, QRect(QPoint(0, 0), targetSize), source,
+                QRect(QPoint(0, 0), source->size()), GL_COLOR_BUFFER_BIT,
+                GL_LINEAR);
+            pixels = target->toImage();
+        } else {
+            pixels = source->toImage().scaled(targetSize);
+        }
+        pixels = pixels.convertToFormat(QImage::Format_RGBA8888);
+        for (int y = 0; y != targetSize.height(); ++y) {
+            std::memcpy(image.scanLine(y), pixels.constScanLine(y),
+                        static_cast<size_t>(targetSize.width()) * 4);
+        }
+        MpvVideoFrame frame;
+        frame.image = image;
+        frame.pts = pts;
+        frame.renderTime = renderTime;
+        frame.sequence = sequence;
+        frameTap->push(frame);
+        return;
+    }
+    Slot &slot = ring[nextSlot];
+    if (slot.fence != nullptr) {
+        // The GPU is more than a whole ring behind, don't make it worse.
+        frameTap->drop();
+        return;
+    }
+    QOpenGLExtraFunctions *functions =
+        QOpenGLContext::currentContext()->extraFunctions();
+    // Scale and flip (OpenGL's rows are bottom up) in one go.
+    functions->glBindFramebuffer(GL_READ_FRAMEBUFFER, source->handle());
+    functions->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->handle());
+    functions->glBlitFramebuffer(0, 0, source->width(), source->height(), 0,
+                                 targetSize.height(), targetSize.width(), 0,
+                                 GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    functions->glBindFramebuffer(GL_READ_FRAMEBUFFER, target->handle());
+    functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    functions->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // Returns immediately, the data goes into the buffer object.
+    functions->glReadPixels(0, 0, targetSize.width(), targetSize.height(),
+                            GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    functions->glBindFramebuffer(GL_FRAMEBUFFER, source->handle());
+    slot.fence = functions->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.pts = pts;
+    slot.renderTime = renderTime;
+    slot.sequence = sequence;
+    nextSlot = (nextSlot + 1) % ringSize;
+}
+
+bool MpvFrameTapReadback::initialize(const QSize &size) {
+    release();
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if ((context == nullptr) || size.isEmpty()) {
+        return false;
+    }
+    target = new QOpenGLFramebufferObject(size);
+    targetSize = size;
+    // Pixel buffer objects, fences and glMapBufferRange().
+    const auto version = context->format().version();
+    asynchronous = context->isOpenGLES() ? (version >= qMakePair(3, 0))
+                                         : (version >= qMakePair(3, 2));
+    if (!asynchronous) {
+        return true;
+    }
+    QOpenGLExtraFunctions *functions = context->extraFunctions();
+    for (auto &&slot : ring) {
+        functions->glGenBuffers(1, &slot.pbo);
+        functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        functions->glBufferData(GL_PIXEL_PACK_BUFFER,
+                                static_cast<GLsizeiptr>(size.width()) *
+                                    size.height() * 4,
+                                nullptr, GL_STREAM_READ);
+    }
+    functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    nextSlot = 0;
+    return true;
+}
+
+void MpvFrameTapReadback::release() {
+    if (asynchronous) {
+        QOpenGLExtraFunctions *functions =
+            QOpenGLContext::currentContext()->extraFunctions();
+        for (auto &&slot : ring) {
+            if (slot.fence != nullptr) {
+                functions->glDeleteSync(slot.fence);
+                frameTap->drop();
+            }
+            if (slot.pbo != 0) {
+                functions->glDeleteBuffers(1, &slot.pbo);
+            }
+            slot = Slot();
+        }
+    }
+    asynchronous = false;
+    delete target;
+    target = nullptr;
+    targetSize = QSize();
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <QImage>
+#include <QMutex>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QSize>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+#include <qopengl.h>
+
+class QOpenGLFramebufferObject;
+class QThread;
+
+// A frame as it was shown by a player.
+struct MpvVideoFrame {
+    // RGBA8888, top row first. The pixels live in a recycled buffer that
+    // goes back to the tap's pool once the last copy of the image is gone,
+    // so consumers should not hold on to frames longer than necessary.
+    QImage image;
+    // Playback position of the frame, in seconds.
+    qreal pts = 0.0;
+    // steady_clock timestamp of the render pass that showed the frame, in
+    // nanoseconds.
+    qint64 renderTime = 0;
+    // Counts all frames the tap took, gaps mean dropped frames.
+    quint64 sequence = 0;
+};
+
+// Receives frames from MpvObject::addFrameTap().
+class MpvFrameConsumer {
+public:
+    virtual ~MpvFrameConsumer() = default;
+
+    // Called on a thread of the tap's own, never on the GUI or the render
+    // thread. Frames arriving while this runs are queued, the oldest ones
+    // are dropped once the queue is full.
+    virtual void consumeFrame(const MpvVideoFrame &frame) = 0;
+};
+
+struct MpvFrameTapOptions {
+    // Frames per second, zero or less taps every new frame.
+    qreal rate = 5.0;
+    // Frames are scaled to this size (ignoring the aspect ratio), an empty
+    // size keeps the size of the item.
+    QSize size = QSize();
+    // Frames waiting for the consumer before the oldest one is dropped.
+    int queueDepth = 2;
+};
+
+// The consumer side of a frame tap: rate limiting, the buffer pool and the
+// delivery thread. The render thread side is MpvFrameTapReadback.
+class MpvFrameTap {
+    Q_DISABLE_COPY_MOVE(MpvFrameTap)
+
+public:
+    MpvFrameTap(MpvFrameConsumer *consumer, const MpvFrameTapOptions &options);
+    ~MpvFrameTap();
+
+    MpvFrameConsumer *consumer() const;
+    MpvFrameTapOptions options() const;
+    // Frames dropped because the consumer was too slow or no buffer was
+    // free.
+    quint64 droppedFrames() const;
+
+    // Blocks until a running consumeFrame() has returned, the consumer is
+    // never called again afterwards. Called from consumeFrame() itself it
+    // can't wait for that, the delivery thread then ends once it returns,
+    // and the destructor waits for it.
+    void stop();
+
+    // Render thread only: whether the frame rendered at the given time
+    // (steady_clock, nanoseconds) should be tapped.
+    bool isDue(qint64 renderTime);
+    // A buffer of the given size from the pool, null if all of them are in
+    // use. Thread-safe.
+    QImage acquireImage(const QSize &size);
+    // Thread-safe.
+    void push(const MpvVideoFrame &frame);
+    void drop();
+
+private:
+    struct Pool;
+
+    void deliver();
+
+private:
+    MpvFrameConsumer *frameConsumer = nullptr;
+    MpvFrameTapOptions tapOptions;
+    QSharedPointer<Pool> pool;
+    QThread *thread = nullptr;
+    QMutex mutex;
+    QWaitCondition condition;
+    QQueue<MpvVideoFrame> queue;
+    bool stopped = false;
+    qint64 lastTapTime = 0;
+    std::atomic<quint64> dropped{0};
+};
+
+using MpvFrameTapPtr = QSharedPointer<MpvFrameTap>;
+
+// Reads frames back from the item's framebuffer for one tap. Scaling and
+// flipping are done by the GPU (one blit), the pixels are copied into a
+// ring of pixel buffer objects and only mapped once their fence has
+// signalled, so rendering never waits for the transfer. The mapped pixels
+// are then copied once more, into a buffer of the tap's pool: a mapping
+// must be released on the render thread before the buffer is reused,
+// while consumers keep the frame for as long as they need it. Without
+// OpenGL 3 / OpenGL ES 3 it falls back to a synchronous read back.
+// Must be created, used and destroyed on the render thread, with the
+// context current.
+class MpvFrameTapReadback {
+    Q_DISABLE_COPY_MOVE(MpvFrameTapReadback)
+
+public:
+    explicit MpvFrameTapReadback(const MpvFrameTapPtr &tap);
+    ~MpvFrameTapReadback();
+
+    MpvFrameTapPtr tap() const;
+
+    // Hands finished transfers to the tap, should be called every frame.
+    void collect();
+    // Starts the transfer of the given framebuffer's content.
+    void capture(QOpenGLFramebufferObject *source, qreal pts,
+                 qint64 renderTime);
+
+private:
+    static constexpr int ringSize = 3;
+
+    struct Slot {
+        GLuint pbo = 0;
+        // Set while the transfer is in flight.
+        GLsync fence = nullptr;
+        qreal pts = 0.0;
+        qint64 renderTime = 0;
+        quint64 sequence = 0;
+    };
+
+    bool initialize(const QSize &size);
+    void release();
+
+private:
+    MpvFrameTapPtr frameTap;
+    QOpenGLFramebufferObject *target = nullptr;
+    Slot ring[ringSize];
+    int nextSlot = 0;
+    quint64 captured = 0;
+    bool asynchronous = false;
+    QSize targetSize;
+};
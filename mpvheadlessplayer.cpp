@@ -0,0 +1,264 @@
+#include "mpvheadlessplayer.h"
+#include "mpvstreamsource.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+MpvHeadlessPlayer::MpvHeadlessPlayer(int width)
+    : mpv(mpv::qt::Handle::FromRawHandle(mpv_create())),
+      currentWidth(qMax(width, 0)) {
+    if (mpv == nullptr) {
+        return;
+    }
+    // Nothing the user configured for mpv applies here.
+    mpv::qt::set_property(mpv, "config", false);
+    mpv::qt::set_property(mpv, "load-scripts", false);
+    mpv::qt::set_property(mpv, "ytdl", false);
+    mpv::qt::set_property(mpv, "input-default-bindings", false);
+    mpv::qt::set_property(mpv, "vo", QString::fromUtf8("null"));
+    mpv::qt::set_property(mpv, "ao", QString::fromUtf8("null"));
+    mpv::qt::set_property(mpv, "aid", QString::fromUtf8("no"));
+    mpv::qt::set_property(mpv, "sid", QString::fromUtf8("no"));
+    mpv::qt::set_property(mpv, "pause", true);
+    // Stay on the last frame instead of unloading the file when a seek
+    // overshoots.
+    mpv::qt::set_property(mpv, "keep-open", QString::fromUtf8("always"));
+    mpv::qt::set_property(mpv, "hr-seek", QString::fromUtf8("no"));
+    // Frame stepping must not wait for the presentation time of the frame.
+    mpv::qt::set_property(mpv, "untimed", true);
+    mpv::qt::set_property(mpv, "hwdec", QString::fromUtf8("no"));
+    // Quality doesn't matter for small previews, decoding speed does.
+    mpv::qt::set_property(mpv, "vd-lavc-fast", true);
+    mpv::qt::set_property(mpv, "vd-lavc-skiploopfilter",
+                          QString::fromUtf8("all"));
+    mpv::qt::set_property(mpv, "vd-lavc-threads", QString::number(1));
+    mpv::qt::set_property(mpv, "demuxer-max-bytes",
+                          QString::number(4 * 1024 * 1024));
+    mpv::qt::set_property(mpv, "demuxer-max-back-bytes", QString::number(0));
+    if (currentWidth > 0) {
+        mpv::qt::set_property(mpv, "vf",
+                              QString::fromUtf8("scale=w=%1:h=-2")
+                                  .arg(currentWidth));
+    }
+    mpv_observe_property(mpv, pauseObserver, "pause", MPV_FORMAT_FLAG);
+    if (mpv_initialize(mpv) < 0) {
+        qWarning().noquote() << "Failed to initialize a headless player.";
+        mpv = mpv::qt::Handle();
+        return;
+    }
+    MpvStreamSource::registerProtocols(mpv);
+}
+
+MpvHeadlessPlayer::~MpvHeadlessPlayer() = default;
+
+bool MpvHeadlessPlayer::isValid() const { return mpv != nullptr; }
+
+QUrl MpvHeadlessPlayer::source() const { return currentSource; }
+
+int MpvHeadlessPlayer::width() const { return currentWidth; }
+
+bool MpvHeadlessPlayer::load(const QUrl &url, int timeout) {
+    if (!isValid() || !url.isValid()) {
+        return false;
+    }
+    currentSource = QUrl();
+    if (mpv::qt::get_error(mpv::qt::command(
+            mpv, QVariantList{QString::fromUtf8("loadfile"),
+                              MpvStreamSource::mpvPath(url)})) < 0) {
+        return false;
+    }
+    // The first frame has been decoded once playback restarts. Returning
+    // before that would leave the restart to be mistaken for the one of the
+    // first seek().
+    bool fileLoaded = false;
+    if (!waitFor(
+            [&fileLoaded](const mpv_event *event) {
+                if (event->event_id == MPV_EVENT_FILE_LOADED) {
+                    fileLoaded = true;
+                }
+                return fileLoaded &&
+                    (event->event_id == MPV_EVENT_PLAYBACK_RESTART);
+            },
+            timeout)) {
+        qWarning().noquote() << "Headless player failed to load:" << url;
+        return false;
+    }
+    currentSource = url;
+    return true;
+}
+
+bool MpvHeadlessPlayer::seek(qreal position, bool keyframes, int timeout) {
+    if (!isValid() || currentSource.isEmpty()) {
+        return false;
+    }
+    const qreal duration = property("duration").toReal();
+    if (duration > 0.0) {
+        position = qBound(0.0, position, duration);
+    }
+    if (mpv::qt::get_error(mpv::qt::command(
+            mpv, QVariantList{QString::fromUtf8("seek"), position,
+                              keyframes
+                                  ? QString::fromUtf8("absolute+keyframes")
+                                  : QString::fromUtf8("absolute+exact")})) <
+        0) {
+        return false;
+    }
+    // Even while paused, the frame at the new position is decoded and
+    // handed to the (null) video output before this arrives.
+    return waitForEvent(MPV_EVENT_PLAYBACK_RESTART, timeout);
+}
+
+bool MpvHeadlessPlayer::frameStep(int timeout) {
+    if (!isValid() || currentSource.isEmpty() ||
+        property("eof-reached").toBool()) {
+        return false;
+    }
+    if (mpv::qt::get_error(mpv::qt::command(
+            mpv, QVariantList{QString::fromUtf8("frame-step")})) < 0) {
+        return false;
+    }
+    // frame-step unpauses playback for exactly one frame.
+    bool resumed = false;
+    return waitFor(
+        [&resumed](const mpv_event *event) {
+            if ((event->event_id != MPV_EVENT_PROPERTY_CHANGE) ||
+                (event->reply_userdata != pauseObserver)) {
+                return false;
+            }
+            const auto property =
+                static_cast<mpv_event_property *>(event->data);
+            if (property->format != MPV_FORMAT_FLAG) {
+                return false;
+            }
+            const bool paused = *static_cast<int *>(property->data) != 0;
+            if (!paused) {
+                resumed = true;
+            }
+            return paused && resumed;
+        },
+        timeout);
+}
+
+QImage MpvHeadlessPlayer::grab() const {
+    return isValid() ? grabFrame(mpv) : QImage();
+}
+
+bool MpvHeadlessPlayer::setProperty(const char *name, const QVariant &value) {
+    return isValid() && (mpv::qt::set_property(mpv, name, value) >= 0);
+}
+
+QVariant MpvHeadlessPlayer::property(const char *name) const {
+    if (!isValid()) {
+        return QVariant();
+    }
+    const QVariant value = mpv::qt::get_property(mpv, name);
+    return mpv::qt::is_error(value) ? QVariant() : value;
+}
+
+mpv_handle *MpvHeadlessPlayer::handle() const { return mpv; }
+
+QImage MpvHeadlessPlayer::grabFrame(mpv_handle *handle, const char *mode) {
+    if (handle == nullptr) {
+        return QImage();
+    }
+    const char *arguments[] = {"screenshot-raw", mode, nullptr};
+    auto result = new mpv_node;
+    if (mpv_command_ret(handle, arguments, result) < 0) {
+        delete result;
+        return QImage();
+    }
+    const auto freeNode = [](void *info) {
+        auto node = static_cast<mpv_node *>(info);
+        mpv_free_node_contents(node);
+        delete node;
+    };
+    qint64 width = 0;
+    qint64 height = 0;
+    qint64 stride = 0;
+    const char *format = nullptr;
+    const mpv_byte_array *data = nullptr;
+    if (result->format == MPV_FORMAT_NODE_MAP) {
+        const mpv_node_list *list = result->u.list;
+        for (int i = 0; i != list->num; ++i) {
+            const char *key = list->keys[i];
+            const mpv_node &value = list->values[i];
+            if ((qstrcmp(key, "w") == 0) &&
+                (value.format == MPV_FORMAT_INT64)) {
+                width = value.u.int64;
+            } else if ((qstrcmp(key, "h") == 0) &&
+                       (value.format == MPV_FORMAT_INT64)) {
+                height = value.u.int64;
+            } else if ((qstrcmp(key, "stride") == 0) &&
+                       (value.format == MPV_FORMAT_INT64)) {
+                stride = value.u.int64;
+            } else if ((qstrcmp(key, "format") == 0) &&
+                       (value.format == MPV_FORMAT_STRING)) {
+                format = value.u.string;
+            } else if ((qstrcmp(key, "data") == 0) &&
+                       (value.format == MPV_FORMAT_BYTE_ARRAY)) {
+                data = value.u.ba;
+            }
+        }
+    }
+    // "bgr0" is the only format screenshot-raw produces so far.
+    if ((width <= 0) || (height <= 0) || (stride < (width * 4)) ||
+        (qstrcmp(format, "bgr0") != 0) || (data == nullptr) ||
+        (static_cast<qint64>(data->size) < (stride * height))) {
+        freeNode(result);
+        return QImage();
+    }
+    const auto bits = static_cast<const uchar *>(data->data);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    // B, G, R, X in memory is exactly what a little endian 0xffRRGGBB looks
+    // like, so mpv's buffer can be used as it is.
+    return QImage(bits, static_cast<int>(width), static_cast<int>(height),
+                  static_cast<int>(stride), QImage::Format_RGB32, freeNode,
+                  result);
+#else
+    const QImage image =
+        QImage(bits, static_cast<int>(width), static_cast<int>(height),
+               static_cast<int>(stride), QImage::Format_RGBX8888)
+            .rgbSwapped();
+    freeNode(result);
+    return image;
+#endif
+}
+
+bool MpvHeadlessPlayer::waitForEvent(mpv_event_id eventId, int timeout) {
+    return waitFor(
+        [eventId](const mpv_event *event) {
+            return event->event_id == eventId;
+        },
+        timeout);
+}
+
+bool MpvHeadlessPlayer::waitFor(
+    const std::function<bool(const mpv_event *)> &predicate, int timeout) {
+    QElapsedTimer timer;
+    timer.start();
+    while (true) {
+        const qint64 remaining = timeout - timer.elapsed();
+        if (remaining <= 0) {
+            return false;
+        }
+        const mpv_event *event =
+            mpv_wait_event(mpv, static_cast<double>(remaining) / 1000.0);
+        if (predicate(event)) {
+            return true;
+        }
+        if (event->event_id == MPV_EVENT_END_FILE) {
+            // Replacing the previous file ends it with "stop", which is
+            // expected while loading. Anything else means the file is gone.
+            const auto reason =
+                static_cast<mpv_event_end_file *>(event->data)->reason;
+            if ((reason != MPV_END_FILE_REASON_STOP) &&
+                (reason != MPV_END_FILE_REASON_REDIRECT)) {
+                currentSource = QUrl();
+                return false;
+            }
+        } else if (event->event_id == MPV_EVENT_SHUTDOWN) {
+            currentSource = QUrl();
+            return false;
+        }
+    }
+}
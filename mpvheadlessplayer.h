@@ -0,0 +1,62 @@
+#pragma once
+
+#include "mpvqthelper.hpp"
+#include <QImage>
+#include <QUrl>
+#include <QVariant>
+#include <functional>
+#include <mpv/client.h>
+
+// A hidden mpv instance without audio and video output, for background work
+// such as thumbnails. All calls block, so it's meant to be used on worker
+// threads, and by one thread at a time.
+class MpvHeadlessPlayer {
+    Q_DISABLE_COPY_MOVE(MpvHeadlessPlayer)
+
+public:
+    // Decoded frames are scaled to the given width (keeping the aspect
+    // ratio), zero or less keeps the original size.
+    explicit MpvHeadlessPlayer(int width = 0);
+    ~MpvHeadlessPlayer();
+
+    static constexpr int defaultTimeout = 5000;
+
+    bool isValid() const;
+    // The loaded file, empty if nothing is loaded.
+    QUrl source() const;
+    int width() const;
+
+    // Timeouts are in milliseconds. Returns once the first frame is there.
+    bool load(const QUrl &url, int timeout = defaultTimeout);
+    // Keyframe seeks are a lot cheaper, but may land a few seconds off.
+    bool seek(qreal position, bool keyframes = true,
+              int timeout = defaultTimeout);
+    // Decode exactly one more frame (the next one that passes the video
+    // filters) and pause again.
+    bool frameStep(int timeout = defaultTimeout);
+    // The current frame, without subtitles. Null if there is none.
+    QImage grab() const;
+    bool setProperty(const char *name, const QVariant &value);
+    QVariant property(const char *name) const;
+
+    mpv_handle *handle() const;
+
+    // Blocking "screenshot-raw" for any mpv handle, safe to call from any
+    // thread. mode is "video", "subtitles" or "window". The image refers to
+    // mpv's buffer directly instead of copying it, the buffer is freed
+    // together with the last copy of the image.
+    static QImage grabFrame(mpv_handle *handle, const char *mode = "video");
+
+private:
+    bool waitForEvent(mpv_event_id eventId, int timeout);
+    // Fails early if the file ends with an error or the core shuts down.
+    bool waitFor(const std::function<bool(const mpv_event *)> &predicate,
+                 int timeout);
+
+    static constexpr quint64 pauseObserver = 1;
+
+private:
+    mpv::qt::Handle mpv;
+    QUrl currentSource = QUrl();
+    int currentWidth = 0;
+};
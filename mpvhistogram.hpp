@@ -0,0 +1,135 @@
+#pragma once
+
+#ifndef _MPVHISTOGRAM_HPP
+#define _MPVHISTOGRAM_HPP
+
+#include <QVariant>
+#include <array>
+#include <atomic>
+#include <chrono>
+
+/**
+ * Lock-free histogram with power-of-two buckets. Bucket n counts the values
+ * in [2^n, 2^(n+1)), bucket 0 also counts 0 and the last one everything that
+ * doesn't fit anywhere else. Recording is a handful of relaxed atomic
+ * operations, so it can be used from any thread, including the render
+ * thread. Snapshots are not atomic as a whole, which is fine for statistics.
+ *
+ * The unit is up to the caller, this codebase uses microseconds.
+ */
+class MpvHistogram {
+public:
+    static constexpr int bucketCount = 32;
+
+    MpvHistogram() = default;
+    Q_DISABLE_COPY_MOVE(MpvHistogram)
+
+    void record(qint64 value) {
+        value = qMax(value, qint64(0));
+        int bucket = 0;
+        while ((bucket < (bucketCount - 1)) &&
+               (value >= (qint64(2) << bucket))) {
+            ++bucket;
+        }
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        qint64 currentMax = max.load(std::memory_order_relaxed);
+        while ((value > currentMax) &&
+               !max.compare_exchange_weak(currentMax, value,
+                                          std::memory_order_relaxed)) {
+        }
+    }
+
+    void reset() {
+        for (auto &&bucket : buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+    // Adds the other histogram's values to this one, for aggregation.
+    void add(const MpvHistogram &other) {
+        for (int bucket = 0; bucket != bucketCount; ++bucket) {
+            buckets[bucket].fetch_add(
+                other.buckets[bucket].load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        }
+        count.fetch_add(other.count.load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+        sum.fetch_add(other.sum.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+        const qint64 otherMax = other.max.load(std::memory_order_relaxed);
+        qint64 currentMax = max.load(std::memory_order_relaxed);
+        while ((otherMax > currentMax) &&
+               !max.compare_exchange_weak(currentMax, otherMax,
+                                          std::memory_order_relaxed)) {
+        }
+    }
+
+    quint64 total() const { return count.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket the given percentile (0.0-1.0) falls into.
+    qint64 percentile(qreal p) const {
+        const quint64 total = this->total();
+        if (total == 0) {
+            return 0;
+        }
+        const auto rank =
+            static_cast<quint64>(qBound(0.0, p, 1.0) * (total - 1)) + 1;
+        quint64 seen = 0;
+        for (int bucket = 0; bucket != bucketCount; ++bucket) {
+            seen += buckets[bucket].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return qMin((qint64(2) << bucket) - 1,
+                            max.load(std::memory_order_relaxed));
+            }
+        }
+        return max.load(std::memory_order_relaxed);
+    }
+
+    QVariantMap toVariantMap() const {
+        QVariantMap map;
+        const quint64 total = this->total();
+        map[QString::fromUtf8("count")] = total;
+        map[QString::fromUtf8("sum")] = sum.load(std::memory_order_relaxed);
+        map[QString::fromUtf8("max")] = max.load(std::memory_order_relaxed);
+        map[QString::fromUtf8("mean")] = (total == 0)
+            ? 0.0
+            : (static_cast<qreal>(sum.load(std::memory_order_relaxed)) /
+               total);
+        map[QString::fromUtf8("p50")] = percentile(0.5);
+        map[QString::fromUtf8("p90")] = percentile(0.9);
+        map[QString::fromUtf8("p99")] = percentile(0.99);
+        // Only the non-empty buckets, keyed by their upper bound.
+        QVariantMap bucketMap;
+        for (int bucket = 0; bucket != bucketCount; ++bucket) {
+            const quint64 value =
+                buckets[bucket].load(std::memory_order_relaxed);
+            if (value != 0) {
+                bucketMap[QString::number((qint64(2) << bucket) - 1)] = value;
+            }
+        }
+        map[QString::fromUtf8("buckets")] = bucketMap;
+        return map;
+    }
+
+private:
+    std::array<std::atomic<quint64>, bucketCount> buckets{};
+    std::atomic<quint64> count{0};
+    std::atomic<qint64> sum{0};
+    std::atomic<qint64> max{0};
+};
+
+// The clock of all the timings recorded here, in nanoseconds. Same on every
+// thread, so timestamps taken on the GUI and the render thread can be put
+// on one timeline.
+inline qint64 steadyClockNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+#endif
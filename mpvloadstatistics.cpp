@@ -0,0 +1,92 @@
+#include "mpvloadstatistics.h"
+
+#include <QCoreApplication>
+#include <QPointer>
+#include <QStringList>
+
+namespace {
+
+const char *const groups[] = {"codec", "container", "sourceType"};
+
+const char *const phases[] = {"startFile",       "fileLoaded",
+                              "videoReconfig",   "playbackRestart",
+                              "firstFrame",      "firstAudio"};
+
+} // namespace
+
+MpvLoadStatistics::MpvLoadStatistics(QObject *parent) : QObject(parent) {}
+
+MpvLoadStatistics::~MpvLoadStatistics() = default;
+
+MpvLoadStatistics *MpvLoadStatistics::instance() {
+    static QPointer<MpvLoadStatistics> statistics;
+    if (statistics.isNull()) {
+        statistics = new MpvLoadStatistics(QCoreApplication::instance());
+    }
+    return statistics;
+}
+
+int MpvLoadStatistics::count() const { return recordedCount; }
+
+void MpvLoadStatistics::record(const QVariantMap &loadTimings) {
+    for (auto &&phase : phases) {
+        const QString phaseName = QString::fromUtf8(phase);
+        if (!loadTimings.contains(phaseName)) {
+            continue;
+        }
+        const auto value = static_cast<qint64>(
+            loadTimings.value(phaseName).toReal() * 1000.0);
+        histogram(QString::fromUtf8("all"), QString::fromUtf8("all"),
+                  phaseName)
+            ->record(value);
+        for (auto &&group : groups) {
+            const QString groupName = QString::fromUtf8(group);
+            QString groupValue = loadTimings.value(groupName).toString();
+            if (groupValue.isEmpty()) {
+                groupValue = QString::fromUtf8("unknown");
+            }
+            histogram(groupName, groupValue, phaseName)->record(value);
+        }
+    }
+    ++recordedCount;
+    Q_EMIT recorded();
+}
+
+QVariantMap MpvLoadStatistics::histograms() const {
+    QVariantMap result;
+    auto iterator = phaseHistograms.constBegin();
+    while (iterator != phaseHistograms.constEnd()) {
+        const QStringList key = iterator.key().split(QChar::fromLatin1('/'));
+        if (key.count() == 3) {
+            QVariantMap group = result.value(key.at(0)).toMap();
+            QVariantMap value = group.value(key.at(1)).toMap();
+            value[key.at(2)] = iterator.value()->toVariantMap();
+            group[key.at(1)] = value;
+            result[key.at(0)] = group;
+        }
+        ++iterator;
+    }
+    return result;
+}
+
+void MpvLoadStatistics::reset() {
+    phaseHistograms.clear();
+    recordedCount = 0;
+    Q_EMIT recorded();
+}
+
+MpvHistogram *MpvLoadStatistics::histogram(const QString &group,
+                                           const QString &value,
+                                           const QString &phase) {
+    // Codec and container names never contain slashes, but urls might end
+    // up in here one day.
+    QString safeValue = value;
+    safeValue.replace(QChar::fromLatin1('/'), QChar::fromLatin1('_'));
+    const QString key = group + QChar::fromLatin1('/') + safeValue +
+        QChar::fromLatin1('/') + phase;
+    auto &entry = phaseHistograms[key];
+    if (entry.isNull()) {
+        entry.reset(new MpvHistogram);
+    }
+    return entry.data();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "mpvhistogram.hpp"
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QVariant>
+
+// Process-wide aggregation of MpvObject::loadTimings. Every finished open()
+// is recorded into one histogram per load phase, once for all files and once
+// per codec, container and source type, so startup regressions can be
+// narrowed down to e.g. "HEVC in MKV over HTTP".
+class MpvLoadStatistics : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvLoadStatistics)
+
+    Q_PROPERTY(int count READ count NOTIFY recorded)
+
+public:
+    explicit MpvLoadStatistics(QObject *parent = nullptr);
+    ~MpvLoadStatistics() override;
+
+    static MpvLoadStatistics *instance();
+
+    // Number of recorded loads.
+    int count() const;
+
+    // Phase values are in milliseconds, "codec", "container" and
+    // "sourceType" select the groups the load is counted in.
+    void record(const QVariantMap &loadTimings);
+
+public Q_SLOTS:
+    // Nested map: group ("all", "codec", "container", "sourceType") ->
+    // group value (e.g. "h264") -> phase -> histogram (in microseconds).
+    QVariantMap histograms() const;
+    void reset();
+
+private:
+    MpvHistogram *histogram(const QString &group, const QString &value,
+                            const QString &phase);
+
+private:
+    // Key: group, value and phase separated by '/'.
+    QHash<QString, QSharedPointer<MpvHistogram>> phaseHistograms;
+    int recordedCount = 0;
+
+Q_SIGNALS:
+    void recorded();
+};
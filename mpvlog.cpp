@@ -0,0 +1,180 @@
+#include "mpvlog.h"
+#include "mpvhistogram.hpp"
+
+#include <QCoreApplication>
+#include <QPointer>
+#include <cstring>
+#include <mpv/client.h>
+
+Q_LOGGING_CATEGORY(lcMpvCalls, "wangwenx190.quickmpv.calls", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcMpvProperties, "wangwenx190.quickmpv.properties",
+                   QtInfoMsg)
+Q_LOGGING_CATEGORY(lcMpvEvents, "wangwenx190.quickmpv.events", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcMpvLog, "wangwenx190.quickmpv.libmpv", QtInfoMsg)
+
+namespace {
+
+// Copies at most size - 1 bytes, without the trailing line break mpv adds.
+void copyText(char *target, const char *source, int size) {
+    int length = 0;
+    if (source != nullptr) {
+        length = static_cast<int>(qstrnlen(source, size - 1));
+        std::memcpy(target, source, length);
+        while ((length > 0) && (target[length - 1] == '\n')) {
+            --length;
+        }
+    }
+    target[length] = '\0';
+}
+
+QString levelName(int level) {
+    switch (level) {
+    case MPV_LOG_LEVEL_FATAL:
+        return QString::fromUtf8("fatal");
+    case MPV_LOG_LEVEL_ERROR:
+        return QString::fromUtf8("error");
+    case MPV_LOG_LEVEL_WARN:
+        return QString::fromUtf8("warn");
+    case MPV_LOG_LEVEL_INFO:
+        return QString::fromUtf8("info");
+    case MPV_LOG_LEVEL_V:
+        return QString::fromUtf8("v");
+    case MPV_LOG_LEVEL_DEBUG:
+        return QString::fromUtf8("debug");
+    case MPV_LOG_LEVEL_TRACE:
+        return QString::fromUtf8("trace");
+    default:
+        break;
+    }
+    return QString::number(level);
+}
+
+} // namespace
+
+// A seqlock: the sequence is zero while the slot is being written and the
+// message's sequence number once it's complete. Readers copy the slot and
+// only keep the copy if the sequence didn't change in the meantime.
+struct MpvLog::Slot {
+    std::atomic<quint64> sequence{0};
+    qint64 timestamp = 0;
+    int level = 0;
+    char prefix[32] = {};
+    char text[maximumTextLength] = {};
+};
+
+MpvLog::MpvLog(QObject *parent)
+    : QObject(parent), ring(new Slot[ringSize]) {
+    static_assert((ringSize & (ringSize - 1)) == 0,
+                  "The ring size must be a power of two.");
+}
+
+MpvLog::~MpvLog() = default;
+
+MpvLog *MpvLog::instance() {
+    static QPointer<MpvLog> log;
+    if (log.isNull()) {
+        log = new MpvLog(QCoreApplication::instance());
+    }
+    return log;
+}
+
+int MpvLog::capacity() const { return ringSize; }
+
+quint64 MpvLog::lastSequence() const {
+    return head.load(std::memory_order_acquire);
+}
+
+void MpvLog::append(int level, const char *prefix, const char *text) {
+    const quint64 sequence = head.fetch_add(1, std::memory_order_relaxed) + 1;
+    Slot &slot = ring[(sequence - 1) & (ringSize - 1)];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timestamp = steadyClockNanoseconds();
+    slot.level = level;
+    copyText(slot.prefix, prefix, sizeof(slot.prefix));
+    copyText(slot.text, text, sizeof(slot.text));
+    slot.sequence.store(sequence, std::memory_order_release);
+    if (!notificationPending.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(
+            this,
+            [this]() {
+                notificationPending.store(false, std::memory_order_release);
+                Q_EMIT messagesAvailable();
+            },
+            Qt::QueuedConnection);
+    }
+}
+
+QVector<MpvLog::Message> MpvLog::messages(quint64 since) const {
+    const quint64 last = head.load(std::memory_order_acquire);
+    quint64 first =
+        qMax(since, clearedSequence.load(std::memory_order_relaxed)) + 1;
+    if (last > static_cast<quint64>(ringSize)) {
+        first = qMax(first, last - ringSize + 1);
+    }
+    QVector<Message> result;
+    if (first > last) {
+        return result;
+    }
+    result.reserve(static_cast<int>(last - first + 1));
+    for (quint64 sequence = first; sequence <= last; ++sequence) {
+        const Slot &slot = ring[(sequence - 1) & (ringSize - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != sequence) {
+            // Still being written, or already overwritten.
+            continue;
+        }
+        Slot copy;
+        copy.timestamp = slot.timestamp;
+        copy.level = slot.level;
+        std::memcpy(copy.prefix, slot.prefix, sizeof(copy.prefix));
+        std::memcpy(copy.text, slot.text, sizeof(copy.text));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        // The writer may have been interrupted in the middle of a string.
+        copy.prefix[sizeof(copy.prefix) - 1] = '\0';
+        copy.text[sizeof(copy.text) - 1] = '\0';
+        Message message;
+        message.sequence = sequence;
+        message.timestamp = copy.timestamp;
+        message.level = copy.level;
+        message.prefix = QString::fromUtf8(copy.prefix);
+        message.text = QString::fromUtf8(copy.text);
+        result.append(message);
+    }
+    return result;
+}
+
+QVariantList MpvLog::messageList(qint64 since) const {
+    QVariantList list;
+    const QVector<Message> messages =
+        this->messages(static_cast<quint64>(qMax(since, qint64(0))));
+    for (auto &&message : messages) {
+        QVariantMap entry;
+        entry[QString::fromUtf8("sequence")] = message.sequence;
+        entry[QString::fromUtf8("timestamp")] = message.timestamp / 1000000;
+        entry[QString::fromUtf8("level")] = levelName(message.level);
+        entry[QString::fromUtf8("prefix")] = message.prefix;
+        entry[QString::fromUtf8("text")] = message.text;
+        list.append(entry);
+    }
+    return list;
+}
+
+QString MpvLog::dump(qint64 since) const {
+    QString text;
+    const QVector<Message> messages =
+        this->messages(static_cast<quint64>(qMax(since, qint64(0))));
+    for (auto &&message : messages) {
+        text += QString::fromUtf8("[%1] %2: %3\n")
+                    .arg(message.prefix, levelName(message.level),
+                         message.text);
+    }
+    return text;
+}
+
+void MpvLog::clear() {
+    clearedSequence.store(head.load(std::memory_order_acquire),
+                          std::memory_order_relaxed);
+}
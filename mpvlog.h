@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QLoggingCategory>
+#include <QObject>
+#include <QVariant>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+// Debug output of the wrapper is off by default and costs a single branch
+// while disabled, enable it with logging rules, for example
+// QT_LOGGING_RULES="wangwenx190.quickmpv.*.debug=true".
+// Commands, property writes and observations sent to mpv.
+Q_DECLARE_LOGGING_CATEGORY(lcMpvCalls)
+// Property changes reported by mpv.
+Q_DECLARE_LOGGING_CATEGORY(lcMpvProperties)
+// Other events reported by mpv.
+Q_DECLARE_LOGGING_CATEGORY(lcMpvEvents)
+// mpv's own log messages (see MpvObject's logLevel), forwarded from
+// MpvLog. Everything below info is off by default.
+Q_DECLARE_LOGGING_CATEGORY(lcMpvLog)
+
+// Process-wide ring buffer of mpv's log messages. Appending is lock-free
+// and never allocates, so even a flood of trace messages only costs a copy
+// into a fixed slot; once the ring is full the oldest messages are
+// overwritten. Readers copy out what they need whenever they want to:
+// dump the ring on demand, or stream it by passing the last sequence
+// number they have seen.
+class MpvLog : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvLog)
+
+    Q_PROPERTY(int capacity READ capacity CONSTANT)
+    Q_PROPERTY(quint64 lastSequence READ lastSequence NOTIFY messagesAvailable)
+
+public:
+    struct Message {
+        // Increases by one with every message, starting at 1.
+        quint64 sequence = 0;
+        // steady_clock, in nanoseconds.
+        qint64 timestamp = 0;
+        // One of mpv's MPV_LOG_LEVEL_* values.
+        int level = 0;
+        // The mpv module the message came from.
+        QString prefix;
+        QString text;
+    };
+
+    static constexpr int ringSize = 2048;
+    // Longer texts are truncated.
+    static constexpr int maximumTextLength = 480;
+
+    explicit MpvLog(QObject *parent = nullptr);
+    ~MpvLog() override;
+
+    static MpvLog *instance();
+
+    int capacity() const;
+    quint64 lastSequence() const;
+
+    // Thread-safe and lock-free.
+    void append(int level, const char *prefix, const char *text);
+    // All messages still in the ring with a sequence number greater than
+    // the given one, the oldest first.
+    QVector<Message> messages(quint64 since) const;
+
+public Q_SLOTS:
+    // Same as messages(since), as maps with sequence, timestamp (in
+    // milliseconds), level (mpv's level name), prefix and text.
+    QVariantList messageList(qint64 since = 0) const;
+    // Same as messages(since), one "[prefix] level: text" line each.
+    QString dump(qint64 since = 0) const;
+    // Messages logged so far are no longer returned.
+    void clear();
+
+private:
+    struct Slot;
+
+    std::unique_ptr<Slot[]> ring;
+    std::atomic<quint64> head{0};
+    // Everything up to this one has been cleared.
+    std::atomic<quint64> clearedSequence{0};
+    std::atomic_bool notificationPending{false};
+
+Q_SIGNALS:
+    // New messages have been appended. Emitted at most once per event loop
+    // iteration, however many messages arrived.
+    void messagesAvailable();
+};
@@ -0,0 +1,322 @@
+#include "mpvmediaprobe.h"
+#include "mpvheadlessplayer.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QPointer>
+#include <QRunnable>
+
+namespace {
+
+QVariantMap toVariantMap(const QHash<QString, QVariant> &hash) {
+    QVariantMap map;
+    for (auto it = hash.constBegin(); it != hash.constEnd(); ++it) {
+        map.insert(it.key(), it.value());
+    }
+    return map;
+}
+
+QVariantList toVariantList(const QVector<QHash<QString, QVariant>> &list) {
+    QVariantList variantList;
+    variantList.reserve(list.count());
+    for (auto &&hash : std::as_const(list)) {
+        variantList.append(toVariantMap(hash));
+    }
+    return variantList;
+}
+
+} // namespace
+
+class MpvMediaProbeJob : public QRunnable {
+    Q_DISABLE_COPY_MOVE(MpvMediaProbeJob)
+
+public:
+    MpvMediaProbeJob(MpvMediaProbe *probe,
+                     const MpvMediaProbe::RequestPtr &request)
+        : probe(probe), request(request) {}
+    ~MpvMediaProbeJob() override = default;
+
+    void run() override { probe->process(request); }
+
+private:
+    MpvMediaProbe *probe = nullptr;
+    MpvMediaProbe::RequestPtr request;
+};
+
+QVariantMap MpvMediaProbe::Result::toVariantMap() const {
+    QVariantMap map;
+    map[QString::fromUtf8("source")] = source;
+    map[QString::fromUtf8("valid")] = valid;
+    map[QString::fromUtf8("fileSize")] = fileSize;
+    map[QString::fromUtf8("lastModified")] = lastModified;
+    map[QString::fromUtf8("duration")] = duration;
+    map[QString::fromUtf8("width")] = width;
+    map[QString::fromUtf8("height")] = height;
+    map[QString::fromUtf8("fileFormat")] = fileFormat;
+    map[QString::fromUtf8("videoChannels")] =
+        toVariantList(mediaTracks.videoChannels);
+    map[QString::fromUtf8("audioTracks")] =
+        toVariantList(mediaTracks.audioTracks);
+    map[QString::fromUtf8("subtitleStreams")] =
+        toVariantList(mediaTracks.subtitleStreams);
+    map[QString::fromUtf8("chapters")] = toVariantList(chapters);
+    map[QString::fromUtf8("metadata")] = ::toVariantMap(metadata);
+    return map;
+}
+
+MpvMediaProbe::MpvMediaProbe(QObject *parent) : QObject(parent) {
+    cache.setMaxCost(10000);
+    threadPool.setMaxThreadCount(currentPoolSize);
+}
+
+MpvMediaProbe::~MpvMediaProbe() {
+    // Same as MpvThumbnailEngine, the running jobs still need the players
+    // and the cache.
+    threadPool.clear();
+    threadPool.waitForDone();
+}
+
+MpvMediaProbe *MpvMediaProbe::instance() {
+    static QPointer<MpvMediaProbe> probe;
+    if (probe.isNull()) {
+        probe = new MpvMediaProbe(QCoreApplication::instance());
+    }
+    return probe;
+}
+
+int MpvMediaProbe::poolSize() const { return currentPoolSize; }
+
+int MpvMediaProbe::cacheLimit() const {
+    QMutexLocker locker(&mutex);
+    return cache.maxCost();
+}
+
+void MpvMediaProbe::setPoolSize(int poolSize) {
+    poolSize = qMax(poolSize, 1);
+    if (poolSize == currentPoolSize) {
+        return;
+    }
+    currentPoolSize = poolSize;
+    threadPool.setMaxThreadCount(currentPoolSize);
+    {
+        QMutexLocker locker(&mutex);
+        while (idlePlayers.count() > currentPoolSize) {
+            idlePlayers.removeFirst();
+        }
+    }
+    Q_EMIT poolSizeChanged();
+}
+
+void MpvMediaProbe::setCacheLimit(int cacheLimit) {
+    cacheLimit = qMax(cacheLimit, 0);
+    {
+        QMutexLocker locker(&mutex);
+        if (cacheLimit == cache.maxCost()) {
+            return;
+        }
+        cache.setMaxCost(cacheLimit);
+    }
+    Q_EMIT cacheLimitChanged();
+}
+
+void MpvMediaProbe::request(const RequestPtr &request) {
+    if (request.isNull()) {
+        return;
+    }
+    auto job = new MpvMediaProbeJob(this, request);
+    // Registered before it can run, process() takes it out again.
+    QMutexLocker locker(&mutex);
+    waitingJobs.insert(request.data(), job);
+    threadPool.start(job, request->priority);
+}
+
+bool MpvMediaProbe::setPriority(const RequestPtr &request, int priority) {
+    if (request.isNull()) {
+        return false;
+    }
+    // process() can't remove the job while the mutex is held, so it's
+    // either still queued or about to run, but not deleted.
+    QMutexLocker locker(&mutex);
+    MpvMediaProbeJob *job = waitingJobs.value(request.data());
+    if ((job == nullptr) || !threadPool.tryTake(job)) {
+        return false;
+    }
+    request->priority = priority;
+    threadPool.start(job, priority);
+    return true;
+}
+
+int MpvMediaProbe::probe(const QUrl &source, int priority) {
+    const int requestId = ++requestSerial;
+    auto request = RequestPtr::create();
+    request->source = source;
+    request->priority = priority;
+    request->finished = [this, requestId](const Result &result) {
+        QMetaObject::invokeMethod(
+            this,
+            [this, requestId, result]() {
+                const RequestPtr request = pendingRequests.take(requestId);
+                if (request.isNull() || request->cancelled) {
+                    return;
+                }
+                Q_EMIT probed(requestId, result.source,
+                              result.toVariantMap());
+            },
+            Qt::QueuedConnection);
+    };
+    pendingRequests.insert(requestId, request);
+    this->request(request);
+    return requestId;
+}
+
+bool MpvMediaProbe::setPriority(int requestId, int priority) {
+    return setPriority(pendingRequests.value(requestId), priority);
+}
+
+void MpvMediaProbe::cancel(int requestId) {
+    const RequestPtr request = pendingRequests.take(requestId);
+    if (!request.isNull()) {
+        request->cancelled = true;
+    }
+}
+
+void MpvMediaProbe::cancelAll() {
+    for (auto &&request : std::as_const(pendingRequests)) {
+        request->cancelled = true;
+    }
+    pendingRequests.clear();
+}
+
+QVariantMap MpvMediaProbe::cachedResult(const QUrl &source) const {
+    qint64 fileSize = -1;
+    QDateTime lastModified;
+    if (source.isLocalFile()) {
+        const QFileInfo fileInfo(source.toLocalFile());
+        if (!fileInfo.exists()) {
+            return QVariantMap();
+        }
+        fileSize = fileInfo.size();
+        lastModified = fileInfo.lastModified();
+    }
+    QMutexLocker locker(&mutex);
+    const Result *cached =
+        cache.object(cacheKey(source, fileSize, lastModified));
+    return (cached != nullptr) ? cached->toVariantMap() : QVariantMap();
+}
+
+void MpvMediaProbe::clearCache() {
+    QMutexLocker locker(&mutex);
+    cache.clear();
+}
+
+QString MpvMediaProbe::cacheKey(const QUrl &source, qint64 fileSize,
+                                const QDateTime &lastModified) {
+    return source.toString() + QChar::fromLatin1('#') +
+        QString::number(fileSize) + QChar::fromLatin1('#') +
+        QString::number(lastModified.toMSecsSinceEpoch());
+}
+
+void MpvMediaProbe::process(const RequestPtr &request) {
+    {
+        QMutexLocker locker(&mutex);
+        waitingJobs.remove(request.data());
+    }
+    Result result;
+    if (request->cancelled) {
+        result.source = request->source;
+    } else {
+        result = probeFile(request->source);
+    }
+    if (request->finished) {
+        request->finished(result);
+    }
+}
+
+MpvMediaProbe::Result MpvMediaProbe::probeFile(const QUrl &source) {
+    Result result;
+    result.source = source;
+    if (source.isLocalFile()) {
+        const QFileInfo fileInfo(source.toLocalFile());
+        if (!fileInfo.exists()) {
+            return result;
+        }
+        result.fileSize = fileInfo.size();
+        result.lastModified = fileInfo.lastModified();
+    }
+    const QString key = cacheKey(source, result.fileSize, result.lastModified);
+    {
+        QMutexLocker locker(&mutex);
+        const Result *cached = cache.object(key);
+        if (cached != nullptr) {
+            return *cached;
+        }
+    }
+    const QSharedPointer<MpvHeadlessPlayer> player = acquirePlayer();
+    if (player.isNull()) {
+        return result;
+    }
+    // Only the demuxer has to run for all of this.
+    if (player->load(source)) {
+        result.valid = true;
+        result.duration = qMax(player->property("duration").toReal(), 0.0);
+        result.fileFormat = player->property("file-format").toString();
+        result.mediaTracks = MpvObject::parseTrackList(
+            player->property("track-list").toList());
+        result.chapters = MpvObject::parseChapterList(
+            player->property("chapter-list").toList());
+        const QVariantMap metadata = player->property("metadata").toMap();
+        for (auto it = metadata.constBegin(); it != metadata.constEnd();
+             ++it) {
+            result.metadata.insert(it.key(), it.value());
+        }
+        // Audio files often come with a cover picture, which only counts if
+        // there's no real video track.
+        for (auto &&track :
+             std::as_const(result.mediaTracks.videoChannels)) {
+            const bool albumArt =
+                track.value(QString::fromUtf8("albumart")).toBool();
+            if ((result.width <= 0) || !albumArt) {
+                result.width =
+                    track.value(QString::fromUtf8("demux-w")).toInt();
+                result.height =
+                    track.value(QString::fromUtf8("demux-h")).toInt();
+            }
+            if (!albumArt) {
+                break;
+            }
+        }
+    }
+    releasePlayer(player);
+    // Failures aren't cached, the file may be back (or complete) later.
+    if (result.valid) {
+        QMutexLocker locker(&mutex);
+        cache.insert(key, new Result(result));
+    }
+    return result;
+}
+
+QSharedPointer<MpvHeadlessPlayer> MpvMediaProbe::acquirePlayer() {
+    {
+        QMutexLocker locker(&mutex);
+        if (!idlePlayers.isEmpty()) {
+            return idlePlayers.takeLast();
+        }
+    }
+    // The thread pool never runs more jobs than there are players allowed.
+    auto player = QSharedPointer<MpvHeadlessPlayer>::create();
+    if (!player->isValid()) {
+        return QSharedPointer<MpvHeadlessPlayer>();
+    }
+    // Audio and subtitles are off already. Tracks are listed all the same.
+    player->setProperty("vid", QString::fromUtf8("no"));
+    return player;
+}
+
+void MpvMediaProbe::releasePlayer(
+    const QSharedPointer<MpvHeadlessPlayer> &player) {
+    QMutexLocker locker(&mutex);
+    if (idlePlayers.count() >= threadPool.maxThreadCount()) {
+        return;
+    }
+    idlePlayers.append(player);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "mpvobject.h"
+#include <QCache>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QUrl>
+#include <QVariant>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+class MpvHeadlessPlayer;
+class MpvMediaProbeJob;
+
+// Duration, resolution, tracks, chapters and metadata of files that aren't
+// playing, for media libraries. Files are opened by a small pool of
+// headless mpv instances on worker threads, without selecting any track, so
+// nothing gets decoded. Results are cached by path, size and modification
+// time, which means a file that changed is probed again.
+// Requests with a higher priority are served first (the rows that are
+// visible, typically), and the priority of a request can still be changed
+// or the request cancelled as long as it's waiting.
+class MpvMediaProbe : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvMediaProbe)
+
+    Q_PROPERTY(int poolSize READ poolSize WRITE setPoolSize NOTIFY
+                   poolSizeChanged)
+    Q_PROPERTY(int cacheLimit READ cacheLimit WRITE setCacheLimit NOTIFY
+                   cacheLimitChanged)
+
+public:
+    struct Result {
+        QUrl source;
+        // False if the file couldn't be opened.
+        bool valid = false;
+        // -1 and invalid for anything but local files.
+        qint64 fileSize = -1;
+        QDateTime lastModified;
+        // In seconds.
+        qreal duration = 0.0;
+        // Of the first video track that isn't a cover picture.
+        int width = 0;
+        int height = 0;
+        QString fileFormat;
+        MpvObject::MediaTracks mediaTracks;
+        MpvObject::Chapters chapters;
+        MpvObject::Metadata metadata;
+
+        QVariantMap toVariantMap() const;
+    };
+
+    struct Request {
+        QUrl source;
+        // Higher first, requests of the same priority in order.
+        int priority = 0;
+        std::atomic_bool cancelled{false};
+        // Invoked exactly once, on a worker thread. The result is invalid if
+        // the request was cancelled.
+        std::function<void(const Result &)> finished;
+    };
+    using RequestPtr = QSharedPointer<Request>;
+
+    explicit MpvMediaProbe(QObject *parent = nullptr);
+    ~MpvMediaProbe() override;
+
+    static MpvMediaProbe *instance();
+
+    // Maximum number of headless players (and threads).
+    int poolSize() const;
+    // In files.
+    int cacheLimit() const;
+
+    void setPoolSize(int poolSize);
+    void setCacheLimit(int cacheLimit);
+
+    // Thread-safe. The cache is looked up on the worker thread as well, so
+    // this never touches the file system.
+    void request(const RequestPtr &request);
+    // Thread-safe. Moves a request that is still waiting, returns false if
+    // it has been started already.
+    bool setPriority(const RequestPtr &request, int priority);
+
+public Q_SLOTS:
+    // Returns the id passed to probed(), the result arrives even if it's
+    // cached.
+    int probe(const QUrl &source, int priority = 0);
+    bool setPriority(int requestId, int priority);
+    // probed() isn't emitted for cancelled requests.
+    void cancel(int requestId);
+    void cancelAll();
+    // Empty if the file hasn't been probed or has changed since. Reads the
+    // size and modification time of local files.
+    QVariantMap cachedResult(const QUrl &source) const;
+    void clearCache();
+
+private:
+    friend class MpvMediaProbeJob;
+
+    static QString cacheKey(const QUrl &source, qint64 fileSize,
+                            const QDateTime &lastModified);
+    void process(const RequestPtr &request);
+    Result probeFile(const QUrl &source);
+    QSharedPointer<MpvHeadlessPlayer> acquirePlayer();
+    void releasePlayer(const QSharedPointer<MpvHeadlessPlayer> &player);
+
+private:
+    mutable QMutex mutex;
+    QCache<QString, Result> cache;
+    QVector<QSharedPointer<MpvHeadlessPlayer>> idlePlayers;
+    // Jobs that haven't started yet, for changing their priority.
+    QHash<Request *, MpvMediaProbeJob *> waitingJobs;
+    QThreadPool threadPool;
+    int currentPoolSize = 2;
+    // Requests made from QML, only touched on the thread of this object.
+    QHash<int, RequestPtr> pendingRequests;
+    int requestSerial = 0;
+
+Q_SIGNALS:
+    void poolSizeChanged();
+    void cacheLimitChanged();
+    void probed(int requestId, const QUrl &source, const QVariantMap &result);
+};
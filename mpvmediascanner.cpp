@@ -0,0 +1,439 @@
+#include "mpvmediascanner.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <string_view>
+
+namespace {
+
+struct Suffix {
+    std::string_view name;
+    MpvMediaScanner::MediaType type;
+};
+
+constexpr auto video = MpvMediaScanner::MediaType::Video;
+constexpr auto audio = MpvMediaScanner::MediaType::Audio;
+constexpr auto subtitle = MpvMediaScanner::MediaType::Subtitle;
+
+// File types supported by mpv:
+// https://github.com/mpv-player/mpv/blob/master/player/external_files.c
+// Lower case only.
+constexpr Suffix suffixes[] = {
+    {"3g2", video}, {"3ga", video}, {"3gp", video}, {"3gp2", video},
+    {"3gpp", video}, {"amv", video}, {"asf", video}, {"asx", video},
+    {"avf", video}, {"avi", video}, {"bdm", video}, {"bdmv", video},
+    {"bik", video}, {"clpi", video}, {"cpi", video}, {"dat", video},
+    {"divx", video}, {"drc", video}, {"dv", video}, {"dvr-ms", video},
+    {"f4v", video}, {"flv", video}, {"gvi", video}, {"gxf", video},
+    {"hdmov", video}, {"hlv", video}, {"iso", video}, {"letv", video},
+    {"lrv", video}, {"m1v", video}, {"m2p", video}, {"m2t", video},
+    {"m2ts", video}, {"m2v", video}, {"m3u", video}, {"m3u8", video},
+    {"m4v", video}, {"mkv", video}, {"moov", video}, {"mov", video},
+    {"mp2", video}, {"mp2v", video}, {"mp4", video}, {"mp4v", video},
+    {"mpe", video}, {"mpeg", video}, {"mpeg1", video}, {"mpeg2", video},
+    {"mpeg4", video}, {"mpg", video}, {"mpl", video}, {"mpls", video},
+    {"mpv", video}, {"mpv2", video}, {"mqv", video}, {"mts", video},
+    {"mtv", video}, {"mxf", video}, {"mxg", video}, {"nsv", video},
+    {"nuv", video}, {"ogm", video}, {"ogv", video}, {"ogx", video},
+    {"ps", video}, {"qt", video}, {"qtvr", video}, {"ram", video},
+    {"rec", video}, {"rm", video}, {"rmj", video}, {"rmm", video},
+    {"rms", video}, {"rmvb", video}, {"rmx", video}, {"rp", video},
+    {"rpl", video}, {"rv", video}, {"rvx", video}, {"thp", video},
+    {"tod", video}, {"tp", video}, {"trp", video}, {"ts", video},
+    {"tts", video}, {"txd", video}, {"vcd", video}, {"vdr", video},
+    {"vob", video}, {"vp8", video}, {"vro", video}, {"webm", video},
+    {"wm", video}, {"wmv", video}, {"wtv", video}, {"xesc", video},
+    {"xspf", video},
+    {"mp3", audio}, {"aac", audio}, {"mka", audio}, {"dts", audio},
+    {"flac", audio}, {"ogg", audio}, {"m4a", audio}, {"ac3", audio},
+    {"opus", audio}, {"wav", audio}, {"wv", audio},
+    {"utf", subtitle}, {"utf8", subtitle}, {"utf-8", subtitle},
+    {"idx", subtitle}, {"sub", subtitle}, {"srt", subtitle}, {"rt", subtitle},
+    {"ssa", subtitle}, {"ass", subtitle}, {"mks", subtitle}, {"vtt", subtitle},
+    {"sup", subtitle}, {"scc", subtitle}, {"smi", subtitle},
+};
+
+constexpr std::size_t maximumSuffixLength = 6;
+// A power of two, a quarter of it is used at most.
+constexpr std::size_t suffixTableSize = 512;
+
+static_assert((std::size(suffixes) * 4) <= suffixTableSize);
+
+// FNV-1a.
+constexpr quint32 suffixHash(std::string_view suffix) {
+    quint32 hash = 2166136261u;
+    for (const char c : suffix) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Open addressing with linear probing. Slots hold the index into suffixes
+// plus one, zero is empty.
+struct SuffixTable {
+    std::array<quint8, suffixTableSize> slots{};
+};
+
+static_assert(std::size(suffixes) < 256);
+
+constexpr SuffixTable makeSuffixTable() {
+    SuffixTable table{};
+    for (std::size_t i = 0; i != std::size(suffixes); ++i) {
+        std::size_t slot =
+            suffixHash(suffixes[i].name) & (suffixTableSize - 1);
+        while (table.slots[slot] != 0) {
+            slot = (slot + 1) & (suffixTableSize - 1);
+        }
+        table.slots[slot] = static_cast<quint8>(i + 1);
+    }
+    return table;
+}
+
+constexpr bool suffixesAreValid() {
+    for (std::size_t i = 0; i != std::size(suffixes); ++i) {
+        const std::string_view name = suffixes[i].name;
+        if (name.empty() || (name.size() > maximumSuffixLength)) {
+            return false;
+        }
+        for (const char c : name) {
+            if ((c >= 'A') && (c <= 'Z')) {
+                return false;
+            }
+        }
+        for (std::size_t j = 0; j != i; ++j) {
+            if (suffixes[j].name == name) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(suffixesAreValid(),
+              "Suffixes must be unique, short and in lower case.");
+
+constexpr SuffixTable suffixTable = makeSuffixTable();
+
+QVariantList toUrlList(const QStringList &filePaths) {
+    QVariantList urls;
+    urls.reserve(filePaths.count());
+    for (auto &&filePath : std::as_const(filePaths)) {
+        urls.append(QUrl::fromLocalFile(filePath));
+    }
+    return urls;
+}
+
+} // namespace
+
+struct MpvMediaScanner::Scan {
+    std::atomic_bool cancelled{false};
+    // Directories queued or being listed, the scan is done at zero.
+    std::atomic_int pendingDirectories{0};
+    bool recursive = true;
+    MatchMode matchMode = MatchMode::Exact;
+};
+
+MpvMediaScanner::MpvMediaScanner(QObject *parent)
+    : QAbstractListModel(parent) {}
+
+MpvMediaScanner::~MpvMediaScanner() {
+    if (!currentScan.isNull()) {
+        currentScan->cancelled = true;
+    }
+    threadPool.clear();
+    threadPool.waitForDone();
+}
+
+int MpvMediaScanner::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : entries.count();
+}
+
+QVariant MpvMediaScanner::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || (index.row() < 0) ||
+        (index.row() >= entries.count())) {
+        return QVariant();
+    }
+    const Entry &entry = entries.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case FileNameRole:
+        return entry.filePath.mid(
+            entry.filePath.lastIndexOf(QChar::fromLatin1('/')) + 1);
+    case UrlRole:
+        return QUrl::fromLocalFile(entry.filePath);
+    case MediaTypeRole:
+        return static_cast<int>(entry.type);
+    case FileSizeRole:
+        return entry.fileSize;
+    case SubtitlesRole:
+        return toUrlList(entry.subtitles);
+    case AudioFilesRole:
+        return toUrlList(entry.audioFiles);
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> MpvMediaScanner::roleNames() const {
+    return QHash<int, QByteArray>{{UrlRole, "url"},
+                                  {FileNameRole, "fileName"},
+                                  {MediaTypeRole, "mediaType"},
+                                  {FileSizeRole, "fileSize"},
+                                  {SubtitlesRole, "subtitles"},
+                                  {AudioFilesRole, "audioFiles"}};
+}
+
+int MpvMediaScanner::count() const { return entries.count(); }
+
+bool MpvMediaScanner::scanning() const { return !currentScan.isNull(); }
+
+MpvMediaScanner::MatchMode MpvMediaScanner::matchMode() const {
+    return currentMatchMode;
+}
+
+void MpvMediaScanner::setMatchMode(MatchMode matchMode) {
+    if (currentMatchMode == matchMode) {
+        return;
+    }
+    // Takes effect with the next scan.
+    currentMatchMode = matchMode;
+    Q_EMIT matchModeChanged();
+}
+
+MpvMediaScanner::Entry MpvMediaScanner::entry(int index) const {
+    return ((index >= 0) && (index < entries.count())) ? entries.at(index)
+                                                       : Entry();
+}
+
+MpvMediaScanner::MediaType MpvMediaScanner::classify(QStringView fileName) {
+    const qsizetype dot = fileName.lastIndexOf(QChar::fromLatin1('.'));
+    if (dot < 0) {
+        return MediaType::Unknown;
+    }
+    const QStringView suffix = fileName.mid(dot + 1);
+    if (suffix.isEmpty() ||
+        (static_cast<std::size_t>(suffix.size()) > maximumSuffixLength)) {
+        return MediaType::Unknown;
+    }
+    char buffer[maximumSuffixLength];
+    for (qsizetype i = 0; i != suffix.size(); ++i) {
+        const char16_t c = suffix.at(i).unicode();
+        if (c >= 0x80) {
+            return MediaType::Unknown;
+        }
+        buffer[i] = ((c >= u'A') && (c <= u'Z'))
+            ? static_cast<char>(c - u'A' + u'a')
+            : static_cast<char>(c);
+    }
+    const std::string_view name(buffer,
+                                static_cast<std::size_t>(suffix.size()));
+    std::size_t slot = suffixHash(name) & (suffixTableSize - 1);
+    while (suffixTable.slots[slot] != 0) {
+        const Suffix &candidate = suffixes[suffixTable.slots[slot] - 1];
+        if (candidate.name == name) {
+            return candidate.type;
+        }
+        slot = (slot + 1) & (suffixTableSize - 1);
+    }
+    return MediaType::Unknown;
+}
+
+QStringList MpvMediaScanner::nameFilters(MediaType type) {
+    QStringList filters;
+    for (auto &&suffix : suffixes) {
+        if (suffix.type == type) {
+            filters.append(QString::fromUtf8("*.") +
+                           QString::fromLatin1(suffix.name.data(),
+                                               static_cast<int>(
+                                                   suffix.name.size())));
+        }
+    }
+    return filters;
+}
+
+void MpvMediaScanner::scan(const QUrl &folder, bool recursive) {
+    if (!folder.isLocalFile()) {
+        qWarning().noquote() << "Only local folders can be scanned:"
+                             << folder;
+        return;
+    }
+    const bool wasScanning = !currentScan.isNull();
+    if (wasScanning) {
+        currentScan->cancelled = true;
+        threadPool.clear();
+    }
+    const bool hadEntries = !entries.isEmpty();
+    beginResetModel();
+    entries.clear();
+    endResetModel();
+    currentScan = ScanPtr::create();
+    currentScan->recursive = recursive;
+    currentScan->matchMode = currentMatchMode;
+    startDirectory(currentScan, folder.toLocalFile());
+    if (hadEntries) {
+        Q_EMIT countChanged();
+    }
+    if (!wasScanning) {
+        Q_EMIT scanningChanged();
+    }
+}
+
+void MpvMediaScanner::cancel() {
+    if (currentScan.isNull()) {
+        return;
+    }
+    // Directories that are being listed right now still finish, but their
+    // files are dropped.
+    currentScan->cancelled = true;
+    threadPool.clear();
+    currentScan.reset();
+    Q_EMIT scanningChanged();
+}
+
+void MpvMediaScanner::clear() {
+    cancel();
+    if (entries.isEmpty()) {
+        return;
+    }
+    beginResetModel();
+    entries.clear();
+    endResetModel();
+    Q_EMIT countChanged();
+}
+
+MpvMediaScanner::MediaType
+MpvMediaScanner::mediaType(const QString &fileName) const {
+    return classify(fileName);
+}
+
+void MpvMediaScanner::startDirectory(const ScanPtr &scan,
+                                     const QString &path) {
+    ++scan->pendingDirectories;
+    threadPool.start([this, scan, path]() { scanDirectory(scan, path); });
+}
+
+void MpvMediaScanner::scanDirectory(const ScanPtr &scan,
+                                    const QString &path) {
+    if (!scan->cancelled) {
+        const QFileInfoList fileInfos = QDir(path).entryInfoList(
+            QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot,
+            QDir::Name | QDir::IgnoreCase);
+        // Videos and audio files, in the order of the directory listing.
+        QFileInfoList media;
+        QFileInfoList subtitles;
+        QFileInfoList audioFiles;
+        for (auto &&fileInfo : std::as_const(fileInfos)) {
+            if (fileInfo.isDir()) {
+                // Symbolic links could lead into a loop.
+                if (scan->recursive && !fileInfo.isSymLink()) {
+                    startDirectory(scan, fileInfo.filePath());
+                }
+                continue;
+            }
+            switch (classify(fileInfo.fileName())) {
+            case MediaType::Video:
+                media.append(fileInfo);
+                break;
+            case MediaType::Audio:
+                media.append(fileInfo);
+                audioFiles.append(fileInfo);
+                break;
+            case MediaType::Subtitle:
+                subtitles.append(fileInfo);
+                break;
+            default:
+                break;
+            }
+        }
+        QVector<Entry> newEntries;
+        newEntries.reserve(media.count());
+        QSet<QString> companionAudioFiles;
+        for (auto &&fileInfo : std::as_const(media)) {
+            Entry entry;
+            entry.filePath = fileInfo.filePath();
+            entry.type = classify(fileInfo.fileName());
+            entry.fileSize = fileInfo.size();
+            if (entry.type == MediaType::Video) {
+                const QString baseName = fileInfo.completeBaseName();
+                for (auto &&subtitle : std::as_const(subtitles)) {
+                    if (isCompanion(subtitle.completeBaseName(), baseName,
+                                    scan->matchMode)) {
+                        entry.subtitles.append(subtitle.filePath());
+                    }
+                }
+                for (auto &&audioFile : std::as_const(audioFiles)) {
+                    if (isCompanion(audioFile.completeBaseName(), baseName,
+                                    scan->matchMode)) {
+                        entry.audioFiles.append(audioFile.filePath());
+                        companionAudioFiles.insert(audioFile.filePath());
+                    }
+                }
+            }
+            newEntries.append(entry);
+        }
+        // The audio files of a video may come before the video itself.
+        newEntries.erase(
+            std::remove_if(newEntries.begin(), newEntries.end(),
+                           [&companionAudioFiles](const Entry &entry) {
+                               return (entry.type == MediaType::Audio) &&
+                                   companionAudioFiles.contains(
+                                       entry.filePath);
+                           }),
+            newEntries.end());
+        if (!newEntries.isEmpty() && !scan->cancelled) {
+            QMetaObject::invokeMethod(
+                this,
+                [this, scan, newEntries]() {
+                    appendEntries(scan, newEntries);
+                },
+                Qt::QueuedConnection);
+        }
+    }
+    // Subdirectories have been counted already, and their entries are
+    // posted before this.
+    if (--scan->pendingDirectories == 0) {
+        QMetaObject::invokeMethod(
+            this, [this, scan]() { finishScan(scan); },
+            Qt::QueuedConnection);
+    }
+}
+
+void MpvMediaScanner::appendEntries(const ScanPtr &scan,
+                                    const QVector<Entry> &newEntries) {
+    if (scan != currentScan) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), entries.count(),
+                    entries.count() + newEntries.count() - 1);
+    entries.append(newEntries);
+    endInsertRows();
+    Q_EMIT countChanged();
+}
+
+void MpvMediaScanner::finishScan(const ScanPtr &scan) {
+    if (scan != currentScan) {
+        return;
+    }
+    currentScan.reset();
+    Q_EMIT scanningChanged();
+    Q_EMIT finished();
+}
+
+bool MpvMediaScanner::isCompanion(const QString &companion,
+                                  const QString &media, MatchMode matchMode) {
+    if (matchMode == MatchMode::Fuzzy) {
+        return companion.contains(media, Qt::CaseInsensitive);
+    }
+    // Language tags ("movie.en.srt") are allowed in exact mode as well.
+    return companion.startsWith(media, Qt::CaseInsensitive) &&
+        ((companion.size() == media.size()) ||
+         (companion.at(media.size()) == QChar::fromLatin1('.')));
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThreadPool>
+#include <QUrl>
+#include <QVector>
+#include <QtQml/qqml.h>
+
+// Finds the media files in a directory tree for file browsers and media
+// libraries. Directories are listed in parallel on a thread pool, and the
+// files of each directory are added to the model as soon as it has been
+// listed, so views fill up while the scan goes on. Files are classified by
+// their suffix alone (see classify()), with the suffixes mpv knows about.
+// Subtitles and audio files of the same directory are attached to the
+// videos they belong to, the way mpv's sub-auto and audio-file-auto options
+// pick them, and are not listed on their own. Subtitles never are, audio
+// files that don't belong to a video are.
+class MpvMediaScanner : public QAbstractListModel {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvMediaScanner)
+
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(bool scanning READ scanning NOTIFY scanningChanged)
+    Q_PROPERTY(MpvMediaScanner::MatchMode matchMode READ matchMode WRITE
+                   setMatchMode NOTIFY matchModeChanged)
+
+    QML_ELEMENT
+
+public:
+    enum class MediaType { Unknown, Video, Audio, Subtitle };
+    Q_ENUM(MediaType)
+
+    // Same as the values of sub-auto and audio-file-auto. Exact matches
+    // "movie.srt" and "movie.en.srt" for "movie.mkv", Fuzzy matches
+    // everything that contains "movie".
+    enum class MatchMode { Exact, Fuzzy };
+    Q_ENUM(MatchMode)
+
+    enum Roles {
+        UrlRole = Qt::UserRole + 1,
+        FileNameRole,
+        MediaTypeRole,
+        FileSizeRole,
+        SubtitlesRole,
+        AudioFilesRole
+    };
+    Q_ENUM(Roles)
+
+    struct Entry {
+        QString filePath;
+        MediaType type = MediaType::Unknown;
+        qint64 fileSize = 0;
+        QStringList subtitles;
+        QStringList audioFiles;
+    };
+
+    explicit MpvMediaScanner(QObject *parent = nullptr);
+    ~MpvMediaScanner() override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index,
+                  int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const;
+    bool scanning() const;
+    MpvMediaScanner::MatchMode matchMode() const;
+
+    void setMatchMode(MatchMode matchMode);
+
+    Entry entry(int index) const;
+
+    // Case-insensitive, by the last suffix of the file name (or path), in
+    // constant time. Thread-safe.
+    static MediaType classify(QStringView fileName);
+    // "*.suffix" patterns of the given type, for QDir and file dialogs.
+    static QStringList nameFilters(MediaType type);
+
+public Q_SLOTS:
+    // Drops the current results. Local folders only.
+    void scan(const QUrl &folder, bool recursive = true);
+    // Stops scanning, the files found so far stay.
+    void cancel();
+    void clear();
+    MpvMediaScanner::MediaType mediaType(const QString &fileName) const;
+
+private:
+    struct Scan;
+    using ScanPtr = QSharedPointer<Scan>;
+
+    void startDirectory(const ScanPtr &scan, const QString &path);
+    void scanDirectory(const ScanPtr &scan, const QString &path);
+    void appendEntries(const ScanPtr &scan, const QVector<Entry> &newEntries);
+    void finishScan(const ScanPtr &scan);
+    static bool isCompanion(const QString &companion, const QString &media,
+                            MatchMode matchMode);
+
+private:
+    QVector<Entry> entries;
+    QThreadPool threadPool;
+    ScanPtr currentScan;
+    MatchMode currentMatchMode = MatchMode::Exact;
+
+Q_SIGNALS:
+    void countChanged();
+    void scanningChanged();
+    void matchModeChanged();
+    // The whole tree has been scanned (not emitted if cancelled).
+    void finished();
+};
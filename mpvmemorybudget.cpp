@@ -0,0 +1,286 @@
+#include "mpvmemorybudget.h"
+#include "mpvobject.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+
+MpvMemoryBudget::MpvMemoryBudget(QObject *parent) : QObject(parent) {}
+
+MpvMemoryBudget::~MpvMemoryBudget() = default;
+
+MpvMemoryBudget *MpvMemoryBudget::instance() {
+    // Parented to the application object so that it goes away together with
+    // all the players, and so that the QML engine never takes ownership.
+    static QPointer<MpvMemoryBudget> budget;
+    if (budget.isNull()) {
+        budget = new MpvMemoryBudget(QCoreApplication::instance());
+    }
+    return budget;
+}
+
+qint64 MpvMemoryBudget::totalBudget() const { return currentTotalBudget; }
+
+qint64 MpvMemoryBudget::minimumShare() const { return currentMinimumShare; }
+
+qint64 MpvMemoryBudget::maximumShare() const { return currentMaximumShare; }
+
+qreal MpvMemoryBudget::backBufferRatio() const {
+    return currentBackBufferRatio;
+}
+
+int MpvMemoryBudget::playerCount() const { return players.count(); }
+
+qint64 MpvMemoryBudget::totalAllocated() const {
+    qint64 total = 0;
+    for (auto &&share : std::as_const(players)) {
+        total += share.allocation;
+    }
+    return total + (standbyCount * currentStandbyShare);
+}
+
+qint64 MpvMemoryBudget::standbyShare() const { return currentStandbyShare; }
+
+void MpvMemoryBudget::setTotalBudget(qint64 totalBudget) {
+    if (totalBudget <= 0 || totalBudget == currentTotalBudget) {
+        return;
+    }
+    currentTotalBudget = totalBudget;
+    Q_EMIT totalBudgetChanged();
+    scheduleRebalance();
+}
+
+void MpvMemoryBudget::setMinimumShare(qint64 minimumShare) {
+    if (minimumShare <= 0 || minimumShare == currentMinimumShare) {
+        return;
+    }
+    if (minimumShare > currentMaximumShare) {
+        qWarning().noquote()
+            << "The minimum share can't be larger than the maximum share.";
+        return;
+    }
+    currentMinimumShare = minimumShare;
+    Q_EMIT minimumShareChanged();
+    scheduleRebalance();
+}
+
+void MpvMemoryBudget::setMaximumShare(qint64 maximumShare) {
+    if (maximumShare <= 0 || maximumShare == currentMaximumShare) {
+        return;
+    }
+    if (maximumShare < currentMinimumShare) {
+        qWarning().noquote()
+            << "The maximum share can't be smaller than the minimum share.";
+        return;
+    }
+    currentMaximumShare = maximumShare;
+    Q_EMIT maximumShareChanged();
+    scheduleRebalance();
+}
+
+void MpvMemoryBudget::setBackBufferRatio(qreal backBufferRatio) {
+    backBufferRatio = qBound(0.0, backBufferRatio, 1.0);
+    if (qFuzzyCompare(backBufferRatio, currentBackBufferRatio)) {
+        return;
+    }
+    currentBackBufferRatio = backBufferRatio;
+    Q_EMIT backBufferRatioChanged();
+    scheduleRebalance();
+}
+
+void MpvMemoryBudget::registerPlayer(MpvObject *player) {
+    if (player == nullptr) {
+        return;
+    }
+    for (auto &&share : std::as_const(players)) {
+        if (share.player == player) {
+            return;
+        }
+    }
+    Share share;
+    share.player = player;
+    players.append(share);
+    connect(player, &QQuickItem::visibleChanged, this,
+            &MpvMemoryBudget::scheduleRebalance);
+    connect(player, &QQuickItem::activeFocusChanged, this,
+            &MpvMemoryBudget::scheduleRebalance);
+    connect(player, &MpvObject::memoryPriorityChanged, this,
+            &MpvMemoryBudget::scheduleRebalance);
+    // Not deferred: a new standby player starts caching right away.
+    connect(player, &MpvObject::standbySourcesChanged, this,
+            &MpvMemoryBudget::rebalance);
+    // The new player must never start with mpv's default limits, otherwise
+    // its first file can overshoot the budget before the deferred rebalance
+    // kicks in.
+    rebalance();
+}
+
+void MpvMemoryBudget::unregisterPlayer(MpvObject *player) {
+    bool found = false;
+    for (int i = players.count() - 1; i >= 0; --i) {
+        if (players.at(i).player.isNull() || players.at(i).player == player) {
+            players.removeAt(i);
+            found = true;
+        }
+    }
+    if (found) {
+        disconnect(player, nullptr, this, nullptr);
+        scheduleRebalance();
+    }
+}
+
+qint64 MpvMemoryBudget::allocation(MpvObject *player) const {
+    for (auto &&share : std::as_const(players)) {
+        if (share.player == player) {
+            return share.allocation;
+        }
+    }
+    return 0;
+}
+
+qint64 MpvMemoryBudget::usage(MpvObject *player) const {
+    if (player == nullptr) {
+        return 0;
+    }
+    return player->demuxerCacheUsage();
+}
+
+qint64 MpvMemoryBudget::totalUsage() const {
+    qint64 total = 0;
+    for (auto &&share : std::as_const(players)) {
+        total += usage(share.player);
+    }
+    return total;
+}
+
+QVariantList MpvMemoryBudget::snapshot() const {
+    QVariantList list;
+    for (auto &&share : std::as_const(players)) {
+        if (share.player.isNull()) {
+            continue;
+        }
+        QVariantMap entry;
+        entry[QString::fromUtf8("player")] =
+            QVariant::fromValue(share.player.data());
+        entry[QString::fromUtf8("allocation")] = share.allocation;
+        entry[QString::fromUtf8("usage")] = usage(share.player);
+        entry[QString::fromUtf8("weight")] = share.weight;
+        list.append(entry);
+    }
+    return list;
+}
+
+void MpvMemoryBudget::scheduleRebalance() {
+    if (rebalancePending) {
+        return;
+    }
+    rebalancePending = true;
+    QMetaObject::invokeMethod(this, "rebalance", Qt::QueuedConnection);
+}
+
+int MpvMemoryBudget::weight(const MpvObject *player) const {
+    if (player == nullptr) {
+        return 0;
+    }
+    // Hidden tiles only need enough cache to keep running, the focused one
+    // should be able to survive network hiccups.
+    if (!player->isVisible()) {
+        return 1;
+    }
+    if (player->hasActiveFocus()) {
+        return 8;
+    }
+    switch (player->memoryPriority()) {
+    case MpvObject::MemoryPriority::Low:
+        return 2;
+    case MpvObject::MemoryPriority::Normal:
+        return 4;
+    case MpvObject::MemoryPriority::High:
+        return 8;
+    }
+    return 4;
+}
+
+void MpvMemoryBudget::rebalance() {
+    rebalancePending = false;
+    for (int i = players.count() - 1; i >= 0; --i) {
+        if (players.at(i).player.isNull()) {
+            players.removeAt(i);
+        }
+    }
+    if (players.isEmpty()) {
+        standbyCount = 0;
+        Q_EMIT rebalanced();
+        return;
+    }
+    standbyCount = 0;
+    for (auto &&share : std::as_const(players)) {
+        standbyCount += share.player->standbyPlayers.count();
+    }
+    // Every player and every standby player gets the minimum share first,
+    // or an even part of the budget if that doesn't fit. mpv still plays
+    // with a small cache, but the process may not survive a budget overrun.
+    const qint64 count = players.count();
+    const qint64 baseShare =
+        qMin(currentMinimumShare, currentTotalBudget / (count + standbyCount));
+    if (baseShare < currentMinimumShare) {
+        qWarning().noquote()
+            << "Memory budget exhausted: every player gets less than the "
+               "minimum share.";
+    }
+    // Water-filling: the rest is split by weight on top of that, players
+    // that would get more than the maximum are capped and the excess goes
+    // back to the others.
+    QVector<qint64> allocations(players.count(), -1);
+    // Standby players don't get more than that, they are hidden anyway.
+    currentStandbyShare = baseShare;
+    qint64 remaining =
+        currentTotalBudget - ((count + standbyCount) * baseShare);
+    const qint64 maximumExtra = currentMaximumShare - baseShare;
+    bool capped = true;
+    while (capped) {
+        capped = false;
+        qint64 totalWeight = 0;
+        for (int i = 0; i != players.count(); ++i) {
+            players[i].weight = weight(players.at(i).player);
+            if (allocations.at(i) < 0) {
+                totalWeight += players.at(i).weight;
+            }
+        }
+        if (totalWeight <= 0) {
+            break;
+        }
+        for (int i = 0; i != players.count(); ++i) {
+            if (allocations.at(i) >= 0) {
+                continue;
+            }
+            const qint64 share = remaining * players.at(i).weight / totalWeight;
+            if (share > maximumExtra) {
+                allocations[i] = maximumExtra;
+                remaining -= maximumExtra;
+                capped = true;
+            }
+        }
+        if (!capped) {
+            for (int i = 0; i != players.count(); ++i) {
+                if (allocations.at(i) < 0) {
+                    allocations[i] =
+                        remaining * players.at(i).weight / totalWeight;
+                }
+            }
+        }
+    }
+    for (int i = 0; i != players.count(); ++i) {
+        players.at(i).player->setStandbyCacheLimit(currentStandbyShare);
+        const qint64 allocation =
+            baseShare + qMax(allocations.at(i), qint64(0));
+        Share &share = players[i];
+        if (share.allocation == allocation) {
+            continue;
+        }
+        share.allocation = allocation;
+        const auto backBytes =
+            static_cast<qint64>(allocation * currentBackBufferRatio);
+        share.player->setDemuxerCacheLimits(allocation - backBytes, backBytes);
+    }
+    Q_EMIT rebalanced();
+}
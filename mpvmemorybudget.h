@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QVariant>
+#include <QVector>
+
+class MpvObject;
+
+// Process-wide demuxer cache budget. Every MpvObject registers itself here
+// and gets a slice of the total budget instead of mpv's default limits
+// (150MiB forward + 50MiB backward per player), so opening one more player
+// shrinks the others instead of pushing the process out of memory.
+class MpvMemoryBudget : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvMemoryBudget)
+
+    Q_PROPERTY(qint64 totalBudget READ totalBudget WRITE setTotalBudget NOTIFY
+                   totalBudgetChanged)
+    Q_PROPERTY(qint64 minimumShare READ minimumShare WRITE setMinimumShare
+                   NOTIFY minimumShareChanged)
+    Q_PROPERTY(qint64 maximumShare READ maximumShare WRITE setMaximumShare
+                   NOTIFY maximumShareChanged)
+    Q_PROPERTY(qreal backBufferRatio READ backBufferRatio WRITE
+                   setBackBufferRatio NOTIFY backBufferRatioChanged)
+    Q_PROPERTY(int playerCount READ playerCount NOTIFY rebalanced)
+    Q_PROPERTY(qint64 totalAllocated READ totalAllocated NOTIFY rebalanced)
+    Q_PROPERTY(qint64 standbyShare READ standbyShare NOTIFY rebalanced)
+
+public:
+    explicit MpvMemoryBudget(QObject *parent = nullptr);
+    ~MpvMemoryBudget() override;
+
+    static MpvMemoryBudget *instance();
+
+    // Total amount of bytes all players may use for their demuxer caches
+    // (forward and backward buffers together).
+    qint64 totalBudget() const;
+    // No player gets less than this, as long as the budget can hold it for
+    // every player. Beyond that the budget is split evenly, it is never
+    // exceeded. Never more than maximumShare.
+    qint64 minimumShare() const;
+    // No player gets more than this, even if the budget would allow it.
+    // Never less than minimumShare.
+    qint64 maximumShare() const;
+    // Part of each share that goes to --demuxer-max-back-bytes (0.0-1.0).
+    qreal backBufferRatio() const;
+    int playerCount() const;
+    // Sum of all shares handed out by the last rebalance, standby players
+    // included.
+    qint64 totalAllocated() const;
+    // Bytes each standby player gets. They are reserved before the players'
+    // shares are computed: no more than the minimum share, and less if the
+    // budget can't hold that for everyone.
+    qint64 standbyShare() const;
+
+    void setTotalBudget(qint64 totalBudget);
+    void setMinimumShare(qint64 minimumShare);
+    void setMaximumShare(qint64 maximumShare);
+    void setBackBufferRatio(qreal backBufferRatio);
+
+    // Called by MpvObject itself, there's no need to call them manually.
+    void registerPlayer(MpvObject *player);
+    void unregisterPlayer(MpvObject *player);
+
+public Q_SLOTS:
+    // Bytes handed to the given player (forward + backward).
+    qint64 allocation(MpvObject *player) const;
+    // Bytes the given player's demuxer cache currently holds, as last
+    // reported by mpv.
+    qint64 usage(MpvObject *player) const;
+    // Sum of usage() of all registered players.
+    qint64 totalUsage() const;
+    // One entry per player: allocation, usage and weight.
+    QVariantList snapshot() const;
+    // Rebalancing is cheap, but it's done at most once per event loop
+    // iteration anyway.
+    void scheduleRebalance();
+    void rebalance();
+
+private:
+    int weight(const MpvObject *player) const;
+
+private:
+    struct Share {
+        QPointer<MpvObject> player;
+        qint64 allocation = 0;
+        int weight = 0;
+    };
+    QVector<Share> players;
+    // Number of standby players as of the last rebalance.
+    int standbyCount = 0;
+    qint64 currentStandbyShare = 8 * 1024 * 1024;
+
+    qint64 currentTotalBudget = 512 * 1024 * 1024;
+    qint64 currentMinimumShare = 8 * 1024 * 1024;
+    qint64 currentMaximumShare = 200 * 1024 * 1024;
+    qreal currentBackBufferRatio = 0.25;
+    bool rebalancePending = false;
+
+Q_SIGNALS:
+    void totalBudgetChanged();
+    void minimumShareChanged();
+    void maximumShareChanged();
+    void backBufferRatioChanged();
+    void rebalanced();
+};
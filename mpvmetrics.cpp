@@ -0,0 +1,171 @@
+#include "mpvmetrics.h"
+#include "mpvobject.h"
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+
+namespace {
+
+constexpr qint64 nanosecondsPerSecond = 1000000000;
+
+} // namespace
+
+quint64 MpvPlayerMetrics::PropertyRate::perSecond(qint64 now) const {
+    const qint64 elapsed = now - windowStart;
+    if (elapsed >= (2 * nanosecondsPerSecond)) {
+        return 0;
+    }
+    return (elapsed >= nanosecondsPerSecond) ? current : lastSecond;
+}
+
+void MpvPlayerMetrics::finishAsyncRequest() {
+    // Replies to requests made before a standby player took over arrive on
+    // the other handle, never go below zero because of them.
+    qint64 inFlight = asyncInFlight.load(std::memory_order_relaxed);
+    while ((inFlight > 0) &&
+           !asyncInFlight.compare_exchange_weak(inFlight, inFlight - 1,
+                                                std::memory_order_relaxed)) {
+    }
+}
+
+void MpvPlayerMetrics::recordPropertyChange(const char *name) {
+    const qint64 now = steadyClockNanoseconds();
+    PropertyRate &rate = propertyChanges[QByteArray(name)];
+    const qint64 elapsed = now - rate.windowStart;
+    if (elapsed >= nanosecondsPerSecond) {
+        rate.lastSecond =
+            (elapsed < (2 * nanosecondsPerSecond)) ? rate.current : 0;
+        rate.current = 0;
+        rate.windowStart = now;
+    }
+    ++rate.current;
+    ++rate.total;
+}
+
+QVariantMap MpvPlayerMetrics::toVariantMap() const {
+    const qint64 now = steadyClockNanoseconds();
+    QVariantMap map;
+    map[QString::fromUtf8("syncGetProperty")] =
+        syncGetProperty.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("syncGetPropertyTime")] =
+        syncGetPropertyTime.toVariantMap();
+    map[QString::fromUtf8("eventDrains")] =
+        eventDrains.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("events")] = events.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("eventDrainTime")] = eventDrainTime.toVariantMap();
+    map[QString::fromUtf8("queueOverflows")] =
+        queueOverflows.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("asyncRequests")] =
+        asyncRequests.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("asyncInFlight")] =
+        asyncInFlight.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("renders")] =
+        renders.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("skippedRenders")] =
+        skippedRenders.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("renderTime")] = renderTime.toVariantMap();
+    map[QString::fromUtf8("frameInterval")] = frameInterval.toVariantMap();
+    map[QString::fromUtf8("seekLatency")] = seekLatency.toVariantMap();
+    QVariantMap properties;
+    for (auto it = propertyChanges.cbegin(); it != propertyChanges.cend();
+         ++it) {
+        QVariantMap property;
+        property[QString::fromUtf8("total")] = it->total;
+        property[QString::fromUtf8("perSecond")] = it->perSecond(now);
+        properties[QString::fromUtf8(it.key())] = property;
+    }
+    map[QString::fromUtf8("propertyChanges")] = properties;
+    return map;
+}
+
+MpvMetrics::MpvMetrics(QObject *parent) : QObject(parent) {}
+
+MpvMetrics::~MpvMetrics() = default;
+
+MpvMetrics *MpvMetrics::instance() {
+    static QPointer<MpvMetrics> metrics;
+    if (metrics.isNull()) {
+        metrics = new MpvMetrics(QCoreApplication::instance());
+    }
+    return metrics;
+}
+
+int MpvMetrics::playerCount() const { return players.count(); }
+
+void MpvMetrics::registerPlayer(MpvObject *player) {
+    if ((player == nullptr) || players.contains(player)) {
+        return;
+    }
+    players.append(player);
+    Q_EMIT playerCountChanged();
+}
+
+void MpvMetrics::unregisterPlayer(MpvObject *player) {
+    bool found = false;
+    for (int i = players.count() - 1; i >= 0; --i) {
+        if (players.at(i).isNull() || (players.at(i) == player)) {
+            players.removeAt(i);
+            found = true;
+        }
+    }
+    if (found) {
+        Q_EMIT playerCountChanged();
+    }
+}
+
+QVariantMap MpvMetrics::snapshot() const {
+    const qint64 now = steadyClockNanoseconds();
+    QVariantList list;
+    MpvPlayerMetrics total;
+    for (auto &&player : std::as_const(players)) {
+        if (player.isNull()) {
+            continue;
+        }
+        const MpvPlayerMetrics &metrics = player->playerMetrics();
+        QVariantMap entry = metrics.toVariantMap();
+        entry[QString::fromUtf8("objectName")] = player->objectName();
+        entry[QString::fromUtf8("source")] = player->source().toString();
+        list.append(entry);
+
+        const auto sum = [](std::atomic<quint64> &to,
+                            const std::atomic<quint64> &from) {
+            to.fetch_add(from.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+        };
+        sum(total.syncGetProperty, metrics.syncGetProperty);
+        total.syncGetPropertyTime.add(metrics.syncGetPropertyTime);
+        sum(total.eventDrains, metrics.eventDrains);
+        sum(total.events, metrics.events);
+        total.eventDrainTime.add(metrics.eventDrainTime);
+        sum(total.queueOverflows, metrics.queueOverflows);
+        sum(total.asyncRequests, metrics.asyncRequests);
+        total.asyncInFlight.fetch_add(
+            metrics.asyncInFlight.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+        sum(total.renders, metrics.renders);
+        sum(total.skippedRenders, metrics.skippedRenders);
+        total.renderTime.add(metrics.renderTime);
+        total.frameInterval.add(metrics.frameInterval);
+        total.seekLatency.add(metrics.seekLatency);
+        for (auto it = metrics.propertyChanges.cbegin();
+             it != metrics.propertyChanges.cend(); ++it) {
+            MpvPlayerMetrics::PropertyRate &rate =
+                total.propertyChanges[it.key()];
+            rate.total += it->total;
+            // Current as of now, see PropertyRate::perSecond().
+            rate.lastSecond += it->perSecond(now);
+            rate.windowStart = now;
+        }
+    }
+    QVariantMap map;
+    map[QString::fromUtf8("players")] = list;
+    map[QString::fromUtf8("total")] = total.toVariantMap();
+    return map;
+}
+
+QString MpvMetrics::snapshotJson(bool compact) const {
+    return QString::fromUtf8(
+        QJsonDocument::fromVariant(snapshot())
+            .toJson(compact ? QJsonDocument::Compact
+                            : QJsonDocument::Indented));
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "mpvhistogram.hpp"
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QVariant>
+#include <QVector>
+#include <atomic>
+
+class MpvObject;
+
+// What the wrapper itself costs, for one player. The counters and
+// histograms are relaxed atomics and can be updated from any thread (the
+// render thread updates the render ones). The property change table is
+// only touched on the GUI thread, where the events are handled.
+struct MpvPlayerMetrics {
+    MpvPlayerMetrics() = default;
+    Q_DISABLE_COPY_MOVE(MpvPlayerMetrics)
+
+    // Synchronous mpv_get_property() calls and how long each of them
+    // blocked the caller, in microseconds.
+    std::atomic<quint64> syncGetProperty{0};
+    MpvHistogram syncGetPropertyTime;
+    // handleMpvEvents() calls, the events they handled and how long each
+    // of them took, in microseconds.
+    std::atomic<quint64> eventDrains{0};
+    std::atomic<quint64> events{0};
+    MpvHistogram eventDrainTime;
+    std::atomic<quint64> queueOverflows{0};
+    // Asynchronous commands and property writes, and those still waiting
+    // for their reply.
+    std::atomic<quint64> asyncRequests{0};
+    std::atomic<qint64> asyncInFlight{0};
+    // Render passes, the ones without a new frame and how long
+    // mpv_render_context_render() took, in microseconds.
+    std::atomic<quint64> renders{0};
+    std::atomic<quint64> skippedRenders{0};
+    MpvHistogram renderTime;
+    // Time between two render passes with a new frame, in microseconds.
+    // The narrower, the more even the frame pacing.
+    MpvHistogram frameInterval;
+    // Time from sending a seek to the first frame rendered after it, in
+    // microseconds.
+    MpvHistogram seekLatency;
+
+    void finishAsyncRequest();
+    // GUI thread only.
+    void recordPropertyChange(const char *name);
+    // GUI thread only. Counters, histograms (MpvHistogram::toVariantMap())
+    // and "propertyChanges", a map of property name to its total count and
+    // the number of changes during the last full second.
+    QVariantMap toVariantMap() const;
+
+private:
+    friend class MpvMetrics;
+
+    struct PropertyRate {
+        quint64 total = 0;
+        quint64 current = 0;
+        quint64 lastSecond = 0;
+        // steady_clock, in nanoseconds.
+        qint64 windowStart = 0;
+
+        quint64 perSecond(qint64 now) const;
+    };
+    QHash<QByteArray, PropertyRate> propertyChanges;
+};
+
+// Process-wide view of the wrapper metrics of all players, meant to be
+// polled by monitoring. Every MpvObject registers itself here.
+class MpvMetrics : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvMetrics)
+
+    Q_PROPERTY(int playerCount READ playerCount NOTIFY playerCountChanged)
+
+public:
+    explicit MpvMetrics(QObject *parent = nullptr);
+    ~MpvMetrics() override;
+
+    static MpvMetrics *instance();
+
+    int playerCount() const;
+
+    // Called by MpvObject itself, there's no need to call them manually.
+    void registerPlayer(MpvObject *player);
+    void unregisterPlayer(MpvObject *player);
+
+public Q_SLOTS:
+    // "players": one entry per player (its metrics plus "objectName" and
+    // "source"), "total": everything summed up.
+    QVariantMap snapshot() const;
+    // The same as JSON.
+    QString snapshotJson(bool compact = true) const;
+
+private:
+    QVector<QPointer<MpvObject>> players;
+
+Q_SIGNALS:
+    void playerCountChanged();
+};
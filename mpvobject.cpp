@@ -1,9 +1,27 @@
 #include "mpvobject.h"
-
+#include "mpvframecapture.h"
+#include "mpvheadlessplayer.h"
+#include "mpvloadstatistics.h"
+#include "mpvlog.h"
+#include "mpvmediascanner.h"
+#include "mpvmemorybudget.h"
+#include "mpvmetrics.h"
+#include "mpvstreamsource.h"
+#include "mpvthumbnailengine.h"
+#include "mpvtracer.h"
+#include "mpvwarmup.h"
+
+#include <QCoreApplication>
 #include <QDebug>
 #include <QOpenGLContext>
 #include <QOpenGLFramebufferObject>
+#include <QPointer>
 #include <QQuickWindow>
+#include <QScreen>
+#include <QSet>
+#include <QThreadPool>
+#include <algorithm>
+#include <limits>
 #include <utility>
 #if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
 #include <QGuiApplication>
@@ -21,8 +39,55 @@ void wakeup(void *ctx) {
                               Qt::QueuedConnection);
 }
 
+// Same as wakeup(), but for the hidden standby players.
+void standbyWakeup(void *ctx) {
+    QMetaObject::invokeMethod(static_cast<MpvObject *>(ctx),
+                              "hasStandbyEvents", Qt::QueuedConnection);
+}
+
 void on_mpv_redraw(void *ctx) { MpvObject::on_update(ctx); }
 
+// Reply userdata of the typed "time-pos" observation, the untyped one goes
+// through the property table like everything else.
+constexpr quint64 framePtsObserver = 1;
+// Reply userdata of the asynchronous requests counted as in flight.
+constexpr quint64 asyncRequestTag = 2;
+// Reply userdata of the property reads the stall detector made
+// asynchronous.
+constexpr quint64 asyncPropertyTag = 3;
+// Reply userdata of the typed frame drop counter observations, they only
+// feed MpvTracer.
+constexpr quint64 frameDropObserver = 4;
+// Reply userdata of the coalesced property writes, see
+// flushPropertyWrites().
+constexpr quint64 coalescedWriteTag = 5;
+// Reply userdata of the seeks sent while scrubbing.
+constexpr quint64 scrubSeekTag = 6;
+// A scrub seek that hasn't finished after this long (in milliseconds)
+// no longer holds back the next target.
+constexpr qint64 scrubSeekTimeout = 1000;
+// Reply userdata of the typed display sync statistics observations.
+constexpr quint64 displaySyncObserver = 7;
+// Replies to the demuxer cache limits set by MpvMemoryBudget.
+constexpr quint64 demuxerLimitTag = 8;
+// Replies to the load trace details read when a file has been loaded.
+constexpr quint64 loadTraceTag = 9;
+// Longer gaps between two frames (in nanoseconds) are pauses or seeks,
+// they don't go into frameInterval.
+constexpr qint64 maximumFrameInterval = 250 * 1000 * 1000;
+
+QByteArray commandName(const QVariant &arguments) {
+    if (arguments.type() == QVariant::Map) {
+        return arguments.toMap()
+            .value(QString::fromUtf8("name"))
+            .toString()
+            .toUtf8();
+    }
+    const QVariantList list = arguments.toList();
+    return list.isEmpty() ? QByteArray()
+                          : list.constFirst().toString().toUtf8();
+}
+
 void *get_proc_address_mpv(void *ctx, const char *name) {
     Q_UNUSED(ctx)
     QOpenGLContext *glctx = QOpenGLContext::currentContext();
@@ -32,6 +97,58 @@ void *get_proc_address_mpv(void *ctx, const char *name) {
     return reinterpret_cast<void *>(glctx->getProcAddress(QByteArray(name)));
 }
 
+// Must be called on the render thread, with the OpenGL context current.
+mpv_render_context *createRenderContext(mpv_handle *handle) {
+    mpv_opengl_init_params gl_init_params{get_proc_address_mpv, nullptr,
+                                          nullptr};
+    mpv_render_param params[]{
+        {MPV_RENDER_PARAM_API_TYPE,
+         const_cast<char *>(MPV_RENDER_API_TYPE_OPENGL)},
+        {MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &gl_init_params},
+        {MPV_RENDER_PARAM_INVALID, nullptr},
+        {MPV_RENDER_PARAM_INVALID, nullptr}};
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+    if (QGuiApplication::platformName().contains(QString::fromUtf8("xcb"),
+                                                 Qt::CaseInsensitive)) {
+        params[2].type = MPV_RENDER_PARAM_X11_DISPLAY;
+        params[2].data = QX11Info::display();
+    }
+#endif
+    mpv_render_context *context = nullptr;
+    if (mpv_render_context_create(&context, handle, params) < 0) {
+        return nullptr;
+    }
+    return context;
+}
+
+// Choice options ("hr-seek", "loop-playlist", "deinterlace" in newer mpv
+// versions) are read back as strings, for which QVariant::toBool() is true
+// unless they are empty, "0" or "false". Queued writes may be either.
+bool choiceToBool(const QVariant &value) {
+    return (value.type() == QVariant::String)
+        ? (value.toString() != QString::fromUtf8("no"))
+        : value.toBool();
+}
+
+qint64 demuxerCacheStateBytes(const QVariant &state) {
+    return qMax(
+        state.toMap().value(QString::fromUtf8("total-bytes")).toLongLong(),
+        qint64(0));
+}
+
+// grabFrame() blocks a thread until mpv's core has taken the screenshot.
+// Those threads come from a small pool of their own, so that a burst of
+// grabs can't occupy the global pool. Parented to the application object
+// like the other singletons.
+QThreadPool *grabThreadPool() {
+    static QPointer<QThreadPool> pool;
+    if (pool.isNull()) {
+        pool = new QThreadPool(QCoreApplication::instance());
+        pool->setMaxThreadCount(2);
+    }
+    return pool;
+}
+
 } // namespace
 
 class MpvRenderer : public QQuickFramebufferObject::Renderer {
@@ -40,8 +157,18 @@ class MpvRenderer : public QQuickFramebufferObject::Renderer {
 public:
     MpvRenderer(MpvObject *mpvObject) : m_mpvObject(mpvObject) {
         Q_ASSERT(m_mpvObject != nullptr);
+        // Emitted on the render thread, right after the buffer swap. A new
+        // renderer is created for every window the item is shown in.
+        m_swapConnection =
+            QObject::connect(m_mpvObject->window(), &QQuickWindow::frameSwapped,
+                             [this]() { reportSwap(); });
+    }
+    ~MpvRenderer() override {
+        QObject::disconnect(m_swapConnection);
+        // Still on the render thread with the context current.
+        m_tapReadbacks.clear();
+        delete m_standbyFbo;
     }
-    ~MpvRenderer() override = default;
 
     // This function is called when a new FBO is needed.
     // This happens on the initial frame.
@@ -49,37 +176,94 @@ public:
     createFramebufferObject(const QSize &size) override {
         // init mpv_gl:
         if (m_mpvObject->mpv_gl == nullptr) {
-            mpv_opengl_init_params gl_init_params{get_proc_address_mpv, nullptr,
-                                                  nullptr};
-            mpv_render_param params[]{
-                {MPV_RENDER_PARAM_API_TYPE,
-                 const_cast<char *>(MPV_RENDER_API_TYPE_OPENGL)},
-                {MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &gl_init_params},
-                {MPV_RENDER_PARAM_INVALID, nullptr},
-                {MPV_RENDER_PARAM_INVALID, nullptr}};
-#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
-            if (QGuiApplication::platformName().contains("xcb",
-                                                         Qt::CaseInsensitive)) {
-                params[2].type = MPV_RENDER_PARAM_X11_DISPLAY;
-                params[2].data = QX11Info::display();
-            }
-#endif
-
-            const int mpvGLInitResult = mpv_render_context_create(
-                &m_mpvObject->mpv_gl, m_mpvObject->mpv, params);
-            Q_ASSERT(mpvGLInitResult >= 0);
+            m_mpvObject->mpv_gl = createRenderContext(m_mpvObject->mpv);
+            Q_ASSERT(m_mpvObject->mpv_gl != nullptr);
             mpv_render_context_set_update_callback(m_mpvObject->mpv_gl,
                                                    on_mpv_redraw, m_mpvObject);
 
             QMetaObject::invokeMethod(m_mpvObject, "initFinished");
         }
 
+        if (MpvTracer::isEnabled()) {
+            const QByteArray detail = QByteArray::number(size.width()) + 'x' +
+                QByteArray::number(size.height());
+            MpvTracer::instant(MpvTracer::Category::Render, "fbo",
+                               detail.constData());
+        }
         return QQuickFramebufferObject::Renderer::createFramebufferObject(size);
     }
 
+    // Called on the render thread while the GUI thread is blocked, which
+    // makes it the only place where the standby players' render contexts
+    // can be created, destroyed and swapped without racing render().
+    void synchronize(QQuickFramebufferObject *item) override {
+        Q_UNUSED(item)
+        synchronizeFrameTaps();
+        // The standby players share the OpenGL context of the visible one.
+        if (m_mpvObject->mpv_gl == nullptr) {
+            return;
+        }
+        for (auto &&standby :
+             std::as_const(m_mpvObject->retiredStandbyPlayers)) {
+            if (standby->mpv_gl != nullptr) {
+                mpv_render_context_free(standby->mpv_gl);
+                standby->mpv_gl = nullptr;
+            }
+        }
+        m_mpvObject->retiredStandbyPlayers.clear();
+        bool created = false;
+        for (int i = m_mpvObject->standbyPlayers.count() - 1; i >= 0; --i) {
+            const auto standby = m_mpvObject->standbyPlayers.at(i);
+            if (standby->mpv_gl != nullptr) {
+                continue;
+            }
+            standby->mpv_gl = createRenderContext(standby->mpv);
+            if (standby->mpv_gl == nullptr) {
+                m_mpvObject->standbyPlayers.removeAt(i);
+                const QUrl url = standby->source;
+                QMetaObject::invokeMethod(
+                    m_mpvObject,
+                    [mpvObject = m_mpvObject, url]() {
+                        Q_EMIT mpvObject->standbySourcesChanged();
+                        Q_EMIT mpvObject->standbyFailed(url);
+                    },
+                    Qt::QueuedConnection);
+                continue;
+            }
+            mpv_render_context_set_update_callback(standby->mpv_gl,
+                                                   on_mpv_redraw, m_mpvObject);
+            created = true;
+        }
+        if (created) {
+            // mpv disables video if there's no render context when the file
+            // is opened, so loading has to wait until now.
+            QMetaObject::invokeMethod(m_mpvObject, "loadStandbySources",
+                                      Qt::QueuedConnection);
+        }
+        const auto standby = m_mpvObject->pendingStandbyActivation;
+        if (!standby.isNull() && (standby->mpv_gl != nullptr)) {
+            std::swap(m_mpvObject->mpv, standby->mpv);
+            std::swap(m_mpvObject->mpv_gl, standby->mpv_gl);
+            // Switched together with the handles, so that no event of the
+            // visible player ends up on the standby path or vice versa.
+            mpv_set_wakeup_callback(m_mpvObject->mpv, wakeup, m_mpvObject);
+            mpv_set_wakeup_callback(standby->mpv, standbyWakeup, m_mpvObject);
+            m_mpvObject->activatedStandby = standby;
+            m_mpvObject->pendingStandbyActivation.clear();
+            QMetaObject::invokeMethod(m_mpvObject, "finishStandbyActivation",
+                                      Qt::QueuedConnection);
+        }
+        m_standbyPlayers = m_mpvObject->standbyPlayers;
+    }
+
     void render() override {
         m_mpvObject->window()->resetOpenGLState();
 
+        const bool newFrame = (mpv_render_context_update(m_mpvObject->mpv_gl) &
+                               MPV_RENDER_UPDATE_FRAME) != 0;
+        const MpvTraceSpan span(MpvTracer::Category::Render, "render",
+                                newFrame ? "frame" : "redraw");
+
         QOpenGLFramebufferObject *fbo = framebufferObject();
         mpv_opengl_fbo mpfbo;
         mpfbo.fbo = static_cast<int>(fbo->handle());
@@ -87,6 +271,9 @@ public:
         mpfbo.h = fbo->height();
         mpfbo.internal_format = 0;
         int flip_y = 0;
+        // The framebuffer objects of QQuickFramebufferObject are RGBA8,
+        // mpv dithers down to this.
+        int depth = 8;
 
         mpv_render_param params[] = {
             // Specify the default framebuffer (0) as target. This will
@@ -96,16 +283,131 @@ public:
             {MPV_RENDER_PARAM_OPENGL_FBO, &mpfbo},
             // Flip rendering (needed due to flipped GL coordinate system).
             {MPV_RENDER_PARAM_FLIP_Y, &flip_y},
+            {MPV_RENDER_PARAM_DEPTH, &depth},
             {MPV_RENDER_PARAM_INVALID, nullptr}};
         // See render_gl.h on what OpenGL environment mpv expects, and
         // other API details.
+        const qint64 renderStart = steadyClockNanoseconds();
         mpv_render_context_render(m_mpvObject->mpv_gl, params);
+        MpvPlayerMetrics &metrics = m_mpvObject->metrics;
+        metrics.renderTime.record(
+            (steadyClockNanoseconds() - renderStart) / 1000);
+        metrics.renders.fetch_add(1, std::memory_order_relaxed);
+        if (!newFrame) {
+            metrics.skippedRenders.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            const qint64 frameTime = steadyClockNanoseconds();
+            const qint64 interval = frameTime - m_lastFrameTime;
+            if ((m_lastFrameTime != 0) && (interval < maximumFrameInterval)) {
+                metrics.frameInterval.record(interval / 1000);
+            }
+            m_lastFrameTime = frameTime;
+        }
+
+        if (newFrame &&
+            (m_mpvObject->seekFrameStart.load(std::memory_order_relaxed) !=
+             0)) {
+            const qint64 seekStart = m_mpvObject->seekFrameStart.exchange(0);
+            if (seekStart != 0) {
+                metrics.seekLatency.record(
+                    (steadyClockNanoseconds() - seekStart) / 1000);
+            }
+        }
+        if (newFrame && m_mpvObject->awaitingFirstFrame.exchange(false)) {
+            QMetaObject::invokeMethod(
+                m_mpvObject, "firstFrameRendered", Qt::QueuedConnection,
+                Q_ARG(qint64, steadyClockNanoseconds()));
+        }
+
+        tapFrame(fbo, newFrame);
+        renderStandbyPlayers();
 
         m_mpvObject->window()->resetOpenGLState();
     }
 
+private:
+    // Read backs are created and destroyed here, on the render thread.
+    void synchronizeFrameTaps() {
+        const auto &taps = m_mpvObject->frameTaps;
+        for (int i = m_tapReadbacks.count() - 1; i >= 0; --i) {
+            if (!taps.contains(m_tapReadbacks.at(i)->tap())) {
+                m_tapReadbacks.removeAt(i);
+            }
+        }
+        for (auto &&tap : std::as_const(taps)) {
+            const bool found = std::any_of(
+                m_tapReadbacks.cbegin(), m_tapReadbacks.cend(),
+                [&tap](const QSharedPointer<MpvFrameTapReadback> &readback) {
+                    return readback->tap() == tap;
+                });
+            if (!found) {
+                m_tapReadbacks.append(
+                    QSharedPointer<MpvFrameTapReadback>::create(tap));
+            }
+        }
+    }
+
+    void tapFrame(QOpenGLFramebufferObject *fbo, bool newFrame) {
+        if (m_tapReadbacks.isEmpty()) {
+            return;
+        }
+        const qint64 now = steadyClockNanoseconds();
+        const qreal pts = m_mpvObject->framePts.load(std::memory_order_relaxed);
+        for (auto &&readback : std::as_const(m_tapReadbacks)) {
+            readback->collect();
+            if (newFrame && readback->tap()->isDue(now)) {
+                readback->capture(fbo, pts, now);
+            }
+        }
+    }
+
+    // The standby players' frames have to be presented somewhere, otherwise
+    // their video outputs stall waiting for us. A tiny offscreen target is
+    // enough, what matters is that the frames get consumed.
+    void renderStandbyPlayers() {
+        if (m_standbyPlayers.isEmpty()) {
+            return;
+        }
+        if (m_standbyFbo == nullptr) {
+            m_standbyFbo = new QOpenGLFramebufferObject(16, 16);
+        }
+        mpv_opengl_fbo mpfbo;
+        mpfbo.fbo = static_cast<int>(m_standbyFbo->handle());
+        mpfbo.w = m_standbyFbo->width();
+        mpfbo.h = m_standbyFbo->height();
+        mpfbo.internal_format = 0;
+        int flip_y = 0;
+        mpv_render_param params[] = {{MPV_RENDER_PARAM_OPENGL_FBO, &mpfbo},
+                                     {MPV_RENDER_PARAM_FLIP_Y, &flip_y},
+                                     {MPV_RENDER_PARAM_INVALID, nullptr}};
+        for (auto &&standby : std::as_const(m_standbyPlayers)) {
+            if ((standby->mpv_gl == nullptr) ||
+                ((mpv_render_context_update(standby->mpv_gl) &
+                  MPV_RENDER_UPDATE_FRAME) == 0)) {
+                continue;
+            }
+            mpv_render_context_render(standby->mpv_gl, params);
+        }
+    }
+
+    // mpv needs to know when its frames actually reach the screen to lock
+    // onto the display's refresh rate (video-sync=display-*). At most one
+    // call per swap.
+    void reportSwap() {
+        if (m_mpvObject->reportSwaps.load(std::memory_order_relaxed) &&
+            (m_mpvObject->mpv_gl != nullptr)) {
+            mpv_render_context_report_swap(m_mpvObject->mpv_gl);
+        }
+    }
+
 private:
     MpvObject *m_mpvObject = nullptr;
+    QMetaObject::Connection m_swapConnection;
+    // steady_clock, in nanoseconds.
+    qint64 m_lastFrameTime = 0;
+    QVector<MpvObject::StandbyPlayerPtr> m_standbyPlayers;
+    QOpenGLFramebufferObject *m_standbyFbo = nullptr;
+    QVector<QSharedPointer<MpvFrameTapReadback>> m_tapReadbacks;
 };
 
 MpvObject::MpvObject(QQuickItem *parent)
@@ -113,16 +415,31 @@ MpvObject::MpvObject(QQuickItem *parent)
       mpv(mpv::qt::Handle::FromRawHandle(mpv_create())) {
     Q_ASSERT(mpv != nullptr);
 
-    mpvSetProperty("input-default-bindings", false);
-    mpvSetProperty("input-vo-keyboard", false);
-    mpvSetProperty("input-cursor", false);
-    mpvSetProperty("cursor-autohide", false);
-
-    auto iterator = properties.constBegin();
-    while (iterator != properties.constEnd()) {
-        mpvObserveProperty(iterator.key());
-        ++iterator;
-    }
+    applyHandleDefaults(mpv);
+
+    playlistModel = new MpvPlaylistModel(this);
+    // Takes effect immediately, so the very first file already respects the
+    // budget.
+    MpvMemoryBudget::instance()->registerPlayer(this);
+    MpvMetrics::instance()->registerPlayer(this);
+
+    connect(this, &MpvObject::hasStandbyEvents, this,
+            &MpvObject::handleStandbyEvents, Qt::QueuedConnection);
+    connect(this, &QQuickItem::windowChanged, this, &MpvObject::trackDisplay);
+
+    connect(MpvFrameCapture::instance(), &MpvFrameCapture::frameCaptured,
+            this,
+            [this](int captureId, const QString &filePath, qreal position) {
+                if (captureIds.contains(captureId)) {
+                    Q_EMIT frameCaptured(captureId, filePath, position);
+                }
+            });
+    connect(MpvFrameCapture::instance(), &MpvFrameCapture::captureFinished,
+            this, [this](int captureId, int frameCount, bool success) {
+                if (captureIds.remove(captureId)) {
+                    Q_EMIT captureFinished(captureId, frameCount, success);
+                }
+            });
 
     // From this point on, the wakeup function will be called. The callback
     // can come from any thread, so we use the QueuedConnection mechanism to
@@ -133,12 +450,29 @@ MpvObject::MpvObject(QQuickItem *parent)
 
     const int mpvInitResult = mpv_initialize(mpv);
     Q_ASSERT(mpvInitResult >= 0);
+    MpvStreamSource::registerProtocols(mpv);
+
+    connect(MpvTracer::instance(), &MpvTracer::enabledChanged, this,
+            &MpvObject::updateFrameDropObservation);
+    updateFrameDropObservation();
 
     connect(this, &MpvObject::onUpdate, this, &MpvObject::doUpdate,
             Qt::QueuedConnection);
 }
 
 MpvObject::~MpvObject() {
+    MpvMemoryBudget::instance()->unregisterPlayer(this);
+    MpvMetrics::instance()->unregisterPlayer(this);
+    for (auto &&tap : std::as_const(frameTaps)) {
+        tap->stop();
+    }
+    // Render contexts must go before their mpv handles.
+    for (auto &&standby : standbyPlayers + retiredStandbyPlayers) {
+        if (standby->mpv_gl != nullptr) {
+            mpv_render_context_free(standby->mpv_gl);
+            standby->mpv_gl = nullptr;
+        }
+    }
     // only initialized if something got drawn
     if (mpv_gl != nullptr) {
         mpv_render_context_free(mpv_gl);
@@ -155,43 +489,153 @@ void MpvObject::on_update(void *ctx) {
 // connected to onUpdate() signal makes sure it runs on the GUI thread
 void MpvObject::doUpdate() { update(); }
 
+void MpvObject::applyHandleDefaults(mpv_handle *handle) {
+    mpv::qt::set_property(handle, "input-default-bindings", false);
+    mpv::qt::set_property(handle, "input-vo-keyboard", false);
+    mpv::qt::set_property(handle, "input-cursor", false);
+    mpv::qt::set_property(handle, "cursor-autohide", false);
+
+    auto iterator = properties.constBegin();
+    while (iterator != properties.constEnd()) {
+        if (mpv_observe_property(handle, 0, iterator.key().constData(),
+                                 MPV_FORMAT_NONE) < 0) {
+            qWarning().noquote()
+                << "Failed to observe a property from mpv:" << iterator.key();
+        }
+        ++iterator;
+    }
+    // The whole playlist is delivered together with the change event, so
+    // the model never has to query it synchronously.
+    mpv_observe_property(handle, 0, "playlist", MPV_FORMAT_NODE);
+    // Needed to tell when a pre-rolled file is ready, the values come with
+    // the change events as well.
+    mpv_observe_property(handle, 0, "demuxer-cache-duration",
+                         MPV_FORMAT_DOUBLE);
+    mpv_observe_property(handle, 0, "demuxer-cache-idle", MPV_FORMAT_FLAG);
+    // Same for the memory budget, which asks for the usage of every player
+    // whenever it's looked at.
+    mpv_observe_property(handle, 0, "demuxer-cache-state", MPV_FORMAT_NODE);
+    // The frame taps need the value itself, without a round trip.
+    mpv_observe_property(handle, framePtsObserver, "time-pos",
+                         MPV_FORMAT_DOUBLE);
+    mpv_observe_property(handle, displaySyncObserver, "vsync-jitter",
+                         MPV_FORMAT_DOUBLE);
+    mpv_observe_property(handle, displaySyncObserver, "mistimed-frame-count",
+                         MPV_FORMAT_INT64);
+    mpv_observe_property(handle, displaySyncObserver,
+                         "vo-delayed-frame-count", MPV_FORMAT_INT64);
+}
+
 void MpvObject::processMpvLogMessage(mpv_event_log_message *event) {
+    // Everything goes into the ring, the categories decide what reaches
+    // the message handler. Disabled ones don't even format the text.
+    MpvLog::instance()->append(event->log_level, event->prefix, event->text);
+    const auto text = [event]() {
+        return QString::fromUtf8(event->prefix) + QString::fromUtf8(": ") +
+            QString::fromUtf8(event->text).trimmed();
+    };
     switch (event->log_level) {
-    case MPV_LOG_LEVEL_V:
-    case MPV_LOG_LEVEL_DEBUG:
-    case MPV_LOG_LEVEL_TRACE:
-        qDebug().noquote() << event->text;
-        break;
     case MPV_LOG_LEVEL_WARN:
-        qWarning().noquote() << event->text;
+        qCWarning(lcMpvLog).noquote() << text();
         break;
     case MPV_LOG_LEVEL_ERROR:
-        qCritical().noquote() << event->text;
+        qCCritical(lcMpvLog).noquote() << text();
         break;
     case MPV_LOG_LEVEL_FATAL:
-        // qFatal() doesn't support the "<<" operator.
-        qFatal("%s", event->text);
+        // mpv can't go on, but that's no reason to take the application
+        // down with it.
+        qCCritical(lcMpvLog).noquote() << text();
+        Q_EMIT mpvError(QString::fromUtf8(event->text).trimmed());
         break;
     case MPV_LOG_LEVEL_INFO:
-        qInfo().noquote() << event->text;
+        qCInfo(lcMpvLog).noquote() << text();
         break;
     default:
-        qDebug().noquote() << event->text;
+        qCDebug(lcMpvLog).noquote() << text();
         break;
     }
 }
 
 void MpvObject::processMpvPropertyChange(mpv_event_property *event) {
-    if (!propertyBlackList.contains(event->name)) {
-        qDebug().noquote() << "[libmpv] Property changed from mpv:"
-                           << event->name;
-    }
-    if (properties.contains(event->name)) {
-        const auto signalName = properties.value(event->name);
-        if (signalName != nullptr) {
-            QMetaObject::invokeMethod(this, signalName);
+    // The property names in the event are copies owned by mpv, so they have
+    // to be compared by content, not by address.
+    const auto isBlackListed = [this, event]() {
+        for (auto &&name : std::as_const(propertyBlackList)) {
+            if (qstrcmp(name, event->name) == 0) {
+                return true;
+            }
         }
+        return false;
+    };
+    if (lcMpvProperties().isDebugEnabled() && !isBlackListed()) {
+        qCDebug(lcMpvProperties).noquote()
+            << "Property changed from mpv:" << event->name;
+    }
+    if ((event->format == MPV_FORMAT_NODE) &&
+        (qstrcmp(event->name, "playlist") == 0)) {
+        processMpvPlaylistChange(
+            mpv::qt::node_to_variant(static_cast<mpv_node *>(event->data))
+                .toList());
+        return;
+    }
+    if (qstrcmp(event->name, "demuxer-cache-state") == 0) {
+        demuxerCacheBytes = (event->format == MPV_FORMAT_NODE)
+            ? demuxerCacheStateBytes(mpv::qt::node_to_variant(
+                  static_cast<mpv_node *>(event->data)))
+            : 0;
+        Q_EMIT demuxerCacheUsageChanged();
+        return;
+    }
+    if (qstrcmp(event->name, "demuxer-cache-duration") == 0) {
+        demuxerCacheDuration = (event->format == MPV_FORMAT_DOUBLE)
+            ? *static_cast<double *>(event->data)
+            : 0.0;
+        checkPrerollFinished();
+        return;
+    }
+    if (qstrcmp(event->name, "demuxer-cache-idle") == 0) {
+        demuxerCacheIdle = (event->format == MPV_FORMAT_FLAG) &&
+            (*static_cast<int *>(event->data) != 0);
+        checkPrerollFinished();
+        return;
     }
+    const char *signalName = properties.value(
+        QByteArray::fromRawData(event->name, qstrlen(event->name)));
+    if (signalName != nullptr) {
+        QMetaObject::invokeMethod(this, signalName);
+    }
+}
+
+void MpvObject::processMpvPlaylistChange(const QVariantList &playlist) {
+    playlistModel->update(playlist);
+    updateGaplessPlayback();
+    // Gapless transitions don't go through setSource(), keep the source
+    // property in sync with what's actually being played.
+    const int current = playlistModel->currentIndex();
+    if (current < 0) {
+        return;
+    }
+    const QUrl url = MpvPlaylistModel::urlFromFileName(
+        playlistModel->entry(current).fileName);
+    if (url.isValid() && (url != currentSource)) {
+        currentSource = url;
+        Q_EMIT sourceChanged();
+    }
+}
+
+void MpvObject::updateGaplessPlayback() {
+    // Open the next playlist entry while the current one is still playing
+    // and keep the audio output open across entries, so that switching
+    // between them doesn't leave a gap. A single file has nothing to
+    // prefetch, it keeps mpv's defaults.
+    const bool gapless = (playlistCount() > 1);
+    if (gapless == gaplessPlayback) {
+        return;
+    }
+    gaplessPlayback = gapless;
+    queuePropertyWrite("prefetch-playlist", gapless);
+    queuePropertyWrite("gapless-audio", gapless ? QString::fromUtf8("yes")
+                                                : QString::fromUtf8("weak"));
 }
 
 bool MpvObject::isLoaded() const {
@@ -237,17 +681,50 @@ void MpvObject::playbackStateChangeEvent() {
     Q_EMIT playbackStateChanged();
 }
 
-bool MpvObject::mpvSendCommand(const QVariant &arguments) {
+bool MpvObject::mpvSendCommand(const QVariant &arguments,
+                               const char *caller) {
     if (arguments.isNull() || !arguments.isValid()) {
         return false;
     }
-    qDebug().noquote() << "Sending a command to mpv:" << arguments;
+    // Property writes made before the command take effect before it.
+    flushPropertyWrites();
+    qCDebug(lcMpvCalls).noquote() << "Sending a command to mpv:" << arguments;
+    const QByteArray name = commandName(arguments);
+    const QByteArray operation = "command:" + name;
+    const MpvTraceSpan span(MpvTracer::Category::Commands, "command",
+                            name.constData());
     int errorCode = 0;
-    if (mpvCallType() == MpvCallType::Asynchronous) {
-        errorCode = mpv::qt::command_async(mpv, arguments, 0);
+    if ((mpvCallType() == MpvCallType::Asynchronous) ||
+        isAsyncOperation(operation)) {
+        errorCode = mpv::qt::command_async(mpv, arguments, asyncRequestTag);
+        countAsyncRequest(errorCode);
     } else {
+        const qint64 callStart = steadyClockNanoseconds();
         errorCode = mpv::qt::get_error(mpv::qt::command(mpv, arguments));
+        recordBlockingCall(operation, caller,
+                           steadyClockNanoseconds() - callStart);
+    }
+    if (errorCode < 0) {
+        qWarning().noquote()
+            << "Failed to execute a command for mpv:" << arguments;
+    }
+    return (errorCode >= 0);
+}
+
+bool MpvObject::mpvSendCommandAsync(const QVariant &arguments) {
+    if (arguments.isNull() || !arguments.isValid()) {
+        return false;
+    }
+    flushPropertyWrites();
+    qCDebug(lcMpvCalls).noquote()
+        << "Sending a command to mpv asynchronously:" << arguments;
+    if (MpvTracer::isEnabled()) {
+        MpvTracer::instant(MpvTracer::Category::Commands, "command",
+                           commandName(arguments).constData());
     }
+    const int errorCode =
+        mpv::qt::command_async(mpv, arguments, asyncRequestTag);
+    countAsyncRequest(errorCode);
     if (errorCode < 0) {
         qWarning().noquote()
             << "Failed to execute a command for mpv:" << arguments;
@@ -255,17 +732,38 @@ bool MpvObject::mpvSendCommand(const QVariant &arguments) {
     return (errorCode >= 0);
 }
 
-bool MpvObject::mpvSetProperty(const char *name, const QVariant &value) {
+void MpvObject::countAsyncRequest(int errorCode) {
+    if (errorCode < 0) {
+        return;
+    }
+    metrics.asyncRequests.fetch_add(1, std::memory_order_relaxed);
+    metrics.asyncInFlight.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool MpvObject::mpvSetProperty(const char *name, const QVariant &value,
+                               const char *caller) {
     if ((name == nullptr) || value.isNull() || !value.isValid()) {
         return false;
     }
-    qDebug().noquote() << "Setting a property for mpv:" << name
-                       << "to:" << value;
+    if (updateDepth > 0) {
+        return queuePropertyWrite(name, value);
+    }
+    flushPropertyWrites();
+    qCDebug(lcMpvCalls).noquote()
+        << "Setting a property for mpv:" << name << "to:" << value;
+    const QByteArray operation = "set:" + QByteArray(name);
+    const MpvTraceSpan span(MpvTracer::Category::Commands, "set", name);
     int errorCode = 0;
-    if (mpvCallType() == MpvCallType::Asynchronous) {
-        errorCode = mpv::qt::set_property_async(mpv, name, value, 0);
+    if ((mpvCallType() == MpvCallType::Asynchronous) ||
+        isAsyncOperation(operation)) {
+        errorCode =
+            mpv::qt::set_property_async(mpv, name, value, asyncRequestTag);
+        countAsyncRequest(errorCode);
     } else {
+        const qint64 callStart = steadyClockNanoseconds();
         errorCode = mpv::qt::get_error(mpv::qt::set_property(mpv, name, value));
+        recordBlockingCall(operation, caller,
+                           steadyClockNanoseconds() - callStart);
     }
     if (errorCode < 0) {
         qWarning().noquote() << "Failed to set a property for mpv:" << name;
@@ -273,34 +771,327 @@ bool MpvObject::mpvSetProperty(const char *name, const QVariant &value) {
     return (errorCode >= 0);
 }
 
-QVariant MpvObject::mpvGetProperty(const char *name, bool *ok) const {
+bool MpvObject::queuePropertyWrite(const char *name, const QVariant &value) {
+    if ((name == nullptr) || value.isNull() || !value.isValid()) {
+        return false;
+    }
+    const QByteArray propertyName(name);
+    if (!pendingWrites.contains(propertyName)) {
+        pendingWriteOrder.append(propertyName);
+    }
+    pendingWrites.insert(propertyName, value);
+    if ((updateDepth == 0) && !writeFlushScheduled) {
+        writeFlushScheduled = true;
+        QMetaObject::invokeMethod(
+            this,
+            [this]() {
+                writeFlushScheduled = false;
+                if (updateDepth == 0) {
+                    flushPropertyWrites();
+                }
+            },
+            Qt::QueuedConnection);
+    }
+    return true;
+}
+
+void MpvObject::flushPropertyWrites() {
+    if (pendingWriteOrder.isEmpty()) {
+        return;
+    }
+    // libmpv has no call that sets several properties at once, so the batch
+    // is a series of asynchronous writes that don't wait for each other.
+    const QVector<QByteArray> order = std::exchange(pendingWriteOrder, {});
+    const QHash<QByteArray, QVariant> values =
+        std::exchange(pendingWrites, {});
+    for (auto &&name : order) {
+        const QVariant value = values.value(name);
+        qCDebug(lcMpvCalls).noquote()
+            << "Setting a property for mpv:" << name << "to:" << value;
+        if (MpvTracer::isEnabled()) {
+            MpvTracer::instant(MpvTracer::Category::Commands, "set",
+                               name.constData());
+        }
+        const int errorCode = mpv::qt::set_property_async(
+            mpv, name.constData(), value, coalescedWriteTag);
+        countAsyncRequest(errorCode);
+        if (errorCode < 0) {
+            qWarning().noquote() << "Failed to set a property for mpv:" << name;
+            continue;
+        }
+        unconfirmedWrites.insert(name, value);
+        ++unconfirmedWriteCount;
+    }
+}
+
+void MpvObject::confirmPropertyWrite(int errorCode) {
+    metrics.finishAsyncRequest();
+    if (errorCode < 0) {
+        qWarning().noquote() << "Failed to set a property for mpv:"
+                             << mpv_error_string(errorCode);
+    }
+    // Replies arrive in order, once the last one is back mpv has the
+    // values itself.
+    if (--unconfirmedWriteCount <= 0) {
+        unconfirmedWriteCount = 0;
+        unconfirmedWrites.clear();
+    }
+}
+
+QVariant MpvObject::pendingWriteValue(const char *name) const {
+    if (pendingWrites.isEmpty() && unconfirmedWrites.isEmpty()) {
+        return QVariant();
+    }
+    const QByteArray propertyName(name);
+    const auto it = pendingWrites.constFind(propertyName);
+    if (it != pendingWrites.constEnd()) {
+        return *it;
+    }
+    return unconfirmedWrites.value(propertyName);
+}
+
+QVariant MpvObject::mpvGetProperty(const char *name, bool *ok,
+                                   const char *caller) const {
     if (ok != nullptr) {
         *ok = false;
     }
     if (name == nullptr) {
         return QVariant();
     }
+    // Read your writes: what has been set but may not have reached mpv yet.
+    const QVariant pendingValue = pendingWriteValue(name);
+    if (pendingValue.isValid()) {
+        if (ok != nullptr) {
+            *ok = true;
+        }
+        return pendingValue;
+    }
+    const QByteArray operation = "get:" + QByteArray(name);
+    if (isAsyncOperation(operation)) {
+        const QByteArray propertyName(name);
+        if (!asyncPropertyReads.contains(propertyName) &&
+            (mpv_get_property_async(mpv, asyncPropertyTag, name,
+                                    MPV_FORMAT_NODE) >= 0)) {
+            asyncPropertyReads.insert(propertyName);
+        }
+        if ((ok != nullptr) && asyncPropertyValues.contains(propertyName)) {
+            *ok = true;
+        }
+        return asyncPropertyValues.value(propertyName);
+    }
+    const MpvTraceSpan span(MpvTracer::Category::Properties, "get", name);
+    const qint64 callStart = steadyClockNanoseconds();
     const QVariant result = mpv::qt::get_property(mpv, name);
+    const qint64 duration = steadyClockNanoseconds() - callStart;
+    metrics.syncGetPropertyTime.record(duration / 1000);
+    metrics.syncGetProperty.fetch_add(1, std::memory_order_relaxed);
+    recordBlockingCall(operation, caller, duration);
+    if (isAsyncOperation(operation)) {
+        // Served from here on until the first asynchronous read is back.
+        asyncPropertyValues.insert(QByteArray(name), result);
+    }
     if (result.isNull() || !result.isValid()) {
         qWarning().noquote() << "Failed to query a property from mpv:" << name;
     } else {
         if (ok != nullptr) {
             *ok = true;
         }
-        /*if ((name != "time-pos") && (name != "duration")) {
-            qDebug().noquote() << "Querying a property from mpv:"
-                               << name << "result:" << result;
-        }*/
+        qCDebug(lcMpvCalls).noquote() << "Querying a property from mpv:"
+                                      << name << "result:" << result;
     }
     return result;
 }
 
-bool MpvObject::mpvObserveProperty(const char *name) {
+void MpvObject::processDisplaySyncProperty(mpv_event_property *property) {
+    // Unavailable while nothing is playing.
+    if (qstrcmp(property->name, "vsync-jitter") == 0) {
+        currentVsyncJitter = (property->format == MPV_FORMAT_DOUBLE)
+            ? *static_cast<double *>(property->data)
+            : 0.0;
+    } else {
+        const qint64 count = (property->format == MPV_FORMAT_INT64)
+            ? *static_cast<int64_t *>(property->data)
+            : 0;
+        if (qstrcmp(property->name, "mistimed-frame-count") == 0) {
+            currentMistimedFrameCount = count;
+        } else {
+            currentVoDelayedFrameCount = count;
+        }
+    }
+    Q_EMIT displaySyncStatisticsChanged();
+}
+
+void MpvObject::applyDisplaySync() {
+#if MPV_CLIENT_API_VERSION >= MPV_MAKE_VERSION(2, 2)
+    const char *displayFpsOption = "display-fps-override";
+#else
+    const char *displayFpsOption = "override-display-fps";
+#endif
+    if (!currentDisplaySync) {
+        queuePropertyWrite("video-sync", QString::fromUtf8("audio"));
+        queuePropertyWrite(displayFpsOption, 0.0);
+        return;
+    }
+    queuePropertyWrite("video-sync", QString::fromUtf8("display-resample"));
+    // mpv can't tell the refresh rate of the screen the item is on, the
+    // window may not even have a native handle it knows of. Without a
+    // window, mpv measures it from the reported swaps.
+    const QQuickWindow *window = this->window();
+    const QScreen *screen = (window != nullptr) ? window->screen() : nullptr;
+    queuePropertyWrite(displayFpsOption,
+                       (screen != nullptr) ? screen->refreshRate() : 0.0);
+}
+
+void MpvObject::trackDisplay(QQuickWindow *window) {
+    disconnect(screenConnection);
+    disconnect(refreshRateConnection);
+    if (window != nullptr) {
+        const auto trackScreen = [this](QScreen *screen) {
+            disconnect(refreshRateConnection);
+            if (screen != nullptr) {
+                refreshRateConnection =
+                    connect(screen, &QScreen::refreshRateChanged, this,
+                            [this]() {
+                                if (currentDisplaySync) {
+                                    applyDisplaySync();
+                                }
+                            });
+            }
+            if (currentDisplaySync) {
+                applyDisplaySync();
+            }
+        };
+        screenConnection =
+            connect(window, &QWindow::screenChanged, this, trackScreen);
+        trackScreen(window->screen());
+    }
+}
+
+void MpvObject::processFrameDropCount(mpv_event_property *property) {
+    // Unavailable while nothing is playing, which restarts the counters.
+    const qint64 count = (property->format == MPV_FORMAT_INT64)
+        ? *static_cast<int64_t *>(property->data)
+        : 0;
+    const bool decoder =
+        (qstrcmp(property->name, "decoder-frame-drop-count") == 0);
+    qint64 &last = decoder ? decoderDroppedFrames : droppedFrames;
+    const bool dropped = count > last;
+    last = count;
+    if (!dropped || !MpvTracer::isEnabled()) {
+        return;
+    }
+    MpvTracer::instant(MpvTracer::Category::Render, "frame drop",
+                       property->name);
+    MpvTracer::instance()->frameDropped();
+}
+
+void MpvObject::updateFrameDropObservation() {
+    const bool observe = MpvTracer::isEnabled();
+    if (observe == observingFrameDrops) {
+        return;
+    }
+    observingFrameDrops = observe;
+    if (!observe) {
+        mpv_unobserve_property(mpv, frameDropObserver);
+        return;
+    }
+    // The current values arrive right away and don't count as drops.
+    droppedFrames = decoderDroppedFrames = std::numeric_limits<qint64>::max();
+    mpv_observe_property(mpv, frameDropObserver, "frame-drop-count",
+                         MPV_FORMAT_INT64);
+    mpv_observe_property(mpv, frameDropObserver, "decoder-frame-drop-count",
+                         MPV_FORMAT_INT64);
+}
+
+void MpvObject::traceMpvEvent(mpv_event *event) {
+    switch (event->event_id) {
+    case MPV_EVENT_PROPERTY_CHANGE:
+        MpvTracer::instant(
+            MpvTracer::Category::Properties, "change",
+            static_cast<mpv_event_property *>(event->data)->name);
+        break;
+    // Already in MpvLog, and far too many.
+    case MPV_EVENT_LOG_MESSAGE:
+        break;
+    case MPV_EVENT_COMMAND_REPLY:
+    case MPV_EVENT_SET_PROPERTY_REPLY:
+    case MPV_EVENT_GET_PROPERTY_REPLY:
+        MpvTracer::instant(MpvTracer::Category::Commands,
+                           mpv_event_name(event->event_id),
+                           mpv_error_string(event->error));
+        break;
+    default:
+        MpvTracer::instant(MpvTracer::Category::Events,
+                           mpv_event_name(event->event_id));
+        break;
+    }
+}
+
+void MpvObject::recordBlockingCall(const QByteArray &operation,
+                                   const char *caller,
+                                   qint64 duration) const {
+    if (duration < (qint64(currentStallThreshold) * 1000000)) {
+        return;
+    }
+    StallStatistics &statistics = stallStatisticsTable[operation];
+    statistics.caller = QByteArray(caller);
+    ++statistics.calls;
+    statistics.totalTime += duration;
+    statistics.maxTime = qMax(statistics.maxTime, duration);
+    const qreal milliseconds = duration / 1000000.0;
+    qWarning().noquote() << "A synchronous mpv call blocked the GUI thread for"
+                         << milliseconds << "ms:" << operation << "from"
+                         << caller;
+    if (currentAutoAsync && !statistics.asynchronous &&
+        (statistics.calls >= autoAsyncLimit)) {
+        statistics.asynchronous = true;
+        qWarning().noquote() << "Switching" << operation
+                             << "to asynchronous calls.";
+    }
+    // Queued, the call may well come from the middle of a binding
+    // evaluation. The cast is fine, signals don't change the object.
+    QMetaObject::invokeMethod(
+        const_cast<MpvObject *>(this), "stallDetected", Qt::QueuedConnection,
+        Q_ARG(QString, QString::fromUtf8(operation)),
+        Q_ARG(QString, QString::fromUtf8(caller)), Q_ARG(qreal, milliseconds));
+}
+
+bool MpvObject::isAsyncOperation(const QByteArray &operation) const {
+    if (!currentAutoAsync) {
+        return false;
+    }
+    const auto iterator = stallStatisticsTable.constFind(operation);
+    return (iterator != stallStatisticsTable.constEnd()) &&
+        iterator->asynchronous;
+}
+
+void MpvObject::processAsyncPropertyReply(mpv_event_property *event) {
+    const QByteArray name(event->name);
+    asyncPropertyReads.remove(name);
+    if (event->format != MPV_FORMAT_NODE) {
+        return;
+    }
+    const QVariant value =
+        mpv::qt::node_to_variant(static_cast<mpv_node *>(event->data));
+    const auto iterator = asyncPropertyValues.find(name);
+    if ((iterator != asyncPropertyValues.end()) && (*iterator == value)) {
+        return;
+    }
+    asyncPropertyValues.insert(name, value);
+    // Whoever read the stale value reads again. The next read returns this
+    // value and gets the same one back, so this doesn't loop.
+    const char *signalName = properties.value(name);
+    if (signalName != nullptr) {
+        QMetaObject::invokeMethod(this, signalName, Qt::QueuedConnection);
+    }
+}
+
+bool MpvObject::mpvObserveProperty(const char *name, mpv_format format) {
     if (name == nullptr) {
         return false;
     }
-    qDebug().noquote() << "Observing a property from mpv:" << name;
-    const int errorCode = mpv_observe_property(mpv, 0, name, MPV_FORMAT_NONE);
+    qCDebug(lcMpvCalls).noquote() << "Observing a property from mpv:" << name;
+    const int errorCode = mpv_observe_property(mpv, 0, name, format);
     if (errorCode < 0) {
         qWarning().noquote()
             << "Failed to observe a property from mpv:" << name;
@@ -442,9 +1233,16 @@ int MpvObject::videoRotate() const {
 }
 
 qreal MpvObject::videoAspect() const {
-    return isStopped()
-        ? 1.7777
-        : qMax(mpvGetProperty("video-out-params/aspect").toReal(), 0.0);
+    if (isStopped()) {
+        return 1.7777;
+    }
+    // setVideoAspect() writes the override, which only shows up in the
+    // output parameters once mpv has applied it.
+    const qreal pendingAspect = pendingWriteValue("video-aspect").toReal();
+    if (pendingAspect > 0.0) {
+        return pendingAspect;
+    }
+    return qMax(mpvGetProperty("video-out-params/aspect").toReal(), 0.0);
 }
 
 qreal MpvObject::speed() const {
@@ -452,7 +1250,7 @@ qreal MpvObject::speed() const {
 }
 
 bool MpvObject::deinterlace() const {
-    return mpvGetProperty("deinterlace").toBool();
+    return choiceToBool(mpvGetProperty("deinterlace"));
 }
 
 bool MpvObject::audioExclusive() const {
@@ -507,7 +1305,9 @@ QString MpvObject::profile() const {
     return mpvGetProperty("profile").toString();
 }
 
-bool MpvObject::hrSeek() const { return mpvGetProperty("hr-seek").toBool(); }
+bool MpvObject::hrSeek() const {
+    return choiceToBool(mpvGetProperty("hr-seek"));
+}
 
 bool MpvObject::ytdl() const { return mpvGetProperty("ytdl").toBool(); }
 
@@ -563,8 +1363,12 @@ MpvObject::MpvCallType MpvObject::mpvCallType() const {
 }
 
 MpvObject::MediaTracks MpvObject::mediaTracks() const {
+    return parseTrackList(mpvGetProperty("track-list").toList());
+}
+
+MpvObject::MediaTracks
+MpvObject::parseTrackList(const QVariantList &trackList) {
     MediaTracks mediaTracks;
-    QVariantList trackList = mpvGetProperty("track-list").toList();
     for (auto &&track : std::as_const(trackList)) {
         const auto trackInfo = track.toMap();
         if ((trackInfo[QString::fromUtf8("type")] !=
@@ -642,9 +1446,31 @@ MpvObject::MediaTracks MpvObject::mediaTracks() const {
     return mediaTracks;
 }
 
+QStringList MpvObject::videoSuffixes() const {
+    static const QStringList suffixes =
+        MpvMediaScanner::nameFilters(MpvMediaScanner::MediaType::Video);
+    return suffixes;
+}
+
+QStringList MpvObject::audioSuffixes() const {
+    static const QStringList suffixes =
+        MpvMediaScanner::nameFilters(MpvMediaScanner::MediaType::Audio);
+    return suffixes;
+}
+
+QStringList MpvObject::subtitleSuffixes() const {
+    static const QStringList suffixes =
+        MpvMediaScanner::nameFilters(MpvMediaScanner::MediaType::Subtitle);
+    return suffixes;
+}
+
 MpvObject::Chapters MpvObject::chapters() const {
+    return parseChapterList(mpvGetProperty("chapter-list").toList());
+}
+
+MpvObject::Chapters
+MpvObject::parseChapterList(const QVariantList &chapterList) {
     Chapters chapters;
-    QVariantList chapterList = mpvGetProperty("chapter-list").toList();
     for (auto &&chapter : std::as_const(chapterList)) {
         const auto chapterInfo = chapter.toMap();
         SingleTrackInfo singleTrackInfo;
@@ -682,6 +1508,65 @@ qreal MpvObject::estimatedVfFps() const {
                        : qMax(mpvGetProperty("estimated-vf-fps").toReal(), 0.0);
 }
 
+MpvObject::MemoryPriority MpvObject::memoryPriority() const {
+    return currentMemoryPriority;
+}
+
+qint64 MpvObject::demuxerCacheLimit() const {
+    return currentDemuxerCacheLimit;
+}
+
+qint64 MpvObject::demuxerCacheUsage() const {
+    return isStopped() ? 0 : demuxerCacheBytes;
+}
+
+MpvPlaylistModel *MpvObject::playlist() const { return playlistModel; }
+
+int MpvObject::playlistPos() const {
+    return mpvGetProperty("playlist-pos").toInt();
+}
+
+int MpvObject::playlistCount() const { return playlistModel->count(); }
+
+bool MpvObject::loopPlaylist() const {
+    // Either a boolean or the number of loops, "inf" is a string.
+    return choiceToBool(mpvGetProperty("loop-playlist"));
+}
+
+int MpvObject::standbyCapacity() const { return currentStandbyCapacity; }
+
+QList<QUrl> MpvObject::standbySources() const {
+    QList<QUrl> sources;
+    for (auto &&standby : std::as_const(standbyPlayers)) {
+        sources.append(standby->source);
+    }
+    return sources;
+}
+
+QVariantMap MpvObject::loadTimings() const { return lastLoadTimings; }
+
+int MpvObject::stallThreshold() const { return currentStallThreshold; }
+
+bool MpvObject::autoAsync() const { return currentAutoAsync; }
+
+bool MpvObject::scrubbing() const { return currentScrubbing; }
+
+bool MpvObject::backwardStepCache() const { return currentBackwardStepCache; }
+
+int MpvObject::warmUpCount() const { return currentWarmUpCount; }
+
+bool MpvObject::displaySync() const { return currentDisplaySync; }
+
+qreal MpvObject::vsyncJitter() const { return currentVsyncJitter; }
+
+qint64 MpvObject::mistimedFrameCount() const {
+    return currentMistimedFrameCount;
+}
+
+qint64 MpvObject::voDelayedFrameCount() const {
+    return currentVoDelayedFrameCount;
+}
+
 bool MpvObject::open(const QUrl &url) {
     if (!url.isValid()) {
         return false;
@@ -695,10 +1580,52 @@ bool MpvObject::open(const QUrl &url) {
     return true;
 }
 
+bool MpvObject::open(const QUrl &url, const QVariantMap &options) {
+    if (!url.isValid()) {
+        return false;
+    }
+    const bool startPaused =
+        options.value(QString::fromUtf8("startPaused"), false).toBool();
+    const qreal prerollSeconds = qMax(
+        options.value(QString::fromUtf8("prerollSeconds"), 0.0).toReal(), 0.0);
+    if (!startPaused && qFuzzyIsNull(prerollSeconds)) {
+        return open(url);
+    }
+    endPreroll();
+    preroll.active = true;
+    preroll.seconds = prerollSeconds;
+    preroll.timer.start();
+    // The demuxer keeps reading while paused, but only as far as this.
+    const qreal readahead = mpvGetProperty("demuxer-readahead-secs").toReal();
+    if (prerollSeconds > readahead) {
+        preroll.previousReadahead = readahead;
+        mpvSetProperty("demuxer-readahead-secs", prerollSeconds);
+    }
+    // "pause" is not reset by loadfile, so the file stays paused after it
+    // has been loaded. "play-dir" isn't either.
+    mpvSetProperty("pause", startPaused);
+    setPlayBackward(false);
+    beginLoadTrace();
+    // Always reload, the caller wants the file prepared from the start.
+    const bool result = mpvSendCommand(
+        QVariantList{QString::fromUtf8("loadfile"),
+                     MpvStreamSource::mpvPath(url, true)});
+    if (!result) {
+        endPreroll();
+        return false;
+    }
+    if (url != currentSource) {
+        currentSource = url;
+        Q_EMIT sourceChanged();
+    }
+    return true;
+}
+
 bool MpvObject::play() {
     if (!isPaused() || !currentSource.isValid()) {
         return false;
     }
+    setPlayBackward(false);
     const bool result = mpvSetProperty("pause", false);
     if (result) {
         Q_EMIT playing();
@@ -749,6 +1676,13 @@ bool MpvObject::seek(qint64 value, bool absolute, bool percent) {
     const qint64 min = (absolute || percent) ? 0 : -position();
     const qint64 max =
         percent ? 100 : (absolute ? duration() : duration() - position());
+    if (MpvTracer::isEnabled()) {
+        const QByteArray detail = QByteArray::number(value) +
+            (percent ? "%" : (absolute ? " absolute" : " relative"));
+        MpvTracer::instant(MpvTracer::Category::Seek, "seek",
+                           detail.constData());
+    }
+    seekSentTime = steadyClockNanoseconds();
     return mpvSendCommand(
         QVariantList{QString::fromUtf8("seek"), qBound(min, value, max),
                      percent ? QString::fromUtf8("absolute-percent")
@@ -756,7 +1690,148 @@ bool MpvObject::seek(qint64 value, bool absolute, bool percent) {
                                          : QString::fromUtf8("relative"))});
 }
 
-bool MpvObject::seekAbsolute(qint64 position) {
+bool MpvObject::beginScrub() {
+    if (isStopped() || currentScrubbing) {
+        return false;
+    }
+    currentScrubbing = true;
+    scrubMoved = false;
+    scrubTargetPending = false;
+    Q_EMIT scrubbingChanged();
+    return true;
+}
+
+bool MpvObject::scrubTo(qreal position) {
+    if (!currentScrubbing) {
+        return false;
+    }
+    // mpv clamps the end itself, no need for a synchronous duration().
+    scrubTarget = qMax(position, 0.0);
+    scrubMoved = true;
+    if (scrubSeekInFlight && (scrubSeekTimer.elapsed() < scrubSeekTimeout)) {
+        // Replaces whatever was waiting, sent by finishScrubSeek().
+        scrubTargetPending = true;
+        return true;
+    }
+    scrubTargetPending = false;
+    return sendScrubSeek(scrubTarget, false);
+}
+
+bool MpvObject::endScrub() {
+    if (!currentScrubbing) {
+        return false;
+    }
+    currentScrubbing = false;
+    scrubTargetPending = false;
+    Q_EMIT scrubbingChanged();
+    // Nothing to correct if the handle was never moved.
+    return !scrubMoved || sendScrubSeek(scrubTarget, true);
+}
+
+bool MpvObject::sendScrubSeek(qreal position, bool exact) {
+    flushPropertyWrites();
+    const QString flags = exact ? QString::fromUtf8("absolute+exact")
+                                : QString::fromUtf8("absolute+keyframes");
+    if (MpvTracer::isEnabled()) {
+        const QByteArray detail =
+            QByteArray::number(position) + ' ' + flags.toUtf8();
+        MpvTracer::instant(MpvTracer::Category::Seek, "scrub",
+                           detail.constData());
+    }
+    const int errorCode = mpv::qt::command_async(
+        mpv, QVariantList{QString::fromUtf8("seek"), position, flags},
+        scrubSeekTag);
+    countAsyncRequest(errorCode);
+    if (errorCode < 0) {
+        qWarning().noquote() << "Failed to seek to:" << position;
+        return false;
+    }
+    scrubSeekInFlight = true;
+    scrubSeekTimer.start();
+    seekSentTime = steadyClockNanoseconds();
+    return true;
+}
+
+void MpvObject::finishScrubSeek() {
+    scrubSeekInFlight = false;
+    if (currentScrubbing && scrubTargetPending) {
+        scrubTargetPending = false;
+        sendScrubSeek(scrubTarget, false);
+    }
+}
+
+bool MpvObject::stepFrames(int frames) { return step(frames, false); }
+
+bool MpvObject::stepBack(int frames) { return step(frames, true); }
+
+bool MpvObject::step(int frames, bool backward) {
+    if (isStopped() || (frames < 1)) {
+        return false;
+    }
+    // In backward playback mode, "forward" is backwards in time.
+    const bool reversed = backward && currentBackwardStepCache;
+    if (!setPlayBackward(reversed)) {
+        return false;
+    }
+    if (MpvTracer::isEnabled()) {
+        const QByteArray detail =
+            QByteArray::number(backward ? -frames : frames);
+        MpvTracer::instant(MpvTracer::Category::Seek, "step",
+                           detail.constData());
+    }
+    seekSentTime = steadyClockNanoseconds();
+    if (frames == 1) {
+        return mpvSendCommand(
+            QVariantList{(backward && !reversed)
+                             ? QString::fromUtf8("frame-back-step")
+                             : QString::fromUtf8("frame-step")});
+    }
+    const qreal fps = qMax(mpvGetProperty("container-fps").toReal(), 0.0);
+    if (qFuzzyIsNull(fps)) {
+        return false;
+    }
+    mpvSetProperty("pause", true);
+    return mpvSendCommand(QVariantList{
+        QString::fromUtf8("seek"), (backward ? -frames : frames) / fps,
+        QString::fromUtf8("relative+exact")});
+}
+
+bool MpvObject::setPlayBackward(bool backward) {
+    if (backward == playingBackward) {
+        return true;
+    }
+    // Switching the direction is a seek to the current position, the
+    // backward one starts by decoding the keyframe range around it.
+    if (!mpvSetProperty("play-dir", backward ? QString::fromUtf8("backward")
+                                             : QString::fromUtf8("forward"))) {
+        return false;
+    }
+    playingBackward = backward;
+    return true;
+}
+
+void MpvObject::warmUpcomingEntries() {
+    const int current = playlistModel->currentIndex();
+    const int count = playlistModel->count();
+    if ((currentWarmUpCount <= 0) || (current < 0) || (count < 2)) {
+        return;
+    }
+    const bool wrap = loopPlaylist();
+    for (int i = 1; i <= qMin(currentWarmUpCount, count - 1); ++i) {
+        int index = current + i;
+        if (index >= count) {
+            if (!wrap) {
+                break;
+            }
+            index -= count;
+        }
+        // Non-local entries are ignored by MpvWarmUp.
+        MpvWarmUp::instance()->warm(MpvPlaylistModel::urlFromFileName(
+            playlistModel->entry(index).fileName));
+    }
+}
+
+bool MpvObject::seekAbsolute(qint64 position) {
     if (isStopped() || (position == this->position())) {
         return false;
     }
@@ -797,13 +1872,714 @@ bool MpvObject::screenshotToFile(const QString &filePath) {
                                        QString::fromUtf8("subtitles")});
 }
 
+int MpvObject::grabFrame(const QString &mode) {
+    return grabFrame(mode, FrameCallback());
+}
+
+int MpvObject::grabFrame(const QString &mode, const FrameCallback &callback) {
+    if (isStopped() ||
+        ((mode != QString::fromUtf8("video")) &&
+         (mode != QString::fromUtf8("subtitles")) &&
+         (mode != QString::fromUtf8("window")))) {
+        return -1;
+    }
+    const int requestId = ++grabFrameSerial;
+    // The handle copy keeps mpv alive until the grab is done, even if this
+    // item goes away in the meantime.
+    const mpv::qt::Handle handle = mpv;
+    const QPointer<MpvObject> guard(this);
+    const QByteArray modeName = mode.toUtf8();
+    grabThreadPool()->start([handle, guard, modeName, requestId, callback]() {
+        const QImage image =
+            MpvHeadlessPlayer::grabFrame(handle, modeName.constData());
+        // Posted to the application object because this item may be
+        // destroyed at any time, the guard is only checked on the GUI
+        // thread.
+        QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [guard, requestId, callback, image]() {
+                if (guard.isNull()) {
+                    return;
+                }
+                if (callback) {
+                    callback(image);
+                }
+                Q_EMIT guard->frameGrabbed(requestId, image);
+            },
+            Qt::QueuedConnection);
+    });
+    return requestId;
+}
+
+bool MpvObject::addFrameTap(MpvFrameConsumer *consumer,
+                            const MpvFrameTapOptions &options) {
+    if (consumer == nullptr) {
+        return false;
+    }
+    for (auto &&tap : std::as_const(frameTaps)) {
+        if (tap->consumer() == consumer) {
+            return false;
+        }
+    }
+    frameTaps.append(MpvFrameTapPtr::create(consumer, options));
+    update();
+    return true;
+}
+
+bool MpvObject::removeFrameTap(MpvFrameConsumer *consumer) {
+    for (int i = 0; i != frameTaps.count(); ++i) {
+        const MpvFrameTapPtr tap = frameTaps.at(i);
+        if (tap->consumer() != consumer) {
+            continue;
+        }
+        // The renderer lets go of it in the next synchronize(), until then
+        // it only drops what it gets.
+        tap->stop();
+        frameTaps.removeAt(i);
+        update();
+        return true;
+    }
+    return false;
+}
+
+const MpvHistogram &MpvObject::renderTimeHistogram() const {
+    return metrics.renderTime;
+}
+
+const MpvHistogram &MpvObject::eventDrainHistogram() const {
+    return metrics.eventDrainTime;
+}
+
+const MpvPlayerMetrics &MpvObject::playerMetrics() const { return metrics; }
+
+QVariantMap MpvObject::metricsSnapshot() const {
+    return metrics.toVariantMap();
+}
+
+void MpvObject::beginUpdate() { ++updateDepth; }
+
+void MpvObject::commitUpdate() {
+    if (updateDepth <= 0) {
+        qWarning().noquote() << "commitUpdate() without beginUpdate().";
+        return;
+    }
+    if (--updateDepth == 0) {
+        flushPropertyWrites();
+    }
+}
+
+bool MpvObject::setProperties(const QVariantMap &properties) {
+    if (properties.isEmpty()) {
+        return false;
+    }
+    bool result = true;
+    beginUpdate();
+    for (auto it = properties.cbegin(); it != properties.cend(); ++it) {
+        result = queuePropertyWrite(it.key().toUtf8().constData(),
+                                    it.value()) &&
+            result;
+    }
+    commitUpdate();
+    return result;
+}
+
+QVariantList MpvObject::stallStatistics() const {
+    QVector<QByteArray> operations = stallStatisticsTable.keys().toVector();
+    std::sort(operations.begin(), operations.end(),
+              [this](const QByteArray &lhs, const QByteArray &rhs) {
+                  return stallStatisticsTable.value(lhs).totalTime >
+                      stallStatisticsTable.value(rhs).totalTime;
+              });
+    QVariantList list;
+    for (auto &&operation : std::as_const(operations)) {
+        const StallStatistics statistics =
+            stallStatisticsTable.value(operation);
+        QVariantMap entry;
+        entry[QString::fromUtf8("operation")] = QString::fromUtf8(operation);
+        entry[QString::fromUtf8("caller")] =
+            QString::fromUtf8(statistics.caller);
+        entry[QString::fromUtf8("calls")] = statistics.calls;
+        entry[QString::fromUtf8("totalTime")] =
+            statistics.totalTime / 1000000.0;
+        entry[QString::fromUtf8("maxTime")] = statistics.maxTime / 1000000.0;
+        entry[QString::fromUtf8("asynchronous")] = statistics.asynchronous;
+        list.append(entry);
+    }
+    return list;
+}
+
+void MpvObject::resetStallStatistics() {
+    stallStatisticsTable.clear();
+    asyncPropertyValues.clear();
+}
+
+int MpvObject::captureInterval(qreal interval, const QVariantMap &options) {
+    return trackCapture(MpvFrameCapture::instance()->captureInterval(
+        currentSource, interval, captureOptions(options)));
+}
+
+int MpvObject::captureBurst(qreal position, int framesBefore,
+                            int framesAfter, const QVariantMap &options) {
+    return trackCapture(MpvFrameCapture::instance()->captureBurst(
+        currentSource, position, framesBefore, framesAfter,
+        captureOptions(options)));
+}
+
+int MpvObject::captureSceneChanges(qreal threshold,
+                                   const QVariantMap &options) {
+    return trackCapture(MpvFrameCapture::instance()->captureSceneChanges(
+        currentSource, threshold, captureOptions(options)));
+}
+
+void MpvObject::cancelCapture(int captureId) {
+    if (captureIds.contains(captureId)) {
+        MpvFrameCapture::instance()->cancel(captureId);
+    }
+}
+
+QVariantMap MpvObject::captureOptions(const QVariantMap &options) const {
+    QVariantMap result = options;
+    const auto setDefault = [&result](const char *name,
+                                      const QVariant &value) {
+        const QString key = QString::fromUtf8(name);
+        if (!result.contains(key)) {
+            result.insert(key, value);
+        }
+    };
+    setDefault("format", screenshotFormat());
+    setDefault("jpegQuality", screenshotJpegQuality());
+    setDefault("pngCompression", screenshotPngCompression());
+    setDefault("template", screenshotTemplate());
+    setDefault("directory", screenshotDirectory());
+    return result;
+}
+
+int MpvObject::trackCapture(int captureId) {
+    if (captureId >= 0) {
+        captureIds.insert(captureId);
+    }
+    return captureId;
+}
+
+bool MpvObject::playlistAppend(const QUrl &url) {
+    return playlistAppendList(QList<QUrl>{url});
+}
+
+bool MpvObject::playlistAppendList(const QList<QUrl> &urls) {
+    bool result = !urls.isEmpty();
+    for (auto &&url : std::as_const(urls)) {
+        if (!url.isValid()) {
+            result = false;
+            continue;
+        }
+        // "append-play" only starts playback if the player is idle.
+        if (!mpvSendCommandAsync(QVariantList{
+                QString::fromUtf8("loadfile"),
+                MpvStreamSource::mpvPath(url, true),
+                QString::fromUtf8("append-play")})) {
+            result = false;
+        }
+    }
+    return result;
+}
+
+bool MpvObject::playlistRemove(int index) {
+    if ((index < 0) || (index >= playlistCount())) {
+        return false;
+    }
+    return mpvSendCommandAsync(
+        QVariantList{QString::fromUtf8("playlist-remove"), index});
+}
+
+bool MpvObject::playlistMove(int from, int to) {
+    if ((from < 0) || (from >= playlistCount()) || (to < 0) || (from == to)) {
+        return false;
+    }
+    // mpv inserts before the target entry, so moving downwards needs the
+    // index after the target.
+    return mpvSendCommandAsync(QVariantList{QString::fromUtf8("playlist-move"),
+                                            from, (to > from) ? to + 1 : to});
+}
+
+bool MpvObject::playlistClear() {
+    return mpvSendCommandAsync(
+        QVariantList{QString::fromUtf8("playlist-clear")});
+}
+
+bool MpvObject::playlistNext() {
+    if (playlistCount() < 2) {
+        return false;
+    }
+    return mpvSendCommandAsync(QVariantList{QString::fromUtf8("playlist-next"),
+                                            QString::fromUtf8("weak")});
+}
+
+bool MpvObject::playlistPrev() {
+    if (playlistCount() < 2) {
+        return false;
+    }
+    return mpvSendCommandAsync(QVariantList{QString::fromUtf8("playlist-prev"),
+                                            QString::fromUtf8("weak")});
+}
+
+bool MpvObject::playlistPlay(int index) {
+    if ((index < 0) || (index >= playlistCount())) {
+        return false;
+    }
+    return mpvSetProperty("playlist-pos", index);
+}
+
+bool MpvObject::armStandby(const QUrl &url) {
+    if (!url.isValid() || (mpv_gl == nullptr) || (standbyCapacity() <= 0)) {
+        return false;
+    }
+    const StandbyPlayerPtr existing = findStandby(url);
+    if (!existing.isNull()) {
+        // Keep it, but mark it as the most recently used one.
+        standbyPlayers.removeAll(existing);
+        standbyPlayers.append(existing);
+        Q_EMIT standbySourcesChanged();
+        return true;
+    }
+    mpv_handle *handle = mpv_create();
+    if (handle == nullptr) {
+        return false;
+    }
+    auto standby = StandbyPlayerPtr::create();
+    standby->mpv = mpv::qt::Handle::FromRawHandle(handle);
+    standby->source = url;
+    standby->prepareTimer.start();
+    applyHandleDefaults(standby->mpv);
+    // Whatever has been configured for the visible player must also apply
+    // to the standby one, otherwise the swap would be noticeable.
+    static const char *const inheritedProperties[] = {
+        "hwdec", "ao", "volume", "mute", "speed", "hr-seek", "deinterlace",
+        "sub-auto", "sub-codepage", "audio-file-auto", "ytdl", "load-scripts"};
+    for (auto &&name : inheritedProperties) {
+        bool ok = false;
+        const QVariant value = mpvGetProperty(name, &ok);
+        if (ok) {
+            mpv::qt::set_property(standby->mpv, name, value);
+        }
+    }
+    mpv::qt::set_property(standby->mpv, "pause", true);
+    // Enough to hold the first seconds, the full share is only given to
+    // the standby player once it becomes visible. MpvMemoryBudget makes
+    // room for it as soon as it has been added.
+    standby->cacheLimit = MpvMemoryBudget::instance()->standbyShare();
+    mpv::qt::set_property(standby->mpv, "demuxer-max-bytes",
+                          QString::number(standby->cacheLimit));
+    mpv::qt::set_property(standby->mpv, "demuxer-max-back-bytes",
+                          QString::number(0));
+    mpv_set_wakeup_callback(standby->mpv, standbyWakeup, this);
+    if (mpv_initialize(standby->mpv) < 0) {
+        qWarning().noquote() << "Failed to initialize a standby player for:"
+                             << url;
+        return false;
+    }
+    MpvStreamSource::registerProtocols(standby->mpv);
+    standbyPlayers.append(standby);
+    trimStandbyPlayers();
+    Q_EMIT standbySourcesChanged();
+    // The render context can only be created on the render thread.
+    update();
+    return true;
+}
+
+bool MpvObject::disarmStandby(const QUrl &url) {
+    const StandbyPlayerPtr standby = findStandby(url);
+    if (standby.isNull()) {
+        return false;
+    }
+    retireStandby(standby);
+    Q_EMIT standbySourcesChanged();
+    return true;
+}
+
+bool MpvObject::isStandbyReady(const QUrl &url) const {
+    const StandbyPlayerPtr standby = findStandby(url);
+    return !standby.isNull() && standby->ready;
+}
+
+bool MpvObject::activateStandby(const QUrl &url) {
+    const StandbyPlayerPtr standby = findStandby(url);
+    if (standby.isNull() || (standby->mpv_gl == nullptr) ||
+        !pendingStandbyActivation.isNull() || !activatedStandby.isNull()) {
+        return false;
+    }
+    resumeAfterStandbyActivation = !isPaused();
+    pendingStandbyActivation = standby;
+    update();
+    return true;
+}
+
+QUrl MpvObject::thumbnailSource(qreal position) const {
+    return MpvThumbnailEngine::instance()->thumbnailSource(currentSource,
+                                                           position);
+}
+
+MpvObject::StandbyPlayerPtr MpvObject::findStandby(const QUrl &url) const {
+    for (auto &&standby : std::as_const(standbyPlayers)) {
+        if (standby->source == url) {
+            return standby;
+        }
+    }
+    return StandbyPlayerPtr();
+}
+
+void MpvObject::retireStandby(const StandbyPlayerPtr &standby) {
+    if (standby.isNull()) {
+        return;
+    }
+    standbyPlayers.removeAll(standby);
+    if (pendingStandbyActivation == standby) {
+        pendingStandbyActivation.clear();
+    }
+    // The renderer frees the render context on the next frame, the mpv
+    // handle goes away together with the last reference.
+    retiredStandbyPlayers.append(standby);
+    update();
+}
+
+void MpvObject::trimStandbyPlayers() {
+    while (standbyPlayers.count() > standbyCapacity()) {
+        retireStandby(standbyPlayers.constFirst());
+    }
+}
+
+void MpvObject::loadStandbySources() {
+    for (auto &&standby : std::as_const(standbyPlayers)) {
+        if ((standby->mpv_gl == nullptr) || !standby->loadPending) {
+            continue;
+        }
+        standby->loadPending = false;
+        mpv::qt::command_async(
+            standby->mpv,
+            QVariantList{QString::fromUtf8("loadfile"),
+                         MpvStreamSource::mpvPath(standby->source)},
+            0);
+    }
+}
+
+void MpvObject::handleStandbyEvents() {
+    // Copied because failed players are removed while iterating.
+    const auto players = standbyPlayers;
+    for (auto &&standby : players) {
+        // Its handles have been swapped, but it isn't a standby player
+        // until finishStandbyActivation() has sorted it out.
+        if (standby == activatedStandby) {
+            continue;
+        }
+        bool failed = false;
+        while (!failed) {
+            mpv_event *event = mpv_wait_event(standby->mpv, 0);
+            if (event->event_id == MPV_EVENT_NONE) {
+                break;
+            }
+            switch (event->event_id) {
+            case MPV_EVENT_FILE_LOADED:
+                standby->loaded = true;
+                break;
+            // Requests made before this handle was swapped out.
+            case MPV_EVENT_SET_PROPERTY_REPLY:
+            case MPV_EVENT_COMMAND_REPLY:
+                if ((event->reply_userdata == asyncRequestTag) ||
+                    (event->reply_userdata == coalescedWriteTag) ||
+                    (event->reply_userdata == scrubSeekTag) ||
+                    (event->reply_userdata == demuxerLimitTag)) {
+                    metrics.finishAsyncRequest();
+                }
+                break;
+            // The standby player is paused, so this arrives once the first
+            // frame has been decoded and handed to the video output.
+            case MPV_EVENT_PLAYBACK_RESTART:
+                if (standby->loaded && !standby->ready) {
+                    standby->ready = true;
+                    Q_EMIT standbyReady(standby->source,
+                                        standby->prepareTimer.elapsed());
+                }
+                break;
+            case MPV_EVENT_END_FILE:
+                if (static_cast<mpv_event_end_file *>(event->data)->reason ==
+                    MPV_END_FILE_REASON_ERROR) {
+                    qWarning().noquote()
+                        << "Failed to open a standby player for:"
+                        << standby->source;
+                    failed = true;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        if (failed) {
+            retireStandby(standby);
+            Q_EMIT standbySourcesChanged();
+            Q_EMIT standbyFailed(standby->source);
+        }
+    }
+}
+
+void MpvObject::finishStandbyActivation() {
+    const StandbyPlayerPtr standby = activatedStandby;
+    activatedStandby.clear();
+    if (standby.isNull()) {
+        return;
+    }
+    // The renderer has swapped the handles (and wakeup callbacks) already:
+    // "mpv" is the player that has just been activated and "standby" now
+    // holds the one that was visible before.
+    // The replies to the writes still in flight arrive on the previous
+    // handle, the values there are no business of this one.
+    unconfirmedWrites.clear();
+    unconfirmedWriteCount = 0;
+    demuxerLimitReplies = 0;
+    demuxerLimitFailed = false;
+    staleLoadTraceReads = 0;
+    loadTrace.detailReads = 0;
+    const QUrl activatedSource = standby->source;
+    const QUrl previousSource = currentSource;
+    mpv::qt::set_property_async(standby->mpv, "pause", true, 0);
+    mpv_unobserve_property(standby->mpv, frameDropObserver);
+    observingFrameDrops = false;
+    updateFrameDropObservation();
+    // Standby players are played forward once activated. The activated
+    // one has never been stepped back.
+    if (playingBackward) {
+        mpv::qt::set_property_async(standby->mpv, "play-dir",
+                                    QString::fromUtf8("forward"), 0);
+        playingBackward = false;
+    }
+    standby->cacheLimit = MpvMemoryBudget::instance()->standbyShare();
+    mpv::qt::set_property_async(standby->mpv, "demuxer-max-bytes",
+                                QString::number(standby->cacheLimit), 0);
+    mpv::qt::set_property_async(standby->mpv, "demuxer-max-back-bytes",
+                                QString::number(0), 0);
+    // Back to mpv's defaults, like every handle that has just been created.
+    if (gaplessPlayback) {
+        mpv::qt::set_property_async(standby->mpv, "prefetch-playlist", false,
+                                    0);
+        mpv::qt::set_property_async(standby->mpv, "gapless-audio",
+                                    QString::fromUtf8("weak"), 0);
+        gaplessPlayback = false;
+    }
+    standby->source = previousSource;
+    standby->loadPending = false;
+    standby->loaded = standby->ready = true;
+    standbyPlayers.removeAll(standby);
+    if (previousSource.isValid()) {
+        standbyPlayers.append(standby);
+    } else {
+        retiredStandbyPlayers.append(standby);
+    }
+    trimStandbyPlayers();
+
+    if ((currentDemuxerMaxBytes >= 0) && (currentDemuxerMaxBackBytes >= 0)) {
+        setDemuxerCacheLimits(requestedDemuxerMaxBytes,
+                              requestedDemuxerMaxBackBytes);
+    }
+    if (currentDisplaySync) {
+        applyDisplaySync();
+    }
+    if (resumeAfterStandbyActivation) {
+        mpvSetProperty("pause", false);
+    }
+    currentSource = activatedSource;
+    processMpvPlaylistChange(mpvGetProperty("playlist").toList());
+    // The last change event of the activated handle went to the standby
+    // path.
+    demuxerCacheBytes =
+        demuxerCacheStateBytes(mpvGetProperty("demuxer-cache-state"));
+    Q_EMIT demuxerCacheUsageChanged();
+    setMediaStatus(MediaStatus::Loaded);
+    Q_EMIT sourceChanged();
+    // Everything the property observers would report may be different now.
+    QSet<QByteArray> signalNames;
+    auto iterator = properties.constBegin();
+    while (iterator != properties.constEnd()) {
+        signalNames.insert(QByteArray(iterator.value()));
+        ++iterator;
+    }
+    for (auto &&signalName : std::as_const(signalNames)) {
+        QMetaObject::invokeMethod(this, signalName.constData());
+    }
+    playbackStateChangeEvent();
+    Q_EMIT standbySourcesChanged();
+    // The swapped in player has been prepared out of sight, its load
+    // timeline doesn't belong to this one.
+    endLoadTrace();
+    Q_EMIT standbyActivated(activatedSource);
+    // Events that arrived before the swap, and the ones of the previous
+    // player that were held back until now.
+    handleMpvEvents();
+    handleStandbyEvents();
+}
+
+void MpvObject::firstFrameRendered(qint64 renderTime) {
+    preroll.frameRendered = true;
+    checkPrerollFinished();
+    markLoadPhase(QString::fromUtf8("firstFrame"), renderTime);
+}
+
+void MpvObject::checkPrerollFinished() {
+    if (!preroll.active || !preroll.loaded || !preroll.frameRendered) {
+        return;
+    }
+    // The cache being idle means the demuxer has nothing left to read,
+    // either because the file is shorter than requested or because the
+    // memory budget doesn't allow more.
+    if ((demuxerCacheDuration < preroll.seconds) && !demuxerCacheIdle) {
+        return;
+    }
+    const qint64 prepareTime = preroll.timer.elapsed();
+    endPreroll();
+    Q_EMIT ready(prepareTime);
+}
+
+void MpvObject::endPreroll() {
+    // What has been read so far stays cached, the demuxer just doesn't read
+    // ahead that far any more.
+    if (preroll.previousReadahead >= 0.0) {
+        mpvSetProperty("demuxer-readahead-secs", preroll.previousReadahead);
+    }
+    preroll = PrerollState();
+}
+
+void MpvObject::beginLoadTrace() {
+    endLoadTrace();
+    loadTrace.active = true;
+    loadTrace.startTime = steadyClockNanoseconds();
+}
+
+void MpvObject::markLoadPhase(const QString &phase, qint64 timestamp) {
+    if (!loadTrace.active || loadTrace.timings.contains(phase)) {
+        return;
+    }
+    loadTrace.timings[phase] =
+        static_cast<qreal>(timestamp - loadTrace.startTime) / 1000000.0;
+    checkLoadTraceFinished();
+}
+
+void MpvObject::readLoadTraceDetails() {
+    // Still known here, unlike once the file has ended. "path" is the file
+    // actually loaded, also for gapless playlist transitions, where
+    // currentSource lags behind.
+    const char *names[] = {
+        "aid", "file-format", "path",
+#if MPV_CLIENT_API_VERSION >= MPV_MAKE_VERSION(1, 109)
+        loadTrace.expectVideo ? "current-tracks/video/codec"
+                              : "current-tracks/audio/codec",
+#else
+        loadTrace.expectVideo ? "video-codec" : "audio-codec",
+#endif
+    };
+    for (auto &&name : names) {
+        if (mpv_get_property_async(mpv, loadTraceTag, name, MPV_FORMAT_NODE) >=
+            0) {
+            ++loadTrace.detailReads;
+        }
+    }
+}
+
+void MpvObject::processLoadTraceReply(int errorCode,
+                                      mpv_event_property *event) {
+    // Replies arrive in order, those of a superseded trace come first.
+    if (staleLoadTraceReads > 0) {
+        --staleLoadTraceReads;
+        return;
+    }
+    if (!loadTrace.active || (loadTrace.detailReads <= 0)) {
+        return;
+    }
+    --loadTrace.detailReads;
+    const QByteArray name(event->name);
+    const QVariant value = ((errorCode >= 0) &&
+                            (event->format == MPV_FORMAT_NODE))
+        ? mpv::qt::node_to_variant(static_cast<mpv_node *>(event->data))
+        : QVariant();
+    if (name == "aid") {
+        loadTrace.expectAudio = value.toBool();
+        // Playback may have restarted already, which is where the audio
+        // starts with gapless-audio, see MPV_EVENT_PLAYBACK_RESTART.
+        QVariantMap &timings = loadTrace.timings;
+        const QString restart = QString::fromUtf8("playbackRestart");
+        if (loadTrace.expectAudio && timings.contains(restart)) {
+            const QString firstAudio = QString::fromUtf8("firstAudio");
+            if (!timings.contains(firstAudio)) {
+                timings[firstAudio] = timings.value(restart);
+            }
+        }
+    } else if (name == "file-format") {
+        loadTrace.timings[QString::fromUtf8("container")] = value;
+    } else if (name == "path") {
+        setLoadTraceSource(
+            MpvPlaylistModel::urlFromFileName(value.toString()));
+    } else {
+        loadTrace.timings[QString::fromUtf8("codec")] = value;
+    }
+    checkLoadTraceFinished();
+}
+
+void MpvObject::checkLoadTraceFinished() {
+    const auto &timings = loadTrace.timings;
+    if (!loadTrace.active || (loadTrace.detailReads > 0) ||
+        !timings.contains(QString::fromUtf8("fileLoaded")) ||
+        !timings.contains(QString::fromUtf8("playbackRestart"))) {
+        return;
+    }
+    if (loadTrace.expectVideo &&
+        !timings.contains(QString::fromUtf8("firstFrame"))) {
+        return;
+    }
+    if (loadTrace.expectAudio &&
+        !timings.contains(QString::fromUtf8("firstAudio"))) {
+        return;
+    }
+    loadTrace.timings[QString::fromUtf8("complete")] = true;
+    finishLoadTrace();
+}
+
+void MpvObject::endLoadTrace() {
+    // A trace that never saw its file start only belongs to a loadfile
+    // command that has been superseded, there's nothing to report.
+    if (loadTrace.active &&
+        loadTrace.timings.contains(QString::fromUtf8("startFile"))) {
+        loadTrace.timings[QString::fromUtf8("complete")] = false;
+        finishLoadTrace();
+    }
+    staleLoadTraceReads += loadTrace.detailReads;
+    loadTrace = LoadTrace();
+}
+
+void MpvObject::finishLoadTrace() {
+    QVariantMap &timings = loadTrace.timings;
+    loadTrace.active = false;
+    // Files that failed before FILE_LOADED only have the requested source.
+    if (!timings.contains(QString::fromUtf8("url"))) {
+        setLoadTraceSource(currentSource);
+    }
+    lastLoadTimings = timings;
+    Q_EMIT loadTimingsChanged();
+    MpvLoadStatistics::instance()->record(lastLoadTimings);
+}
+
+void MpvObject::setLoadTraceSource(const QUrl &url) {
+    const QString scheme = url.scheme();
+    loadTrace.timings[QString::fromUtf8("sourceType")] =
+        scheme.isEmpty() ? QString::fromUtf8("file") : scheme;
+    loadTrace.timings[QString::fromUtf8("url")] = url;
+}
+
 void MpvObject::setSource(const QUrl &source) {
     if (!source.isValid() || (source == currentSource)) {
         return;
     }
-    const bool result = mpvSendCommand(QVariantList{
-        QString::fromUtf8("loadfile"),
-        source.isLocalFile() ? source.toLocalFile() : source.url()});
+    // "play-dir" is an option, it would carry over to the next file.
+    setPlayBackward(false);
+    beginLoadTrace();
+    const bool result = mpvSendCommand(
+        QVariantList{QString::fromUtf8("loadfile"),
+                     MpvStreamSource::mpvPath(source, true)});
     if (result) {
         currentSource = source;
         Q_EMIT sourceChanged();
@@ -814,7 +2590,7 @@ void MpvObject::setMute(bool mute) {
     if (mute == this->mute()) {
         return;
     }
-    mpvSetProperty("mute", mute);
+    queuePropertyWrite("mute", mute);
 }
 
 void MpvObject::setPlaybackState(MpvObject::PlaybackState playbackState) {
@@ -889,110 +2665,110 @@ void MpvObject::setVolume(int volume) {
     if (volume == this->volume()) {
         return;
     }
-    mpvSetProperty("volume", qBound(0, volume, 100));
+    queuePropertyWrite("volume", qBound(0, volume, 100));
 }
 
 void MpvObject::setHwdec(const QString &hwdec) {
     if (hwdec.isEmpty() || (hwdec == this->hwdec())) {
         return;
     }
-    mpvSetProperty("hwdec", hwdec);
+    queuePropertyWrite("hwdec", hwdec);
 }
 
 void MpvObject::setVid(int vid) {
     if (isStopped() || (vid == this->vid())) {
         return;
     }
-    mpvSetProperty("vid", qMax(vid, 0));
+    queuePropertyWrite("vid", qMax(vid, 0));
 }
 
 void MpvObject::setAid(int aid) {
     if (isStopped() || (aid == this->aid())) {
         return;
     }
-    mpvSetProperty("aid", qMax(aid, 0));
+    queuePropertyWrite("aid", qMax(aid, 0));
 }
 
 void MpvObject::setSid(int sid) {
     if (isStopped() || (sid == this->sid())) {
         return;
     }
-    mpvSetProperty("sid", qMax(sid, 0));
+    queuePropertyWrite("sid", qMax(sid, 0));
 }
 
 void MpvObject::setVideoRotate(int videoRotate) {
     if (isStopped() || (videoRotate == this->videoRotate())) {
         return;
     }
-    mpvSetProperty("video-rotate", qBound(0, videoRotate, 359));
+    queuePropertyWrite("video-rotate", qBound(0, videoRotate, 359));
 }
 
 void MpvObject::setVideoAspect(qreal videoAspect) {
     if (isStopped() || (videoAspect == this->videoAspect())) {
         return;
     }
-    mpvSetProperty("video-aspect", qMax(videoAspect, 0.0));
+    queuePropertyWrite("video-aspect", qMax(videoAspect, 0.0));
 }
 
 void MpvObject::setSpeed(qreal speed) {
     if (isStopped() || (speed == this->speed())) {
         return;
     }
-    mpvSetProperty("speed", qMax(speed, 0.0));
+    queuePropertyWrite("speed", qMax(speed, 0.0));
 }
 
 void MpvObject::setDeinterlace(bool deinterlace) {
     if (deinterlace == this->deinterlace()) {
         return;
     }
-    mpvSetProperty("deinterlace", deinterlace);
+    queuePropertyWrite("deinterlace", deinterlace);
 }
 
 void MpvObject::setAudioExclusive(bool audioExclusive) {
     if (audioExclusive == this->audioExclusive()) {
         return;
     }
-    mpvSetProperty("audio-exclusive", audioExclusive);
+    queuePropertyWrite("audio-exclusive", audioExclusive);
 }
 
 void MpvObject::setAudioFileAuto(const QString &audioFileAuto) {
     if (audioFileAuto.isEmpty() || (audioFileAuto == this->audioFileAuto())) {
         return;
     }
-    mpvSetProperty("audio-file-auto", audioFileAuto);
+    queuePropertyWrite("audio-file-auto", audioFileAuto);
 }
 
 void MpvObject::setSubAuto(const QString &subAuto) {
     if (subAuto.isEmpty() || (subAuto == this->subAuto())) {
         return;
     }
-    mpvSetProperty("sub-auto", subAuto);
+    queuePropertyWrite("sub-auto", subAuto);
 }
 
 void MpvObject::setSubCodepage(const QString &subCodepage) {
     if (subCodepage.isEmpty() || (subCodepage == this->subCodepage())) {
         return;
     }
-    mpvSetProperty("sub-codepage",
-                   subCodepage.startsWith(QChar::fromLatin1('+'))
-                       ? subCodepage
-                       : (subCodepage.startsWith(QString::fromUtf8("cp"))
-                              ? QChar::fromLatin1('+') + subCodepage
-                              : subCodepage));
+    queuePropertyWrite("sub-codepage",
+                       subCodepage.startsWith(QChar::fromLatin1('+'))
+                           ? subCodepage
+                           : (subCodepage.startsWith(QString::fromUtf8("cp"))
+                                  ? QChar::fromLatin1('+') + subCodepage
+                                  : subCodepage));
 }
 
 void MpvObject::setVo(const QString &vo) {
     if (vo.isEmpty() || (vo == this->vo())) {
         return;
     }
-    mpvSetProperty("vo", vo);
+    queuePropertyWrite("vo", vo);
 }
 
 void MpvObject::setAo(const QString &ao) {
     if (ao.isEmpty() || (ao == this->ao())) {
         return;
     }
-    mpvSetProperty("ao", ao);
+    queuePropertyWrite("ao", ao);
 }
 
 void MpvObject::setScreenshotFormat(const QString &screenshotFormat) {
@@ -1000,15 +2776,15 @@ void MpvObject::setScreenshotFormat(const QString &screenshotFormat) {
         (screenshotFormat == this->screenshotFormat())) {
         return;
     }
-    mpvSetProperty("screenshot-format", screenshotFormat);
+    queuePropertyWrite("screenshot-format", screenshotFormat);
 }
 
 void MpvObject::setScreenshotPngCompression(int screenshotPngCompression) {
     if (screenshotPngCompression == this->screenshotPngCompression()) {
         return;
     }
-    mpvSetProperty("screenshot-png-compression",
-                   qBound(0, screenshotPngCompression, 9));
+    queuePropertyWrite("screenshot-png-compression",
+                       qBound(0, screenshotPngCompression, 9));
 }
 
 void MpvObject::setScreenshotTemplate(const QString &screenshotTemplate) {
@@ -1016,7 +2792,7 @@ void MpvObject::setScreenshotTemplate(const QString &screenshotTemplate) {
         (screenshotTemplate == this->screenshotTemplate())) {
         return;
     }
-    mpvSetProperty("screenshot-template", screenshotTemplate);
+    queuePropertyWrite("screenshot-template", screenshotTemplate);
 }
 
 void MpvObject::setScreenshotDirectory(const QString &screenshotDirectory) {
@@ -1024,7 +2800,7 @@ void MpvObject::setScreenshotDirectory(const QString &screenshotDirectory) {
         (screenshotDirectory == this->screenshotDirectory())) {
         return;
     }
-    mpvSetProperty("screenshot-directory", screenshotDirectory);
+    queuePropertyWrite("screenshot-directory", screenshotDirectory);
 }
 
 void MpvObject::setProfile(const QString &profile) {
@@ -1038,37 +2814,37 @@ void MpvObject::setHrSeek(bool hrSeek) {
     if (hrSeek == this->hrSeek()) {
         return;
     }
-    mpvSetProperty("hr-seek",
-                   hrSeek ? QString::fromUtf8("yes") : QString::fromUtf8("no"));
+    // mpv maps a flag onto the "yes" and "no" choices.
+    queuePropertyWrite("hr-seek", hrSeek);
 }
 
 void MpvObject::setYtdl(bool ytdl) {
     if (ytdl == this->ytdl()) {
         return;
     }
-    mpvSetProperty("ytdl", ytdl);
+    queuePropertyWrite("ytdl", ytdl);
 }
 
 void MpvObject::setLoadScripts(bool loadScripts) {
     if (loadScripts == this->loadScripts()) {
         return;
     }
-    mpvSetProperty("load-scripts", loadScripts);
+    queuePropertyWrite("load-scripts", loadScripts);
 }
 
 void MpvObject::setScreenshotTagColorspace(bool screenshotTagColorspace) {
     if (screenshotTagColorspace == this->screenshotTagColorspace()) {
         return;
     }
-    mpvSetProperty("screenshot-tag-colorspace", screenshotTagColorspace);
+    queuePropertyWrite("screenshot-tag-colorspace", screenshotTagColorspace);
 }
 
 void MpvObject::setScreenshotJpegQuality(int screenshotJpegQuality) {
     if (screenshotJpegQuality == this->screenshotJpegQuality()) {
         return;
     }
-    mpvSetProperty("screenshot-jpeg-quality",
-                   qBound(0, screenshotJpegQuality, 100));
+    queuePropertyWrite("screenshot-jpeg-quality",
+                       qBound(0, screenshotJpegQuality, 100));
 }
 
 void MpvObject::setMpvCallType(MpvObject::MpvCallType mpvCallType) {
@@ -1083,10 +2859,178 @@ void MpvObject::setPercentPos(int percentPos) {
     if (isStopped() || (percentPos == this->percentPos())) {
         return;
     }
-    mpvSetProperty("percent-pos", qBound(0, percentPos, 100));
+    queuePropertyWrite("percent-pos", qBound(0, percentPos, 100));
+}
+
+void MpvObject::setMemoryPriority(MpvObject::MemoryPriority memoryPriority) {
+    if (this->memoryPriority() == memoryPriority) {
+        return;
+    }
+    currentMemoryPriority = memoryPriority;
+    Q_EMIT memoryPriorityChanged();
+}
+
+void MpvObject::setPlaylistPos(int playlistPos) {
+    if (playlistPos == this->playlistPos()) {
+        return;
+    }
+    playlistPlay(playlistPos);
+}
+
+void MpvObject::setLoopPlaylist(bool loopPlaylist) {
+    if (loopPlaylist == this->loopPlaylist()) {
+        return;
+    }
+    queuePropertyWrite("loop-playlist", loopPlaylist ? QString::fromUtf8("inf")
+                                                     : QString::fromUtf8("no"));
+}
+
+void MpvObject::setBackwardStepCache(bool backwardStepCache) {
+    if (backwardStepCache == currentBackwardStepCache) {
+        return;
+    }
+    currentBackwardStepCache = backwardStepCache;
+    if (!backwardStepCache) {
+        setPlayBackward(false);
+    }
+    Q_EMIT backwardStepCacheChanged();
+}
+
+void MpvObject::setWarmUpCount(int warmUpCount) {
+    warmUpCount = qMax(warmUpCount, 0);
+    if (warmUpCount == currentWarmUpCount) {
+        return;
+    }
+    currentWarmUpCount = warmUpCount;
+    warmUpcomingEntries();
+    Q_EMIT warmUpCountChanged();
+}
+
+void MpvObject::setDisplaySync(bool displaySync) {
+    if (displaySync == currentDisplaySync) {
+        return;
+    }
+    currentDisplaySync = displaySync;
+    reportSwaps = displaySync;
+    applyDisplaySync();
+    Q_EMIT displaySyncChanged();
+}
+
+void MpvObject::setStallThreshold(int stallThreshold) {
+    stallThreshold = qMax(stallThreshold, 1);
+    if (stallThreshold == currentStallThreshold) {
+        return;
+    }
+    currentStallThreshold = stallThreshold;
+    Q_EMIT stallThresholdChanged();
+}
+
+void MpvObject::setAutoAsync(bool autoAsync) {
+    if (autoAsync == currentAutoAsync) {
+        return;
+    }
+    currentAutoAsync = autoAsync;
+    if (!autoAsync) {
+        asyncPropertyValues.clear();
+    }
+    Q_EMIT autoAsyncChanged();
+}
+
+void MpvObject::setStandbyCapacity(int standbyCapacity) {
+    standbyCapacity = qMax(standbyCapacity, 0);
+    if (standbyCapacity == this->standbyCapacity()) {
+        return;
+    }
+    currentStandbyCapacity = standbyCapacity;
+    const int count = standbyPlayers.count();
+    trimStandbyPlayers();
+    Q_EMIT standbyCapacityChanged();
+    if (count != standbyPlayers.count()) {
+        Q_EMIT standbySourcesChanged();
+    }
+}
+
+void MpvObject::setDemuxerCacheLimits(qint64 maxBytes, qint64 maxBackBytes) {
+    // Byte size options are parsed from strings, this also accepts values
+    // that don't fit into an int.
+    const QString maxBytesString = QString::number(qMax(maxBytes, qint64(0)));
+    const QString maxBackBytesString =
+        QString::number(qMax(maxBackBytes, qint64(0)));
+    requestedDemuxerMaxBytes = maxBytes;
+    requestedDemuxerMaxBackBytes = maxBackBytes;
+    // The first limits are set from the constructor, before
+    // mpv_initialize(), where options are set synchronously.
+    if ((currentDemuxerMaxBytes < 0) || (currentDemuxerMaxBackBytes < 0)) {
+        const int result1 =
+            mpv::qt::set_property(mpv, "demuxer-max-bytes", maxBytesString);
+        const int result2 = mpv::qt::set_property(
+            mpv, "demuxer-max-back-bytes", maxBackBytesString);
+        if ((result1 < 0) || (result2 < 0)) {
+            qWarning().noquote() << "Failed to set the demuxer cache limits.";
+            return;
+        }
+        applyDemuxerCacheLimits();
+        return;
+    }
+    // Rebalancing touches every player, it must not wait for each of them.
+    const auto setLimit = [this](const char *name, const QString &value) {
+        const int errorCode =
+            mpv::qt::set_property_async(mpv, name, value, demuxerLimitTag);
+        countAsyncRequest(errorCode);
+        if (errorCode < 0) {
+            qWarning().noquote() << "Failed to set a property for mpv:" << name;
+            demuxerLimitFailed = true;
+            return;
+        }
+        ++demuxerLimitReplies;
+    };
+    setLimit("demuxer-max-bytes", maxBytesString);
+    setLimit("demuxer-max-back-bytes", maxBackBytesString);
+    if (demuxerLimitReplies == 0) {
+        demuxerLimitFailed = false;
+    }
+}
+
+void MpvObject::confirmDemuxerCacheLimits(int errorCode) {
+    metrics.finishAsyncRequest();
+    if (errorCode < 0) {
+        qWarning().noquote() << "Failed to set the demuxer cache limits:"
+                             << mpv_error_string(errorCode);
+        demuxerLimitFailed = true;
+    }
+    // Replies arrive in order, the last one belongs to the latest request.
+    if (--demuxerLimitReplies > 0) {
+        return;
+    }
+    demuxerLimitReplies = 0;
+    if (!std::exchange(demuxerLimitFailed, false)) {
+        applyDemuxerCacheLimits();
+    }
+}
+
+void MpvObject::applyDemuxerCacheLimits() {
+    currentDemuxerMaxBytes = requestedDemuxerMaxBytes;
+    currentDemuxerMaxBackBytes = requestedDemuxerMaxBackBytes;
+    currentDemuxerCacheLimit =
+        requestedDemuxerMaxBytes + requestedDemuxerMaxBackBytes;
+    Q_EMIT demuxerCacheLimitChanged();
+}
+
+void MpvObject::setStandbyCacheLimit(qint64 maxBytes) {
+    for (auto &&standby : std::as_const(standbyPlayers)) {
+        if (standby->cacheLimit == maxBytes) {
+            continue;
+        }
+        standby->cacheLimit = maxBytes;
+        mpv::qt::set_property_async(standby->mpv, "demuxer-max-bytes",
+                                    QString::number(qMax(maxBytes, qint64(0))),
+                                    0);
+    }
 }
 
 void MpvObject::handleMpvEvents() {
+    const MpvTraceSpan span(MpvTracer::Category::Events, "drain");
+    const qint64 drainStart = steadyClockNanoseconds();
     // Process all events, until the event queue is empty.
     while (mpv != nullptr) {
         mpv_event *event = mpv_wait_event(mpv, 0.005);
@@ -1094,6 +3038,10 @@ void MpvObject::handleMpvEvents() {
         if (event->event_id == MPV_EVENT_NONE) {
             break;
         }
+        metrics.events.fetch_add(1, std::memory_order_relaxed);
+        if (MpvTracer::isEnabled()) {
+            traceMpvEvent(event);
+        }
         bool shouldOutput = true;
         switch (event->event_id) {
         // Happens when the player quits. The player enters a state where it
@@ -1111,36 +3059,111 @@ void MpvObject::handleMpvEvents() {
         // Reply to a mpv_get_property_async() request.
         // See also mpv_event and mpv_event_property.
         case MPV_EVENT_GET_PROPERTY_REPLY:
+            if (event->reply_userdata == asyncPropertyTag) {
+                processAsyncPropertyReply(
+                    static_cast<mpv_event_property *>(event->data));
+            } else if (event->reply_userdata == loadTraceTag) {
+                processLoadTraceReply(
+                    event->error,
+                    static_cast<mpv_event_property *>(event->data));
+            }
             shouldOutput = false;
             break;
         // Reply to a mpv_set_property_async() request.
         // (Unlike MPV_EVENT_GET_PROPERTY, mpv_event_property is not used.)
         case MPV_EVENT_SET_PROPERTY_REPLY:
+            if (event->reply_userdata == asyncRequestTag) {
+                metrics.finishAsyncRequest();
+            } else if (event->reply_userdata == coalescedWriteTag) {
+                confirmPropertyWrite(event->error);
+            } else if (event->reply_userdata == demuxerLimitTag) {
+                confirmDemuxerCacheLimits(event->error);
+            }
             shouldOutput = false;
             break;
         // Reply to a mpv_command_async() or mpv_command_node_async() request.
         // See also mpv_event and mpv_event_command.
         case MPV_EVENT_COMMAND_REPLY:
+            if (event->reply_userdata == asyncRequestTag) {
+                metrics.finishAsyncRequest();
+            } else if (event->reply_userdata == scrubSeekTag) {
+                metrics.finishAsyncRequest();
+                // A failed seek never restarts playback.
+                if ((event->error < 0) && scrubSeekInFlight) {
+                    finishScrubSeek();
+                }
+            }
             shouldOutput = false;
             break;
         // Notification before playback start of a file (before the file is
         // loaded).
         case MPV_EVENT_START_FILE:
+            // Gapless playlist transitions start without a loadfile command
+            // of ours, they are timed from here.
+            if (!loadTrace.active ||
+                loadTrace.timings.contains(QString::fromUtf8("startFile"))) {
+                beginLoadTrace();
+            }
+            markLoadPhase(QString::fromUtf8("startFile"),
+                          steadyClockNanoseconds());
+            awaitingFirstFrame = false;
+            preroll.loaded = false;
+            preroll.frameRendered = false;
+            // Playlist transitions keep "play-dir" as well, the new file is
+            // not opened yet or just starts with a direction switch.
+            setPlayBackward(false);
             setMediaStatus(MediaStatus::Loading);
             break;
         // Notification after playback end (after the file was unloaded).
         // See also mpv_event and mpv_event_end_file.
         case MPV_EVENT_END_FILE:
+            // Also arrives for the previous file after setSource() has
+            // already started tracing the next one.
+            if (loadTrace.timings.contains(QString::fromUtf8("startFile"))) {
+                endLoadTrace();
+            }
+            if (preroll.active &&
+                (static_cast<mpv_event_end_file *>(event->data)->reason ==
+                 MPV_END_FILE_REASON_ERROR)) {
+                endPreroll();
+                Q_EMIT ready(-1);
+            }
             setMediaStatus(MediaStatus::End);
             playbackStateChangeEvent();
             break;
         // Notification when the file has been loaded (headers were read
         // etc.), and decoding starts.
-        case MPV_EVENT_FILE_LOADED:
+        case MPV_EVENT_FILE_LOADED: {
+            preroll.loaded = true;
+            const bool hasVideo = mpvGetProperty("vid").toBool();
+            // Audio only files will never render a frame.
+            if (preroll.active && !hasVideo) {
+                preroll.frameRendered = true;
+            }
+            checkPrerollFinished();
+            if (loadTrace.active) {
+                loadTrace.expectVideo = hasVideo;
+                // Before the phase is marked, the trace must not finish
+                // without them.
+                readLoadTraceDetails();
+                markLoadPhase(QString::fromUtf8("fileLoaded"),
+                              steadyClockNanoseconds());
+            }
+            if (MpvWarmUp::hasPendingChecks()) {
+                // The playlist follows the new entry when it starts, which
+                // is normally well before its file has been opened.
+                const int current = playlistModel->currentIndex();
+                MpvWarmUp::instance()->recordLoad(
+                    (current >= 0) ? MpvPlaylistModel::urlFromFileName(
+                                         playlistModel->entry(current).fileName)
+                                   : currentSource);
+            }
             setMediaStatus(MediaStatus::Loaded);
             Q_EMIT loaded();
             playbackStateChangeEvent();
+            warmUpcomingEntries();
             break;
+        }
         // Idle mode was entered. In this mode, no file is played, and the
         // playback core waits for new commands. (The command line player
         // normally quits instead of entering idle mode, unless --idle was
@@ -1165,12 +3188,17 @@ void MpvObject::handleMpvEvents() {
         // yourself whether the video parameters really changed before doing
         // something expensive.
         case MPV_EVENT_VIDEO_RECONFIG:
+            awaitingFirstFrame = true;
+            markLoadPhase(QString::fromUtf8("videoReconfig"),
+                          steadyClockNanoseconds());
             videoReconfig();
             break;
         // Similar to MPV_EVENT_VIDEO_RECONFIG. This is relatively
         // uninteresting, because there is no such thing as audio output
         // embedding.
         case MPV_EVENT_AUDIO_RECONFIG:
+            markLoadPhase(QString::fromUtf8("firstAudio"),
+                          steadyClockNanoseconds());
             audioReconfig();
             break;
         // Happens when a seek was initiated. Playback stops. Usually it will
@@ -1183,12 +3211,45 @@ void MpvObject::handleMpvEvents() {
         // segment switches. The main purpose is allowing the client to detect
         // when a seek request is finished.
         case MPV_EVENT_PLAYBACK_RESTART:
+            if (loadTrace.active && loadTrace.expectAudio) {
+                // With gapless-audio the audio output is reused across
+                // files without a reconfig, the audio then starts here.
+                // Otherwise AUDIO_RECONFIG has been marked already.
+                markLoadPhase(QString::fromUtf8("firstAudio"),
+                              steadyClockNanoseconds());
+            }
+            markLoadPhase(QString::fromUtf8("playbackRestart"),
+                          steadyClockNanoseconds());
+            if (seekSentTime != 0) {
+                seekFrameStart.store(std::exchange(seekSentTime, 0));
+            }
+            if (scrubSeekInFlight) {
+                finishScrubSeek();
+            }
             break;
         // Event sent due to mpv_observe_property().
         // See also mpv_event and mpv_event_property.
         case MPV_EVENT_PROPERTY_CHANGE:
-            processMpvPropertyChange(
-                static_cast<mpv_event_property *>(event->data));
+            metrics.recordPropertyChange(
+                static_cast<mpv_event_property *>(event->data)->name);
+            if (event->reply_userdata == framePtsObserver) {
+                const auto property =
+                    static_cast<mpv_event_property *>(event->data);
+                framePts.store((property->format == MPV_FORMAT_DOUBLE)
+                                   ? *static_cast<double *>(property->data)
+                                   : 0.0,
+                               std::memory_order_relaxed);
+                framePtsTime = steadyClockNanoseconds();
+            } else if (event->reply_userdata == frameDropObserver) {
+                processFrameDropCount(
+                    static_cast<mpv_event_property *>(event->data));
+            } else if (event->reply_userdata == displaySyncObserver) {
+                processDisplaySyncProperty(
+                    static_cast<mpv_event_property *>(event->data));
+            } else {
+                processMpvPropertyChange(
+                    static_cast<mpv_event_property *>(event->data));
+            }
             shouldOutput = false;
             break;
         // Happens if the internal per-mpv_handle ringbuffer overflows, and at
@@ -1199,6 +3260,9 @@ void MpvObject::handleMpvEvents() {
         // Event delivery will continue normally once this event was returned
         // (this forces the client to empty the queue completely).
         case MPV_EVENT_QUEUE_OVERFLOW:
+            metrics.queueOverflows.fetch_add(1, std::memory_order_relaxed);
+            qWarning().noquote() << "mpv's event queue overflowed, events "
+                                    "have been dropped.";
             break;
         // Triggered if a hook handler was registered with mpv_hook_add(), and
         // the hook is invoked. If you receive this, you must handle it, and
@@ -1210,9 +3274,12 @@ void MpvObject::handleMpvEvents() {
             break;
         }
         if (shouldOutput) {
-            qDebug().noquote()
-                << "[libmpv] Event received from mpv:"
+            qCDebug(lcMpvEvents).noquote()
+                << "Event received from mpv:"
                 << QString::fromUtf8(mpv_event_name(event->event_id));
         }
     }
+    metrics.eventDrainTime.record((steadyClockNanoseconds() - drainStart) /
+                                  1000);
+    metrics.eventDrains.fetch_add(1, std::memory_order_relaxed);
 }
@@ -5,13 +5,32 @@
 #define MPV_ENABLE_DEPRECATED 0
 #endif
 
+#include "mpvframetap.h"
+#include "mpvhistogram.hpp"
+#include "mpvmetrics.h"
+#include "mpvplaylistmodel.h"
 #include "mpvqthelper.hpp"
+#include <QElapsedTimer>
 #include <QHash>
+#include <QImage>
 #include <QQuickFramebufferObject>
+#include <QSet>
+#include <QSharedPointer>
 #include <QUrl>
+#include <atomic>
+#include <functional>
 #include <mpv/client.h>
 #include <mpv/render_gl.h>
 
+// Name of the calling function, used by the stall detector to tell where a
+// blocking mpv call came from.
+#if defined(__GNUC__) || defined(__clang__) ||                                \
+    (defined(_MSC_VER) && (_MSC_VER >= 1926))
+#define MPV_CALLER_NAME __builtin_FUNCTION()
+#else
+#define MPV_CALLER_NAME "unknown"
+#endif
+
 class MpvRenderer;
 
 class MpvObject : public QQuickFramebufferObject {
@@ -102,10 +121,48 @@ class MpvObject : public QQuickFramebufferObject {
                    percentPosChanged)
     Q_PROPERTY(
         qreal estimatedVfFps READ estimatedVfFps NOTIFY estimatedVfFpsChanged)
+    Q_PROPERTY(MpvObject::MemoryPriority memoryPriority READ memoryPriority
+                   WRITE setMemoryPriority NOTIFY memoryPriorityChanged)
+    Q_PROPERTY(qint64 demuxerCacheLimit READ demuxerCacheLimit NOTIFY
+                   demuxerCacheLimitChanged)
+    Q_PROPERTY(qint64 demuxerCacheUsage READ demuxerCacheUsage NOTIFY
+                   demuxerCacheUsageChanged)
+    Q_PROPERTY(MpvPlaylistModel *playlist READ playlist CONSTANT)
+    Q_PROPERTY(int playlistPos READ playlistPos WRITE setPlaylistPos NOTIFY
+                   playlistPosChanged)
+    Q_PROPERTY(int playlistCount READ playlistCount NOTIFY playlistCountChanged)
+    Q_PROPERTY(bool loopPlaylist READ loopPlaylist WRITE setLoopPlaylist NOTIFY
+                   loopPlaylistChanged)
+    Q_PROPERTY(int standbyCapacity READ standbyCapacity WRITE
+                   setStandbyCapacity NOTIFY standbyCapacityChanged)
+    Q_PROPERTY(QList<QUrl> standbySources READ standbySources NOTIFY
+                   standbySourcesChanged)
+    Q_PROPERTY(QVariantMap loadTimings READ loadTimings NOTIFY
+                   loadTimingsChanged)
+    Q_PROPERTY(int stallThreshold READ stallThreshold WRITE setStallThreshold
+                   NOTIFY stallThresholdChanged)
+    Q_PROPERTY(bool autoAsync READ autoAsync WRITE setAutoAsync NOTIFY
+                   autoAsyncChanged)
+    Q_PROPERTY(bool scrubbing READ scrubbing NOTIFY scrubbingChanged)
+    Q_PROPERTY(bool backwardStepCache READ backwardStepCache WRITE
+                   setBackwardStepCache NOTIFY backwardStepCacheChanged)
+    Q_PROPERTY(int warmUpCount READ warmUpCount WRITE setWarmUpCount NOTIFY
+                   warmUpCountChanged)
+    Q_PROPERTY(bool displaySync READ displaySync WRITE setDisplaySync NOTIFY
+                   displaySyncChanged)
+    Q_PROPERTY(qreal vsyncJitter READ vsyncJitter NOTIFY
+                   displaySyncStatisticsChanged)
+    Q_PROPERTY(qint64 mistimedFrameCount READ mistimedFrameCount NOTIFY
+                   displaySyncStatisticsChanged)
+    Q_PROPERTY(qint64 voDelayedFrameCount READ voDelayedFrameCount NOTIFY
+                   displaySyncStatisticsChanged)
 
     QML_ELEMENT
 
     friend class MpvRenderer;
+    friend class MpvMemoryBudget;
+    friend class MpvPlaybackGroup;
+    friend class MpvStatsOverlay;
 
     using SingleTrackInfo = QHash<QString, QVariant>;
 
@@ -132,6 +189,9 @@ public:
     enum class MpvCallType { Synchronous, Asynchronous };
     Q_ENUM(MpvCallType)
 
+    enum class MemoryPriority { Low, Normal, High };
+    Q_ENUM(MemoryPriority)
+
     struct MediaTracks {
         QVector<SingleTrackInfo> videoChannels;
         QVector<SingleTrackInfo> audioTracks;
@@ -147,9 +207,37 @@ public:
     explicit MpvObject(QQuickItem *parent = nullptr);
     ~MpvObject() override;
 
+    // Turn mpv's "track-list" and "chapter-list" into the structures above.
+    // Also used for the files probed by MpvMediaProbe.
+    static MpvObject::MediaTracks parseTrackList(const QVariantList &trackList);
+    static MpvObject::Chapters parseChapterList(
+        const QVariantList &chapterList);
+
     static void on_update(void *ctx);
     Renderer *createRenderer() const override;
 
+    using FrameCallback = std::function<void(const QImage &)>;
+    // Same as the grabFrame(mode) slot, but the result is also handed to
+    // the given callback (on the GUI thread).
+    int grabFrame(const QString &mode, const FrameCallback &callback);
+
+    // Hands the frames this item shows to the given consumer, see
+    // MpvFrameConsumer and MpvFrameTapOptions. The consumer must outlive the
+    // tap. Returns false if it's already attached.
+    bool addFrameTap(MpvFrameConsumer *consumer,
+                     const MpvFrameTapOptions &options = MpvFrameTapOptions());
+    // Blocks until the consumer is no longer called, so consumeFrame() must
+    // not wait for the GUI thread.
+    bool removeFrameTap(MpvFrameConsumer *consumer);
+
+    // How long mpv_render_context_render() took per render pass and how
+    // long each drain of mpv's event queue blocked the GUI thread, in
+    // microseconds. Always recorded, it's only a few atomic increments.
+    const MpvHistogram &renderTimeHistogram() const;
+    const MpvHistogram &eventDrainHistogram() const;
+    // Everything the wrapper counts about itself, see MpvPlayerMetrics.
+    const MpvPlayerMetrics &playerMetrics() const;
+
     // Current media's source in QUrl.
     QUrl source() const;
     // Currently played file, with path stripped. If this is an URL, try to undo
@@ -319,83 +407,17 @@ public:
     MpvObject::AudioDevices audioDeviceList() const;
     // Video format as string.
     QString videoFormat() const;
-    // The call type of mpv client APIs.
+    // The call type of mpv client APIs: commands and property reads. The
+    // property setters are coalesced and always written asynchronously,
+    // see beginUpdate().
     MpvObject::MpvCallType mpvCallType() const;
     // Video, audio and subtitle tracks.
     MpvObject::MediaTracks mediaTracks() const;
-    // File types supported by mpv:
-    // https://github.com/mpv-player/mpv/blob/master/player/external_files.c
-    QStringList videoSuffixes() const {
-        return QStringList{
-            QString::fromUtf8("*.3g2"),   QString::fromUtf8("*.3ga"),
-            QString::fromUtf8("*.3gp"),   QString::fromUtf8("*.3gp2"),
-            QString::fromUtf8("*.3gpp"),  QString::fromUtf8("*.amv"),
-            QString::fromUtf8("*.asf"),   QString::fromUtf8("*.asx"),
-            QString::fromUtf8("*.avf"),   QString::fromUtf8("*.avi"),
-            QString::fromUtf8("*.bdm"),   QString::fromUtf8("*.bdmv"),
-            QString::fromUtf8("*.bik"),   QString::fromUtf8("*.clpi"),
-            QString::fromUtf8("*.cpi"),   QString::fromUtf8("*.dat"),
-            QString::fromUtf8("*.divx"),  QString::fromUtf8("*.drc"),
-            QString::fromUtf8("*.dv"),    QString::fromUtf8("*.dvr-ms"),
-            QString::fromUtf8("*.f4v"),   QString::fromUtf8("*.flv"),
-            QString::fromUtf8("*.gvi"),   QString::fromUtf8("*.gxf"),
-            QString::fromUtf8("*.hdmov"), QString::fromUtf8("*.hlv"),
-            QString::fromUtf8("*.iso"),   QString::fromUtf8("*.letv"),
-            QString::fromUtf8("*.lrv"),   QString::fromUtf8("*.m1v"),
-            QString::fromUtf8("*.m2p"),   QString::fromUtf8("*.m2t"),
-            QString::fromUtf8("*.m2ts"),  QString::fromUtf8("*.m2v"),
-            QString::fromUtf8("*.m3u"),   QString::fromUtf8("*.m3u8"),
-            QString::fromUtf8("*.m4v"),   QString::fromUtf8("*.mkv"),
-            QString::fromUtf8("*.moov"),  QString::fromUtf8("*.mov"),
-            QString::fromUtf8("*.mp2"),   QString::fromUtf8("*.mp2v"),
-            QString::fromUtf8("*.mp4"),   QString::fromUtf8("*.mp4v"),
-            QString::fromUtf8("*.mpe"),   QString::fromUtf8("*.mpeg"),
-            QString::fromUtf8("*.mpeg1"), QString::fromUtf8("*.mpeg2"),
-            QString::fromUtf8("*.mpeg4"), QString::fromUtf8("*.mpg"),
-            QString::fromUtf8("*.mpl"),   QString::fromUtf8("*.mpls"),
-            QString::fromUtf8("*.mpv"),   QString::fromUtf8("*.mpv2"),
-            QString::fromUtf8("*.mqv"),   QString::fromUtf8("*.mts"),
-            QString::fromUtf8("*.mtv"),   QString::fromUtf8("*.mxf"),
-            QString::fromUtf8("*.mxg"),   QString::fromUtf8("*.nsv"),
-            QString::fromUtf8("*.nuv"),   QString::fromUtf8("*.ogm"),
-            QString::fromUtf8("*.ogv"),   QString::fromUtf8("*.ogx"),
-            QString::fromUtf8("*.ps"),    QString::fromUtf8("*.qt"),
-            QString::fromUtf8("*.qtvr"),  QString::fromUtf8("*.ram"),
-            QString::fromUtf8("*.rec"),   QString::fromUtf8("*.rm"),
-            QString::fromUtf8("*.rmj"),   QString::fromUtf8("*.rmm"),
-            QString::fromUtf8("*.rms"),   QString::fromUtf8("*.rmvb"),
-            QString::fromUtf8("*.rmx"),   QString::fromUtf8("*.rp"),
-            QString::fromUtf8("*.rpl"),   QString::fromUtf8("*.rv"),
-            QString::fromUtf8("*.rvx"),   QString::fromUtf8("*.thp"),
-            QString::fromUtf8("*.tod"),   QString::fromUtf8("*.tp"),
-            QString::fromUtf8("*.trp"),   QString::fromUtf8("*.ts"),
-            QString::fromUtf8("*.tts"),   QString::fromUtf8("*.txd"),
-            QString::fromUtf8("*.vcd"),   QString::fromUtf8("*.vdr"),
-            QString::fromUtf8("*.vob"),   QString::fromUtf8("*.vp8"),
-            QString::fromUtf8("*.vro"),   QString::fromUtf8("*.webm"),
-            QString::fromUtf8("*.wm"),    QString::fromUtf8("*.wmv"),
-            QString::fromUtf8("*.wtv"),   QString::fromUtf8("*.xesc"),
-            QString::fromUtf8("*.xspf")};
-    }
-    QStringList audioSuffixes() const {
-        return QStringList{
-            QString::fromUtf8("*.mp3"),  QString::fromUtf8("*.aac"),
-            QString::fromUtf8("*.mka"),  QString::fromUtf8("*.dts"),
-            QString::fromUtf8("*.flac"), QString::fromUtf8("*.ogg"),
-            QString::fromUtf8("*.m4a"),  QString::fromUtf8("*.ac3"),
-            QString::fromUtf8("*.opus"), QString::fromUtf8("*.wav"),
-            QString::fromUtf8("*.wv")};
-    }
-    QStringList subtitleSuffixes() const {
-        return QStringList{
-            QString::fromUtf8("*.utf"),   QString::fromUtf8("*.utf8"),
-            QString::fromUtf8("*.utf-8"), QString::fromUtf8("*.idx"),
-            QString::fromUtf8("*.sub"),   QString::fromUtf8("*.srt"),
-            QString::fromUtf8("*.rt"),    QString::fromUtf8("*.ssa"),
-            QString::fromUtf8("*.ass"),   QString::fromUtf8("*.mks"),
-            QString::fromUtf8("*.vtt"),   QString::fromUtf8("*.sup"),
-            QString::fromUtf8("*.scc"),   QString::fromUtf8("*.smi")};
-    }
+    // "*.suffix" patterns of the file types supported by mpv, see
+    // MpvMediaScanner::classify() for matching file names against them.
+    QStringList videoSuffixes() const;
+    QStringList audioSuffixes() const;
+    QStringList subtitleSuffixes() const;
     // Chapter list
     MpvObject::Chapters chapters() const;
     // Metadata map
@@ -415,6 +437,76 @@ public:
     // enabled, or after precise seeking). Files with imprecise timestamps (such
     // as Matroska) might lead to unstable results.
     qreal estimatedVfFps() const;
+    // How much of the process-wide demuxer cache budget (see
+    // MpvMemoryBudget) this player should get compared to the others. The
+    // player that has the active focus is always treated as High and hidden
+    // players are always treated as less than Low.
+    MpvObject::MemoryPriority memoryPriority() const;
+    // --demuxer-max-bytes + --demuxer-max-back-bytes, as assigned by
+    // MpvMemoryBudget.
+    qint64 demuxerCacheLimit() const;
+    // Bytes currently held by the demuxer cache ("demuxer-cache-state"
+    // total-bytes), as of the last change event; never blocks.
+    qint64 demuxerCacheUsage() const;
+    // mpv's internal playlist. Entries are appended with "loadfile append".
+    // As soon as there's more than one, the next entry is prefetched
+    // (--prefetch-playlist) and played without tearing down the audio
+    // output (--gapless-audio).
+    MpvPlaylistModel *playlist() const;
+    // Current position on playlist. The first entry is on position 0.
+    // Writing to this property may start playback at the new position.
+    int playlistPos() const;
+    // Number of total playlist entries.
+    int playlistCount() const;
+    // Loop the whole playlist: --loop-playlist=<N|inf|force|no>
+    bool loopPlaylist() const;
+    // Maximum number of hidden standby players (see armStandby()). Each one
+    // is a complete mpv instance with its own decoder and cache, so keep
+    // this small.
+    int standbyCapacity() const;
+    // Sources of all armed standby players, the most recently used last.
+    QList<QUrl> standbySources() const;
+    // Timeline of the most recent load, in milliseconds since the loadfile
+    // command was issued (or since mpv started the file, for gapless
+    // playlist transitions): startFile, fileLoaded, videoReconfig,
+    // playbackRestart, firstFrame (first frame actually rendered) and
+    // firstAudio (audio output configured). Phases that never happened are
+    // missing. Also contains codec, container, sourceType, url and whether
+    // the load completed. Every load is aggregated in MpvLoadStatistics.
+    QVariantMap loadTimings() const;
+    // Synchronous mpv calls taking longer than this (in milliseconds) are
+    // logged, counted in stallStatistics() and reported through
+    // stallDetected().
+    int stallThreshold() const;
+    // Operations that stalled the GUI thread autoAsyncLimit times go the
+    // asynchronous way from then on, regardless of mpvCallType: commands
+    // and property writes are queued, property reads return the last known
+    // value and refresh it in the background (the change signal follows if
+    // it differed).
+    bool autoAsync() const;
+    // Between beginScrub() and endScrub().
+    bool scrubbing() const;
+    // Step backwards through mpv's backward playback mode, which decodes
+    // whole keyframe ranges once and keeps the frames, instead of seeking
+    // to the previous frame (and decoding from the previous keyframe) for
+    // every step. Makes repeated stepBack() calls cheap, at the cost of a
+    // short delay and more memory for the first one.
+    bool backwardStepCache() const;
+    // Whenever a file has been loaded, the local files among the next this
+    // many playlist entries are handed to MpvWarmUp, so that their first
+    // seconds are read from memory. Zero (the default) turns it off.
+    int warmUpCount() const;
+    // Time the video to the display instead of the audio
+    // (video-sync=display-resample): every buffer swap of the window is
+    // reported to mpv and its refresh rate is passed on as
+    // display-fps-override, so that mpv can keep a steady frame cadence
+    // (3:2 for 24p on 60 Hz, for example) and resample the audio to match.
+    bool displaySync() const;
+    // mpv's vsync-jitter, mistimed-frame-count and vo-delayed-frame-count,
+    // only meaningful with displaySync.
+    qreal vsyncJitter() const;
+    qint64 mistimedFrameCount() const;
+    qint64 voDelayedFrameCount() const;
 
     void setSource(const QUrl &source);
     void setMute(bool mute);
@@ -448,9 +540,26 @@ public:
     void setScreenshotJpegQuality(int screenshotJpegQuality);
     void setMpvCallType(MpvObject::MpvCallType mpvCallType);
     void setPercentPos(int percentPos);
+    void setMemoryPriority(MpvObject::MemoryPriority memoryPriority);
+    void setPlaylistPos(int playlistPos);
+    void setLoopPlaylist(bool loopPlaylist);
+    void setStandbyCapacity(int standbyCapacity);
+    void setStallThreshold(int stallThreshold);
+    void setBackwardStepCache(bool backwardStepCache);
+    void setWarmUpCount(int warmUpCount);
+    void setDisplaySync(bool displaySync);
+    void setAutoAsync(bool autoAsync);
 
 public Q_SLOTS:
     bool open(const QUrl &url);
+    // Same as open(url), with the following options:
+    // startPaused (bool): load the file but don't start playback.
+    // prerollSeconds (real): read at least this many seconds into the
+    // demuxer cache before reporting the file as ready.
+    // ready() is emitted once the file is loaded, its first frame has been
+    // rendered and the requested amount of data is cached, so that play()
+    // starts within one frame.
+    bool open(const QUrl &url, const QVariantMap &options);
     bool play();
     bool play(const QUrl &url);
     bool pause();
@@ -467,25 +576,164 @@ public Q_SLOTS:
     // relative percent, I will not implement it in a short period of time
     // because I don't think it is useful enough.
     bool seekPercent(int percent);
+    // Interactive seeking, for dragging a seek bar. scrubTo() (position in
+    // seconds) keeps at most one fast keyframe seek in flight: targets that
+    // arrive in the meantime replace each other and only the latest one is
+    // sent once the picture has caught up. endScrub() finishes with one
+    // exact seek to the last target. The time from sending a seek to its
+    // first rendered frame goes into seekLatency of metricsSnapshot().
+    bool beginScrub();
+    bool scrubTo(qreal position);
+    bool endScrub();
+    // Pause and show the next (or previous) frames. Stepping a single frame
+    // is what mpv's frame-step and frame-back-step do, more frames are an
+    // exact relative seek.
+    bool stepFrames(int frames = 1);
+    bool stepBack(int frames = 1);
     bool screenshot();
     // According to mpv's manual, the file path must contain an extension
     // name, otherwise the behavior is arbitrary.
     bool screenshotToFile(const QString &filePath);
+    // Grab the current frame into memory ("screenshot-raw"), without
+    // encoding an image file. mode is "video", "subtitles" or "window". The
+    // grab runs on a worker thread and the result arrives through
+    // frameGrabbed() with the returned request id, -1 means nothing has
+    // been requested. The image shares mpv's buffer instead of copying it.
+    int grabFrame(const QString &mode = QString::fromUtf8("video"));
+    // Export stills of the current source in the background, see
+    // MpvFrameCapture. Unless overridden by the options, the files follow
+    // this player's screenshot format, quality, template and directory.
+    // Progress is reported through frameCaptured() and captureFinished().
+    int captureInterval(qreal interval,
+                        const QVariantMap &options = QVariantMap());
+    int captureBurst(qreal position, int framesBefore, int framesAfter,
+                     const QVariantMap &options = QVariantMap());
+    int captureSceneChanges(qreal threshold = 0.3,
+                            const QVariantMap &options = QVariantMap());
+    void cancelCapture(int captureId);
+    // Append the given media to the end of the playlist. If nothing is
+    // being played at the moment, playback starts with it.
+    bool playlistAppend(const QUrl &url);
+    bool playlistAppendList(const QList<QUrl> &urls);
+    // Remove the entry at the given index. If it's the current entry,
+    // playback continues with the next one.
+    bool playlistRemove(int index);
+    // Move the entry at index "from" so that it takes the place of the entry
+    // at index "to".
+    bool playlistMove(int from, int to);
+    // Remove every entry except the currently playing one.
+    bool playlistClear();
+    bool playlistNext();
+    bool playlistPrev();
+    bool playlistPlay(int index);
+    // Open the given media paused on a hidden standby player, so that its
+    // first frame is decoded and its cache is filled before it's needed.
+    // Only possible once initFinished() has been emitted. If there are more
+    // than standbyCapacity standby players, the least recently used one is
+    // dropped.
+    bool armStandby(const QUrl &url);
+    bool disarmStandby(const QUrl &url);
+    bool isStandbyReady(const QUrl &url) const;
+    // Swap the standby player of the given media into this item. The output
+    // switches on the next frame, the previously shown media becomes a
+    // standby player itself (so switching back is just as fast).
+    bool activateStandby(const QUrl &url);
+    // Url of a seek preview of the current source at the given position
+    // (in seconds), to be used as the source of a QML Image.
+    QUrl thumbnailSource(qreal position) const;
+    // The wrapper's own counters for this player, see MpvPlayerMetrics and
+    // MpvMetrics::snapshot() for all players together.
+    QVariantMap metricsSnapshot() const;
+    // Every operation that stalled at least once, the worst (most time
+    // blocked in total) first: operation ("get:<property>",
+    // "set:<property>" or "command:<name>"), caller, calls (slow ones
+    // only), totalTime and maxTime (milliseconds) and whether it has been
+    // switched to the asynchronous path.
+    QVariantList stallStatistics() const;
+    void resetStallStatistics();
+    // Property writes (through the property setters or setProperties())
+    // between these two are collected and sent to mpv once the outermost
+    // commitUpdate() is reached; only the last value of each property is
+    // sent. Setters called outside of a transaction are coalesced the same
+    // way until the end of the current event loop iteration. The getters
+    // return the written values right away.
+    // Commands (seek(), play(), open() and the like) are not part of the
+    // transaction: they are sent right away, and the writes collected up to
+    // then are sent before them so that the order is kept. Writes made
+    // after the command wait for commitUpdate() again.
+    void beginUpdate();
+    void commitUpdate();
+    // Sets all of them within one transaction, the keys are mpv property
+    // names.
+    bool setProperties(const QVariantMap &properties);
 
 protected Q_SLOTS:
     void handleMpvEvents();
 
 private Q_SLOTS:
     void doUpdate();
+    void handleStandbyEvents();
+    void loadStandbySources();
+    void finishStandbyActivation();
+    // Called by the renderer when the first frame after a (re)configuration
+    // of the video output has been rendered. renderTime is a
+    // steady_clock timestamp, in nanoseconds.
+    void firstFrameRendered(qint64 renderTime);
 
 private:
-    bool mpvSendCommand(const QVariant &arguments);
-    bool mpvSetProperty(const char *name, const QVariant &value);
-    QVariant mpvGetProperty(const char *name, bool *ok = nullptr) const;
-    bool mpvObserveProperty(const char *name);
+    bool mpvSendCommand(const QVariant &arguments,
+                        const char *caller = MPV_CALLER_NAME);
+    // Always asynchronous, regardless of mpvCallType. Meant for bulk
+    // operations that must never block the GUI thread.
+    bool mpvSendCommandAsync(const QVariant &arguments);
+    void countAsyncRequest(int errorCode);
+    // Within a transaction the write is only queued: true then means it has
+    // been accepted, not that mpv has applied it. Failures of queued writes
+    // are only logged (see confirmPropertyWrite()).
+    bool mpvSetProperty(const char *name, const QVariant &value,
+                        const char *caller = MPV_CALLER_NAME);
+    // Coalesced writes, see beginUpdate(). mpvSetProperty() outside of a
+    // transaction and the commands send the queued writes first, so they
+    // keep their order.
+    bool queuePropertyWrite(const char *name, const QVariant &value);
+    void flushPropertyWrites();
+    void confirmPropertyWrite(int errorCode);
+    // The value written last that mpv may not have applied yet, invalid if
+    // there is none.
+    QVariant pendingWriteValue(const char *name) const;
+    QVariant mpvGetProperty(const char *name, bool *ok = nullptr,
+                            const char *caller = MPV_CALLER_NAME) const;
+    // Stall detector, see stallThreshold.
+    void recordBlockingCall(const QByteArray &operation, const char *caller,
+                            qint64 duration) const;
+    bool isAsyncOperation(const QByteArray &operation) const;
+    void processAsyncPropertyReply(mpv_event_property *event);
+    bool mpvObserveProperty(const char *name,
+                            mpv_format format = MPV_FORMAT_NONE);
 
     void processMpvLogMessage(mpv_event_log_message *event);
+    void processFrameDropCount(mpv_event_property *property);
+    // The frame drop counters are only observed on the visible handle, and
+    // only while MpvTracer is recording.
+    void updateFrameDropObservation();
+    void processDisplaySyncProperty(mpv_event_property *property);
+    // Sends video-sync and display-fps-override according to displaySync.
+    void applyDisplaySync();
+    // Follows the window (and its screen) the item is shown on, for the
+    // refresh rate.
+    void trackDisplay(QQuickWindow *window);
+    bool sendScrubSeek(qreal position, bool exact);
+    void finishScrubSeek();
+    bool step(int frames, bool backward);
+    // Switches "play-dir" if needed, see backwardStepCache.
+    bool setPlayBackward(bool backward);
+    void warmUpcomingEntries();
+    void traceMpvEvent(mpv_event *event);
     void processMpvPropertyChange(mpv_event_property *event);
+    void processMpvPlaylistChange(const QVariantList &playlist);
+    // Enables prefetch-playlist and gapless-audio while there's more than
+    // one playlist entry.
+    void updateGaplessPlayback();
 
     bool isLoaded() const;
     bool isPlaying() const;
@@ -503,6 +751,55 @@ private:
 
     void playbackStateChangeEvent();
 
+    // Options and property observers every mpv handle of this item needs,
+    // the visible one as well as the standby ones.
+    void applyHandleDefaults(mpv_handle *handle);
+
+    struct StandbyPlayer {
+        mpv::qt::Handle mpv;
+        mpv_render_context *mpv_gl = nullptr;
+        QUrl source;
+        QElapsedTimer prepareTimer;
+        bool loadPending = true;
+        bool loaded = false;
+        bool ready = false;
+        // demuxer-max-bytes as last set by setStandbyCacheLimit().
+        qint64 cacheLimit = 0;
+    };
+    using StandbyPlayerPtr = QSharedPointer<StandbyPlayer>;
+
+    StandbyPlayerPtr findStandby(const QUrl &url) const;
+    void retireStandby(const StandbyPlayerPtr &standby);
+    void trimStandbyPlayers();
+
+    void checkPrerollFinished();
+    // Gives demuxer-readahead-secs back its previous value.
+    void endPreroll();
+
+    // The given capture options completed with the screenshot settings.
+    QVariantMap captureOptions(const QVariantMap &options) const;
+    int trackCapture(int captureId);
+
+    // Load phase tracing, see loadTimings().
+    void beginLoadTrace();
+    void markLoadPhase(const QString &phase, qint64 timestamp);
+    // Reads the container, codec, path and audio track asynchronously.
+    void readLoadTraceDetails();
+    void processLoadTraceReply(int errorCode, mpv_event_property *event);
+    void checkLoadTraceFinished();
+    // Records whatever has been collected so far, if anything.
+    void endLoadTrace();
+    void finishLoadTrace();
+    // Sets url and sourceType of the load timings.
+    void setLoadTraceSource(const QUrl &url);
+
+    // Only MpvMemoryBudget is supposed to call these.
+    void setDemuxerCacheLimits(qint64 maxBytes, qint64 maxBackBytes);
+    void setStandbyCacheLimit(qint64 maxBytes);
+    void confirmDemuxerCacheLimits(int errorCode);
+    // The requested limits become the current ones.
+    void applyDemuxerCacheLimits();
+
 private:
     mpv::qt::Handle mpv;
     mpv_render_context *mpv_gl = nullptr;
@@ -511,8 +808,139 @@ private:
     MpvObject::MediaStatus currentMediaStatus = MpvObject::MediaStatus::NoMedia;
     MpvObject::MpvCallType currentMpvCallType =
         MpvObject::MpvCallType::Synchronous;
+    MpvObject::MemoryPriority currentMemoryPriority =
+        MpvObject::MemoryPriority::Normal;
+    qint64 currentDemuxerCacheLimit = 0;
+    MpvPlaylistModel *playlistModel = nullptr;
+    // See updateGaplessPlayback().
+    bool gaplessPlayback = false;
+    // Confirmed by mpv, and the latest ones sent to it.
+    qint64 currentDemuxerMaxBytes = -1;
+    qint64 currentDemuxerMaxBackBytes = -1;
+    qint64 requestedDemuxerMaxBytes = -1;
+    qint64 requestedDemuxerMaxBackBytes = -1;
+    int demuxerLimitReplies = 0;
+    bool demuxerLimitFailed = false;
+
+    // Render contexts of standby players are created and destroyed by the
+    // renderer, and the swap itself happens in MpvRenderer::synchronize()
+    // while the GUI thread is blocked.
+    QVector<StandbyPlayerPtr> standbyPlayers;
+    QVector<StandbyPlayerPtr> retiredStandbyPlayers;
+    StandbyPlayerPtr pendingStandbyActivation;
+    StandbyPlayerPtr activatedStandby;
+    bool resumeAfterStandbyActivation = false;
+    int currentStandbyCapacity = 2;
+
+    struct PrerollState {
+        bool active = false;
+        qreal seconds = 0.0;
+        bool loaded = false;
+        bool frameRendered = false;
+        QElapsedTimer timer;
+        // Of demuxer-readahead-secs, negative if it hasn't been raised.
+        qreal previousReadahead = -1.0;
+    };
+    PrerollState preroll;
+    // Cached from the observed properties of the same name.
+    qreal demuxerCacheDuration = 0.0;
+    bool demuxerCacheIdle = false;
+    // "total-bytes" of the observed "demuxer-cache-state", polled by
+    // MpvMemoryBudget.
+    qint64 demuxerCacheBytes = 0;
+    // Set on the GUI thread, consumed by the renderer.
+    std::atomic_bool awaitingFirstFrame{false};
+
+    struct LoadTrace {
+        bool active = false;
+        // steady_clock, in nanoseconds.
+        qint64 startTime = 0;
+        bool expectVideo = false;
+        bool expectAudio = false;
+        // Details requested on FILE_LOADED that haven't arrived yet.
+        int detailReads = 0;
+        QVariantMap timings;
+    };
+    LoadTrace loadTrace;
+    // Detail replies still due for traces that have ended.
+    int staleLoadTraceReads = 0;
+    QVariantMap lastLoadTimings;
+    int grabFrameSerial = 0;
+    // Captures started through this player, their signals are forwarded.
+    QSet<int> captureIds;
+    // Copied by the renderer in synchronize().
+    QVector<MpvFrameTapPtr> frameTaps;
+    // Playback position of the current frame, for the frame taps. Kept up
+    // to date by a typed observation of "time-pos".
+    std::atomic<double> framePts{0.0};
+    // When the last "time-pos" change arrived, a steady_clock timestamp in
+    // nanoseconds. Only touched on the GUI thread, see MpvPlaybackGroup.
+    qint64 framePtsTime = 0;
+    // Last values of "frame-drop-count" and "decoder-frame-drop-count", a
+    // rise of either one triggers MpvTracer.
+    qint64 droppedFrames = 0;
+    qint64 decoderDroppedFrames = 0;
+    bool observingFrameDrops = false;
+    // Mutable because the synchronous getters are counted as well.
+    mutable MpvPlayerMetrics metrics;
+
+    // The stall detector only ever touches these on the GUI thread.
+    struct StallStatistics {
+        QByteArray caller;
+        quint64 calls = 0;
+        // In nanoseconds.
+        qint64 totalTime = 0;
+        qint64 maxTime = 0;
+        bool asynchronous = false;
+    };
+    mutable QHash<QByteArray, StallStatistics> stallStatisticsTable;
+    int currentStallThreshold = 10;
+    bool currentAutoAsync = false;
+    static constexpr quint64 autoAsyncLimit = 3;
+    // Values of the properties read asynchronously, and the reads in
+    // flight.
+    mutable QHash<QByteArray, QVariant> asyncPropertyValues;
+    mutable QSet<QByteArray> asyncPropertyReads;
+
+    // Writes waiting to be sent, in the order of their first write, and
+    // the values sent but not yet confirmed by mpv.
+    QVector<QByteArray> pendingWriteOrder;
+    QHash<QByteArray, QVariant> pendingWrites;
+    QHash<QByteArray, QVariant> unconfirmedWrites;
+    int unconfirmedWriteCount = 0;
+    int updateDepth = 0;
+    bool writeFlushScheduled = false;
+
+    // Scrubbing, see beginScrub().
+    bool currentScrubbing = false;
+    bool scrubSeekInFlight = false;
+    bool scrubTargetPending = false;
+    bool scrubMoved = false;
+    qreal scrubTarget = 0.0;
+    QElapsedTimer scrubSeekTimer;
+    // When the last seek was sent (steady_clock, in nanoseconds). Handed to
+    // the renderer once mpv has restarted playback, which records the
+    // latency with the next new frame.
+    qint64 seekSentTime = 0;
+    std::atomic<qint64> seekFrameStart{0};
+
+    bool currentBackwardStepCache = true;
+    // Whether "play-dir" of the visible handle has been switched to backward
+    // by stepBack(). Every new file and every standby swap starts forward.
+    bool playingBackward = false;
+    int currentWarmUpCount = 0;
+    bool currentDisplaySync = false;
+    // Read by the renderer on every buffer swap.
+    std::atomic_bool reportSwaps{false};
+    qreal currentVsyncJitter = 0.0;
+    qint64 currentMistimedFrameCount = 0;
+    qint64 currentVoDelayedFrameCount = 0;
+    QMetaObject::Connection screenConnection;
+    QMetaObject::Connection refreshRateConnection;
 
-    const QHash<const char *, const char *> properties = {
+    // Observed properties and the signals their changes are reported with,
+    // looked up by name on every property change event.
+    const QHash<QByteArray, const char *> properties = {
         {"dwidth", "videoSizeChanged"},
         {"dheight", "videoSizeChanged"},
         {"duration", "durationChanged"},
@@ -560,18 +988,23 @@ private:
         {"metadata", "metadataChanged"},
         {"avsync", "avsyncChanged"},
         {"percent-pos", "percentPosChanged"},
-        {"estimated-vf-fps", "estimatedVfFpsChanged"}};
+        {"estimated-vf-fps", "estimatedVfFpsChanged"},
+        {"playlist-pos", "playlistPosChanged"},
+        {"playlist-count", "playlistCountChanged"},
+        {"loop-playlist", "loopPlaylistChanged"}};
 
     // These properties are changing all the time during the playback process.
     // So we have to add them to the black list, otherwise we'll get huge
     // message floods.
     const QVector<const char *> propertyBlackList = {
         "time-pos",      "playback-time",    "percent-pos", "video-bitrate",
-        "audio-bitrate", "estimated-vf-fps", "avsync"};
+        "audio-bitrate", "estimated-vf-fps", "avsync",
+        "demuxer-cache-state", "demuxer-cache-duration", "demuxer-cache-idle"};
 
 Q_SIGNALS:
     void onUpdate();
     void hasMpvEvents();
+    void hasStandbyEvents();
     void initFinished();
 
     void loaded();
@@ -629,6 +1062,42 @@ Q_SIGNALS:
     void avsyncChanged();
     void percentPosChanged();
     void estimatedVfFpsChanged();
+    void memoryPriorityChanged();
+    void demuxerCacheLimitChanged();
+    void demuxerCacheUsageChanged();
+    void playlistPosChanged();
+    void playlistCountChanged();
+    void loopPlaylistChanged();
+    void standbyCapacityChanged();
+    void standbySourcesChanged();
+    // The first frame of the standby player is decoded. prepareTime is the
+    // time from armStandby() to this point, in milliseconds.
+    void standbyReady(const QUrl &url, qint64 prepareTime);
+    void standbyFailed(const QUrl &url);
+    void standbyActivated(const QUrl &url);
+    // See open(url, options). prepareTime is the time it took since open()
+    // was called, in milliseconds, or -1 if the file couldn't be loaded.
+    void ready(qint64 prepareTime);
+    void loadTimingsChanged();
+    void stallThresholdChanged();
+    void autoAsyncChanged();
+    void scrubbingChanged();
+    void backwardStepCacheChanged();
+    void warmUpCountChanged();
+    void displaySyncChanged();
+    void displaySyncStatisticsChanged();
+    // A synchronous mpv call blocked the GUI thread for longer than
+    // stallThreshold. Emitted from the event loop, not from the call.
+    void stallDetected(const QString &operation, const QString &caller,
+                       qreal duration);
+    // mpv logged a fatal error, playback is most likely broken. Nothing
+    // else happens, the application decides what to do about it.
+    void mpvError(const QString &message);
+    // The image is null if grabbing failed.
+    void frameGrabbed(int requestId, const QImage &image);
+    void frameCaptured(int captureId, const QString &filePath,
+                       qreal position);
+    void captureFinished(int captureId, int frameCount, bool success);
 };
 
 Q_DECLARE_METATYPE(MpvObject::MediaTracks)
@@ -0,0 +1,365 @@
+#include "mpvplaybackgroup.h"
+
+namespace {
+
+// How often the drift is checked. Players that haven't presented a new
+// frame since the last check are skipped.
+constexpr int correctionInterval = 50;
+// Seeks and restarts take a moment to settle, measuring during that time
+// would only trigger more seeks.
+constexpr qint64 settleDuration = 500 * 1000 * 1000;
+// The master is extrapolated by at most this many seconds, in case it
+// stalls.
+constexpr qreal maximumExtrapolation = 0.5;
+// A drift is corrected within about this many seconds.
+constexpr qreal correctionWindow = 1.0;
+// Weight of a new measurement, the rest is the previous ones. Smooths out
+// the jitter of the event loop.
+constexpr qreal smoothingFactor = 0.3;
+// Smaller speed changes aren't sent to mpv at all.
+constexpr qreal minimumSpeedStep = 0.0005;
+
+} // namespace
+
+MpvPlaybackGroup::MpvPlaybackGroup(QObject *parent) : QObject(parent) {
+    timer.setInterval(correctionInterval);
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &MpvPlaybackGroup::correctDrift);
+}
+
+MpvPlaybackGroup::~MpvPlaybackGroup() {
+    // Leave the players at the group's speed, without the correction.
+    while (!members.isEmpty()) {
+        removeMember(members.count() - 1);
+    }
+}
+
+MpvObject *MpvPlaybackGroup::master() const { return currentMaster; }
+
+int MpvPlaybackGroup::count() const { return members.count(); }
+
+bool MpvPlaybackGroup::playing() const { return currentPlaying; }
+
+qreal MpvPlaybackGroup::speed() const { return currentSpeed; }
+
+qreal MpvPlaybackGroup::tolerance() const { return currentTolerance; }
+
+qreal MpvPlaybackGroup::maximumCorrection() const {
+    return currentMaximumCorrection;
+}
+
+qreal MpvPlaybackGroup::seekThreshold() const { return currentSeekThreshold; }
+
+void MpvPlaybackGroup::setMaster(MpvObject *master) {
+    if (master == currentMaster) {
+        return;
+    }
+    if (master != nullptr) {
+        // Does nothing if it's a member already.
+        addPlayer(master);
+    }
+    const qint64 now = steadyClockNanoseconds();
+    restartClock(referencePosition(now), now);
+    currentMaster = master;
+    hasMaster = (master != nullptr);
+    // The master itself is never corrected.
+    for (auto &&member : std::as_const(members)) {
+        if (isMaster(member) && (member->appliedSpeed != currentSpeed)) {
+            member->appliedSpeed = currentSpeed;
+            member->player->queuePropertyWrite("speed", currentSpeed);
+        }
+    }
+    settle(now);
+    Q_EMIT masterChanged();
+}
+
+void MpvPlaybackGroup::setSpeed(qreal speed) {
+    speed = qBound(0.01, speed, 100.0);
+    if (qFuzzyCompare(speed, currentSpeed)) {
+        return;
+    }
+    const qint64 now = steadyClockNanoseconds();
+    restartClock(referencePosition(now), now);
+    currentSpeed = speed;
+    for (auto &&member : std::as_const(members)) {
+        if (!member->player.isNull()) {
+            member->appliedSpeed = currentSpeed;
+            member->player->queuePropertyWrite("speed", currentSpeed);
+        }
+    }
+    for (auto &&member : std::as_const(members)) {
+        if (!member->player.isNull()) {
+            member->player->flushPropertyWrites();
+        }
+    }
+    settle(now);
+    Q_EMIT speedChanged();
+}
+
+void MpvPlaybackGroup::setTolerance(qreal tolerance) {
+    tolerance = qMax(tolerance, 0.0);
+    if (qFuzzyCompare(tolerance, currentTolerance)) {
+        return;
+    }
+    currentTolerance = tolerance;
+    Q_EMIT toleranceChanged();
+}
+
+void MpvPlaybackGroup::setMaximumCorrection(qreal maximumCorrection) {
+    maximumCorrection = qBound(0.0, maximumCorrection, 0.5);
+    if (qFuzzyCompare(maximumCorrection, currentMaximumCorrection)) {
+        return;
+    }
+    currentMaximumCorrection = maximumCorrection;
+    Q_EMIT maximumCorrectionChanged();
+}
+
+void MpvPlaybackGroup::setSeekThreshold(qreal seekThreshold) {
+    seekThreshold = qMax(seekThreshold, 0.0);
+    if (qFuzzyCompare(seekThreshold, currentSeekThreshold)) {
+        return;
+    }
+    currentSeekThreshold = seekThreshold;
+    Q_EMIT seekThresholdChanged();
+}
+
+bool MpvPlaybackGroup::addPlayer(MpvObject *player) {
+    if (player == nullptr) {
+        return false;
+    }
+    for (auto &&member : std::as_const(members)) {
+        if (member->player == player) {
+            return false;
+        }
+    }
+    auto member = MemberPtr::create();
+    member->player = player;
+    member->appliedSpeed = currentSpeed;
+    member->settleTime = steadyClockNanoseconds() + settleDuration;
+    members.append(member);
+    player->queuePropertyWrite("speed", currentSpeed);
+    connect(player, &QObject::destroyed, this,
+            &MpvPlaybackGroup::removeDestroyedPlayers);
+    Q_EMIT countChanged();
+    return true;
+}
+
+bool MpvPlaybackGroup::removePlayer(MpvObject *player) {
+    for (int i = 0; i != members.count(); ++i) {
+        if (members.at(i)->player == player) {
+            removeMember(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MpvPlaybackGroup::play() {
+    if (members.isEmpty()) {
+        return false;
+    }
+    const qint64 now = steadyClockNanoseconds();
+    restartClock(referencePosition(now), now);
+    setPaused(false);
+    settle(now);
+    timer.start();
+    if (!currentPlaying) {
+        currentPlaying = true;
+        Q_EMIT playingChanged();
+    }
+    return true;
+}
+
+bool MpvPlaybackGroup::pause() {
+    if (members.isEmpty()) {
+        return false;
+    }
+    const qint64 now = steadyClockNanoseconds();
+    restartClock(referencePosition(now), now);
+    setPaused(true);
+    timer.stop();
+    if (currentPlaying) {
+        currentPlaying = false;
+        Q_EMIT playingChanged();
+    }
+    return true;
+}
+
+bool MpvPlaybackGroup::seek(qreal position) {
+    if (members.isEmpty()) {
+        return false;
+    }
+    position = qMax(position, 0.0);
+    for (auto &&member : std::as_const(members)) {
+        if (!member->player.isNull() && !member->player->isStopped()) {
+            member->player->mpvSendCommandAsync(QVariantList{
+                QString::fromUtf8("seek"), position,
+                QString::fromUtf8("absolute+exact")});
+        }
+    }
+    const qint64 now = steadyClockNanoseconds();
+    restartClock(position, now);
+    settle(now);
+    return true;
+}
+
+qreal MpvPlaybackGroup::clockPosition() const {
+    return referencePosition(steadyClockNanoseconds());
+}
+
+QVariantList MpvPlaybackGroup::driftStatistics() const {
+    QVariantList statistics;
+    for (auto &&member : std::as_const(members)) {
+        if (member->player.isNull()) {
+            continue;
+        }
+        QVariantMap map;
+        map[QString::fromUtf8("player")] =
+            QVariant::fromValue(static_cast<QObject *>(member->player));
+        map[QString::fromUtf8("master")] = isMaster(member);
+        map[QString::fromUtf8("drift")] = member->drift;
+        map[QString::fromUtf8("speed")] = member->appliedSpeed;
+        map[QString::fromUtf8("speedCorrections")] = member->speedCorrections;
+        map[QString::fromUtf8("seeks")] = member->seeks;
+        map[QString::fromUtf8("absoluteDrift")] =
+            member->absoluteDrift.toVariantMap();
+        statistics.append(map);
+    }
+    return statistics;
+}
+
+void MpvPlaybackGroup::resetStatistics() {
+    for (auto &&member : std::as_const(members)) {
+        member->speedCorrections = 0;
+        member->seeks = 0;
+        member->absoluteDrift.reset();
+    }
+}
+
+void MpvPlaybackGroup::correctDrift() {
+    const qint64 now = steadyClockNanoseconds();
+    for (auto &&member : std::as_const(members)) {
+        MpvObject *player = member->player;
+        if ((player == nullptr) || isMaster(member) || player->isStopped() ||
+            (player->framePtsTime == member->sampleTime)) {
+            continue;
+        }
+        // Measured at the time the frame arrived, not now, so the
+        // distance between frames doesn't count as drift.
+        member->sampleTime = player->framePtsTime;
+        if (member->sampleTime < member->settleTime) {
+            continue;
+        }
+        const qreal drift = player->framePts.load(std::memory_order_relaxed) -
+            referencePosition(member->sampleTime);
+        member->drift = drift;
+        member->absoluteDrift.record(qRound64(qAbs(drift) * 1000000.0));
+        qreal targetSpeed = currentSpeed;
+        if (qAbs(drift) > currentSeekThreshold) {
+            player->mpvSendCommandAsync(QVariantList{
+                QString::fromUtf8("seek"), referencePosition(now),
+                QString::fromUtf8("absolute+exact")});
+            ++member->seeks;
+            member->settleTime = now + settleDuration;
+            member->smoothedDrift = 0.0;
+        } else {
+            member->smoothedDrift +=
+                (drift - member->smoothedDrift) * smoothingFactor;
+            if (qAbs(member->smoothedDrift) > currentTolerance) {
+                // Ahead means slower, behind means faster.
+                targetSpeed *= qBound(1.0 - currentMaximumCorrection,
+                                      1.0 - (member->smoothedDrift /
+                                             correctionWindow),
+                                      1.0 + currentMaximumCorrection);
+            }
+        }
+        if (qAbs(targetSpeed - member->appliedSpeed) >= minimumSpeedStep) {
+            member->appliedSpeed = targetSpeed;
+            ++member->speedCorrections;
+            // Coalesced and sent asynchronously at the end of this event
+            // loop iteration.
+            player->queuePropertyWrite("speed", targetSpeed);
+        }
+    }
+    if (!currentMaster.isNull()) {
+        restartClock(referencePosition(now), now);
+    }
+}
+
+qreal MpvPlaybackGroup::referencePosition(qint64 time) const {
+    if (!currentMaster.isNull()) {
+        qreal position =
+            currentMaster->framePts.load(std::memory_order_relaxed);
+        if (currentPlaying && (currentMaster->framePtsTime > 0)) {
+            const qreal elapsed = qBound(
+                -maximumExtrapolation,
+                static_cast<qreal>(time - currentMaster->framePtsTime) / 1e9,
+                maximumExtrapolation);
+            position += elapsed * currentSpeed;
+        }
+        return position;
+    }
+    qreal position = clockStartPosition;
+    if (currentPlaying) {
+        position += static_cast<qreal>(time - clockStartTime) / 1e9 *
+            currentSpeed;
+    }
+    return position;
+}
+
+void MpvPlaybackGroup::restartClock(qreal position, qint64 time) {
+    clockStartPosition = position;
+    clockStartTime = time;
+}
+
+void MpvPlaybackGroup::settle(qint64 time) {
+    for (auto &&member : std::as_const(members)) {
+        member->settleTime = time + settleDuration;
+        member->smoothedDrift = 0.0;
+    }
+}
+
+bool MpvPlaybackGroup::isMaster(const MemberPtr &member) const {
+    return !currentMaster.isNull() && (member->player == currentMaster);
+}
+
+void MpvPlaybackGroup::setPaused(bool paused) {
+    // Queued for all players first, then sent back to back.
+    for (auto &&member : std::as_const(members)) {
+        if (!member->player.isNull()) {
+            member->player->queuePropertyWrite("pause", paused);
+        }
+    }
+    for (auto &&member : std::as_const(members)) {
+        if (!member->player.isNull()) {
+            member->player->flushPropertyWrites();
+        }
+    }
+}
+
+void MpvPlaybackGroup::removeMember(int index) {
+    const MemberPtr member = members.takeAt(index);
+    const bool wasMaster = isMaster(member);
+    if (!member->player.isNull()) {
+        disconnect(member->player, nullptr, this, nullptr);
+        member->player->queuePropertyWrite("speed", currentSpeed);
+    }
+    if (wasMaster) {
+        setMaster(nullptr);
+    }
+    Q_EMIT countChanged();
+}
+
+void MpvPlaybackGroup::removeDestroyedPlayers() {
+    for (int i = members.count() - 1; i >= 0; --i) {
+        if (members.at(i)->player.isNull()) {
+            members.removeAt(i);
+        }
+    }
+    if (hasMaster && currentMaster.isNull()) {
+        // The clock has been following the master, it simply goes on.
+        hasMaster = false;
+        Q_EMIT masterChanged();
+    }
+    Q_EMIT countChanged();
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "mpvhistogram.hpp"
+#include "mpvobject.h"
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QVariant>
+#include <QVector>
+#include <QtQml/qqml.h>
+
+// Keeps several players frame-locked, for multi-angle review and video
+// walls. All of them follow one clock: the master player's "time-pos", or
+// without a master, a monotonic clock of the group itself. The drift of
+// every other player is measured whenever it presents a new frame and
+// corrected by speeding it up or slowing it down a little (which is
+// inaudible with mpv's pitch correction), only drifts beyond seekThreshold
+// are corrected with a seek. The speed properties of the players reflect
+// these corrections.
+// play(), pause(), seek() and setSpeed() are sent to all players in one go,
+// as asynchronous requests, so no player waits for another one to reply.
+class MpvPlaybackGroup : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvPlaybackGroup)
+
+    Q_PROPERTY(MpvObject *master READ master WRITE setMaster NOTIFY
+                   masterChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(bool playing READ playing NOTIFY playingChanged)
+    Q_PROPERTY(qreal speed READ speed WRITE setSpeed NOTIFY speedChanged)
+    Q_PROPERTY(qreal tolerance READ tolerance WRITE setTolerance NOTIFY
+                   toleranceChanged)
+    Q_PROPERTY(qreal maximumCorrection READ maximumCorrection WRITE
+                   setMaximumCorrection NOTIFY maximumCorrectionChanged)
+    Q_PROPERTY(qreal seekThreshold READ seekThreshold WRITE setSeekThreshold
+                   NOTIFY seekThresholdChanged)
+
+    QML_ELEMENT
+
+public:
+    explicit MpvPlaybackGroup(QObject *parent = nullptr);
+    ~MpvPlaybackGroup() override;
+
+    // Null means the group's own clock.
+    MpvObject *master() const;
+    int count() const;
+    bool playing() const;
+    // Of the whole group, the corrections are relative to it.
+    qreal speed() const;
+    // Drifts up to this many seconds are left alone.
+    qreal tolerance() const;
+    // The largest relative speed change used for corrections (0.05 means
+    // between 95% and 105% of speed).
+    qreal maximumCorrection() const;
+    // Drifts beyond this many seconds are corrected with a seek.
+    qreal seekThreshold() const;
+
+    void setMaster(MpvObject *master);
+    void setSpeed(qreal speed);
+    void setTolerance(qreal tolerance);
+    void setMaximumCorrection(qreal maximumCorrection);
+    void setSeekThreshold(qreal seekThreshold);
+
+public Q_SLOTS:
+    // Players join and leave with their current playback state, the next
+    // play(), pause() or seek() brings them in line.
+    bool addPlayer(MpvObject *player);
+    bool removePlayer(MpvObject *player);
+    bool play();
+    bool pause();
+    // Absolute, in seconds.
+    bool seek(qreal position);
+    // Position of the group's clock, in seconds.
+    qreal clockPosition() const;
+    // One map per player: player, master, drift (the last one measured, in
+    // seconds, positive means ahead), speed (including the correction),
+    // speedCorrections, seeks and absoluteDrift (see
+    // MpvHistogram::toVariantMap(), in microseconds).
+    QVariantList driftStatistics() const;
+    void resetStatistics();
+
+private Q_SLOTS:
+    void correctDrift();
+
+private:
+    struct Member {
+        QPointer<MpvObject> player;
+        // MpvObject::framePtsTime of the last measurement.
+        qint64 sampleTime = 0;
+        // No measurements until then, after a seek or play().
+        qint64 settleTime = 0;
+        qreal drift = 0.0;
+        qreal smoothedDrift = 0.0;
+        qreal appliedSpeed = 1.0;
+        quint64 speedCorrections = 0;
+        quint64 seeks = 0;
+        MpvHistogram absoluteDrift;
+    };
+    using MemberPtr = QSharedPointer<Member>;
+
+    // Where the clock is (or was) at the given steady_clock time.
+    qreal referencePosition(qint64 time) const;
+    void restartClock(qreal position, qint64 time);
+    void settle(qint64 time);
+    bool isMaster(const MemberPtr &member) const;
+    void setPaused(bool paused);
+    void removeMember(int index);
+    void removeDestroyedPlayers();
+
+private:
+    QVector<MemberPtr> members;
+    QPointer<MpvObject> currentMaster;
+    // Tells whether the master has been destroyed, the pointer itself is
+    // null by then.
+    bool hasMaster = false;
+    QTimer timer;
+    bool currentPlaying = false;
+    qreal currentSpeed = 1.0;
+    qreal currentTolerance = 0.004;
+    qreal currentMaximumCorrection = 0.05;
+    qreal currentSeekThreshold = 0.25;
+    // The group's own clock: clockStartPosition at clockStartTime, moving
+    // at speed while playing. Follows the master as long as there is one,
+    // so that losing it doesn't make the clock jump.
+    qreal clockStartPosition = 0.0;
+    qint64 clockStartTime = 0;
+
+Q_SIGNALS:
+    void masterChanged();
+    void countChanged();
+    void playingChanged();
+    void speedChanged();
+    void toleranceChanged();
+    void maximumCorrectionChanged();
+    void seekThresholdChanged();
+};
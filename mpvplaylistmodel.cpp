@@ -0,0 +1,185 @@
+#include "mpvplaylistmodel.h"
+
+#include <QDir>
+
+MpvPlaylistModel::MpvPlaylistModel(QObject *parent)
+    : QAbstractListModel(parent) {}
+
+MpvPlaylistModel::~MpvPlaylistModel() = default;
+
+int MpvPlaylistModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : exposedCount;
+}
+
+QVariant MpvPlaylistModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || (index.row() < 0) ||
+        (index.row() >= exposedCount)) {
+        return QVariant();
+    }
+    const Entry &entry = entries.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return entry.title.isEmpty() ? entry.fileName : entry.title;
+    case FileNameRole:
+        return entry.fileName;
+    case UrlRole:
+        return urlFromFileName(entry.fileName);
+    case TitleRole:
+        return entry.title;
+    case CurrentRole:
+        return entry.current;
+    case PlayingRole:
+        return entry.playing;
+    case EntryIdRole:
+        return entry.id;
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> MpvPlaylistModel::roleNames() const {
+    return QHash<int, QByteArray>{{FileNameRole, "fileName"},
+                                  {UrlRole, "url"},
+                                  {TitleRole, "title"},
+                                  {CurrentRole, "current"},
+                                  {PlayingRole, "playing"},
+                                  {EntryIdRole, "entryId"}};
+}
+
+bool MpvPlaylistModel::canFetchMore(const QModelIndex &parent) const {
+    return !parent.isValid() && (exposedCount < entries.count());
+}
+
+void MpvPlaylistModel::fetchMore(const QModelIndex &parent) {
+    if (!canFetchMore(parent)) {
+        return;
+    }
+    const int last = qMin(exposedCount + fetchBatchSize, entries.count()) - 1;
+    beginInsertRows(QModelIndex(), exposedCount, last);
+    exposedCount = last + 1;
+    endInsertRows();
+}
+
+int MpvPlaylistModel::count() const { return entries.count(); }
+
+int MpvPlaylistModel::currentIndex() const { return currentRow; }
+
+void MpvPlaylistModel::update(const QVariantList &playlist) {
+    QVector<Entry> newEntries;
+    newEntries.reserve(playlist.count());
+    int newCurrentRow = -1;
+    for (auto &&item : std::as_const(playlist)) {
+        const auto itemInfo = item.toMap();
+        Entry entry;
+        entry.fileName = itemInfo[QString::fromUtf8("filename")].toString();
+        entry.title = itemInfo[QString::fromUtf8("title")].toString();
+        entry.id = itemInfo.value(QString::fromUtf8("id"), -1).toLongLong();
+        entry.current = itemInfo[QString::fromUtf8("current")].toBool();
+        entry.playing = itemInfo[QString::fromUtf8("playing")].toBool();
+        if (entry.current) {
+            newCurrentRow = newEntries.count();
+        }
+        newEntries.append(entry);
+    }
+
+    const int oldCount = entries.count();
+    const int oldExposed = exposedCount;
+    const int newExposed =
+        qMin(newEntries.count(), qMax(oldExposed, fetchBatchSize));
+
+    // Only the rows the views know about need precise notifications, the
+    // rest is picked up by fetchMore() later on.
+    int prefix = 0;
+    while ((prefix < oldExposed) && (prefix < newExposed) &&
+           isSameItem(entries.at(prefix), newEntries.at(prefix))) {
+        ++prefix;
+    }
+    int suffix = 0;
+    while ((suffix < (oldExposed - prefix)) &&
+           (suffix < (newExposed - prefix)) &&
+           isSameItem(entries.at(oldExposed - suffix - 1),
+                      newEntries.at(newExposed - suffix - 1))) {
+        ++suffix;
+    }
+
+    const int removedLast = oldExposed - suffix - 1;
+    if (removedLast >= prefix) {
+        beginRemoveRows(QModelIndex(), prefix, removedLast);
+        entries.remove(prefix, removedLast - prefix + 1);
+        exposedCount -= removedLast - prefix + 1;
+        endRemoveRows();
+    }
+    // Entries that were never exposed are simply replaced.
+    entries.resize(exposedCount);
+    const int insertedLast = newExposed - suffix - 1;
+    if (insertedLast >= prefix) {
+        beginInsertRows(QModelIndex(), prefix, insertedLast);
+        entries.insert(prefix, insertedLast - prefix + 1, Entry());
+        for (int row = prefix; row <= insertedLast; ++row) {
+            entries[row] = newEntries.at(row);
+        }
+        exposedCount += insertedLast - prefix + 1;
+        endInsertRows();
+    }
+    Q_ASSERT(exposedCount == newExposed);
+
+    // Rows that stayed may still have changed their flags (current, playing)
+    // or their title.
+    int firstChanged = -1;
+    int lastChanged = -1;
+    for (int row = 0; row != exposedCount; ++row) {
+        if (!isSameEntry(entries.at(row), newEntries.at(row))) {
+            entries[row] = newEntries.at(row);
+            if (firstChanged < 0) {
+                firstChanged = row;
+            }
+            lastChanged = row;
+        }
+    }
+    if (firstChanged >= 0) {
+        Q_EMIT dataChanged(index(firstChanged), index(lastChanged));
+    }
+
+    entries = newEntries;
+
+    if (oldCount != entries.count()) {
+        Q_EMIT countChanged();
+    }
+    if (currentRow != newCurrentRow) {
+        currentRow = newCurrentRow;
+        Q_EMIT currentIndexChanged();
+    }
+}
+
+MpvPlaylistModel::Entry MpvPlaylistModel::entry(int index) const {
+    return ((index >= 0) && (index < entries.count())) ? entries.at(index)
+                                                       : Entry();
+}
+
+QUrl MpvPlaylistModel::urlFromFileName(const QString &fileName) {
+    if (fileName.isEmpty()) {
+        return QUrl();
+    }
+    // Local files the visible player reads through a memory mapping, see
+    // MpvStreamSource::mpvPath().
+    if (fileName.startsWith(QString::fromUtf8("mmap://"))) {
+        return QUrl::fromLocalFile(QUrl(fileName).path());
+    }
+    return QUrl::fromUserInput(fileName, QDir::currentPath(),
+                               QUrl::AssumeLocalFile);
+}
+
+bool MpvPlaylistModel::isSameItem(const Entry &lhs, const Entry &rhs) {
+    // Old mpv versions don't have playlist entry ids.
+    if ((lhs.id >= 0) && (rhs.id >= 0)) {
+        return lhs.id == rhs.id;
+    }
+    return lhs.fileName == rhs.fileName;
+}
+
+bool MpvPlaylistModel::isSameEntry(const Entry &lhs, const Entry &rhs) {
+    return isSameItem(lhs, rhs) && (lhs.fileName == rhs.fileName) &&
+        (lhs.title == rhs.title) && (lhs.current == rhs.current) &&
+        (lhs.playing == rhs.playing);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QUrl>
+#include <QVector>
+#include <QtQml/qqml.h>
+
+// Read-only view of mpv's internal playlist ("playlist" property). It's fed
+// by MpvObject whenever mpv reports a change and only emits the row
+// insertions/removals/changes that actually happened, so views don't reset
+// on every track change. Huge playlists are exposed in batches through
+// canFetchMore()/fetchMore().
+class MpvPlaylistModel : public QAbstractListModel {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvPlaylistModel)
+
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(int currentIndex READ currentIndex NOTIFY currentIndexChanged)
+
+    QML_ELEMENT
+    QML_UNCREATABLE("Use MpvObject's playlist property instead.")
+
+public:
+    enum Roles {
+        FileNameRole = Qt::UserRole + 1,
+        UrlRole,
+        TitleRole,
+        CurrentRole,
+        PlayingRole,
+        EntryIdRole
+    };
+    Q_ENUM(Roles)
+
+    struct Entry {
+        QString fileName;
+        QString title;
+        qint64 id = -1;
+        bool current = false;
+        bool playing = false;
+    };
+
+    explicit MpvPlaylistModel(QObject *parent = nullptr);
+    ~MpvPlaylistModel() override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index,
+                  int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    // Total number of entries in mpv's playlist, including the ones that
+    // haven't been fetched yet.
+    int count() const;
+    // Index of the current entry, -1 if there is none.
+    int currentIndex() const;
+
+    // The raw value of mpv's "playlist" property.
+    void update(const QVariantList &playlist);
+
+    Entry entry(int index) const;
+
+    // mpv only knows about file names, this turns them back into urls.
+    static QUrl urlFromFileName(const QString &fileName);
+
+private:
+    static bool isSameItem(const Entry &lhs, const Entry &rhs);
+    static bool isSameEntry(const Entry &lhs, const Entry &rhs);
+
+private:
+    QVector<Entry> entries;
+    int exposedCount = 0;
+    int currentRow = -1;
+
+    static constexpr int fetchBatchSize = 256;
+
+Q_SIGNALS:
+    void countChanged();
+    void currentIndexChanged();
+};
@@ -0,0 +1,570 @@
+#include "mpvspritesheetcache.h"
+#include "mpvheadlessplayer.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPointer>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+// All fields are little endian.
+constexpr char sheetMagic[8] = {'M', 'P', 'V', 'S', 'P', 'R', 'T', 'S'};
+constexpr quint32 sheetVersion = 1;
+
+struct SheetHeader {
+    char magic[8];
+    quint32 version;
+    quint32 tileCount;
+    // In milliseconds.
+    quint32 interval;
+    quint32 tileWidth;
+    quint32 tileHeight;
+    quint32 reserved;
+    quint64 sourceSize;
+    // Milliseconds since the epoch.
+    qint64 sourceModified;
+};
+static_assert(sizeof(SheetHeader) == 48, "Unexpected sprite sheet header");
+
+struct SheetIndexEntry {
+    // In milliseconds.
+    qint64 position;
+    // From the start of the file.
+    quint64 offset;
+    quint32 size;
+    quint32 reserved;
+};
+static_assert(sizeof(SheetIndexEntry) == 24, "Unexpected sprite sheet index");
+
+constexpr int tileQuality = 80;
+
+// Sheets kept mapped (and their files open), including the files known to
+// have none.
+constexpr int mappedSheetLimit = 32;
+// Sources whose sheet file name is remembered, and for how long (in
+// milliseconds).
+constexpr int identityLimit = 256;
+constexpr qint64 identityLifetime = 5000;
+
+} // namespace
+
+struct MpvSpriteSheetCache::Sheet {
+    QFile file;
+    const uchar *data = nullptr;
+    qint64 size = 0;
+    quint32 tileCount = 0;
+
+    ~Sheet() {
+        if (data != nullptr) {
+            file.unmap(const_cast<uchar *>(data));
+        }
+    }
+
+    qint64 position(quint32 tile) const {
+        return qFromLittleEndian<qint64>(
+            data + sizeof(SheetHeader) + (tile * sizeof(SheetIndexEntry)) +
+            offsetof(SheetIndexEntry, position));
+    }
+
+    QImage image(quint32 tile) const {
+        const uchar *entry = data + sizeof(SheetHeader) +
+            (tile * sizeof(SheetIndexEntry));
+        const auto offset = qFromLittleEndian<quint64>(
+            entry + offsetof(SheetIndexEntry, offset));
+        const auto length = qFromLittleEndian<quint32>(
+            entry + offsetof(SheetIndexEntry, size));
+        if ((offset + length) > static_cast<quint64>(size)) {
+            return QImage();
+        }
+        return QImage::fromData(data + offset, static_cast<int>(length),
+                                "JPG");
+    }
+};
+
+class MpvSpriteSheetJob : public QRunnable {
+    Q_DISABLE_COPY_MOVE(MpvSpriteSheetJob)
+
+public:
+    MpvSpriteSheetJob(MpvSpriteSheetCache *cache,
+                      const MpvSpriteSheetCache::JobPtr &job)
+        : cache(cache), job(job) {}
+    ~MpvSpriteSheetJob() override = default;
+
+    void run() override { cache->runJob(job); }
+
+private:
+    MpvSpriteSheetCache *cache = nullptr;
+    MpvSpriteSheetCache::JobPtr job;
+};
+
+MpvSpriteSheetCache::MpvSpriteSheetCache(QObject *parent)
+    : QObject(parent),
+      currentCacheDirectory(
+          QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+          QString::fromUtf8("/mpvsprites")) {
+    // Generating sheets is a background task, it must not compete with the
+    // thumbnails the user is waiting for.
+    threadPool.setMaxThreadCount(1);
+    sheets.setMaxCost(mappedSheetLimit);
+    identities.setMaxCost(identityLimit);
+}
+
+MpvSpriteSheetCache::~MpvSpriteSheetCache() {
+    threadPool.clear();
+    {
+        QMutexLocker locker(&mutex);
+        for (auto &&job : std::as_const(jobs)) {
+            job->cancelled = true;
+        }
+    }
+    threadPool.waitForDone();
+}
+
+MpvSpriteSheetCache *MpvSpriteSheetCache::instance() {
+    static QPointer<MpvSpriteSheetCache> cache;
+    if (cache.isNull()) {
+        cache = new MpvSpriteSheetCache(QCoreApplication::instance());
+    }
+    return cache;
+}
+
+QString MpvSpriteSheetCache::cacheDirectory() const {
+    QMutexLocker locker(&mutex);
+    return currentCacheDirectory;
+}
+
+int MpvSpriteSheetCache::tileWidth() const {
+    QMutexLocker locker(&mutex);
+    return currentTileWidth;
+}
+
+qint64 MpvSpriteSheetCache::maximumCacheSize() const {
+    QMutexLocker locker(&mutex);
+    return currentMaximumCacheSize;
+}
+
+int MpvSpriteSheetCache::pendingJobs() const {
+    QMutexLocker locker(&mutex);
+    return jobs.count();
+}
+
+qint64 MpvSpriteSheetCache::cacheHits() const {
+    return hits.load(std::memory_order_relaxed);
+}
+
+qint64 MpvSpriteSheetCache::cacheMisses() const {
+    return misses.load(std::memory_order_relaxed);
+}
+
+void MpvSpriteSheetCache::setCacheDirectory(const QString &cacheDirectory) {
+    {
+        QMutexLocker locker(&mutex);
+        if (cacheDirectory.isEmpty() ||
+            (cacheDirectory == currentCacheDirectory)) {
+            return;
+        }
+        currentCacheDirectory = cacheDirectory;
+        sheets.clear();
+        identities.clear();
+    }
+    Q_EMIT cacheDirectoryChanged();
+}
+
+void MpvSpriteSheetCache::setTileWidth(int tileWidth) {
+    {
+        QMutexLocker locker(&mutex);
+        if ((tileWidth <= 0) || (tileWidth == currentTileWidth)) {
+            return;
+        }
+        currentTileWidth = tileWidth;
+    }
+    Q_EMIT tileWidthChanged();
+}
+
+void MpvSpriteSheetCache::setMaximumCacheSize(qint64 maximumCacheSize) {
+    {
+        QMutexLocker locker(&mutex);
+        if ((maximumCacheSize <= 0) ||
+            (maximumCacheSize == currentMaximumCacheSize)) {
+            return;
+        }
+        currentMaximumCacheSize = maximumCacheSize;
+    }
+    // Listing the directory is file system access, it's done on the
+    // generation thread like everything else that touches the sheets.
+    threadPool.start([this]() { trimCacheDirectory(); });
+    Q_EMIT maximumCacheSizeChanged();
+}
+
+QImage MpvSpriteSheetCache::thumbnail(const QUrl &source, qreal position) {
+    const QString fileName = cachedSheetFileName(source);
+    if (fileName.isEmpty()) {
+        return QImage();
+    }
+    SheetPtr sheet;
+    {
+        QMutexLocker locker(&mutex);
+        const SheetPtr *cached = sheets.object(fileName);
+        if (cached != nullptr) {
+            sheet = *cached;
+        } else {
+            sheet = openSheet(fileName);
+            sheets.insert(fileName, new SheetPtr(sheet));
+        }
+    }
+    if (sheet.isNull() || (sheet->tileCount == 0)) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        scheduleStatisticsChanged();
+        return QImage();
+    }
+    // The last tile that doesn't start after the requested position.
+    const auto target = qRound64(qMax(position, 0.0) * 1000.0);
+    if (target < sheet->position(0)) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        scheduleStatisticsChanged();
+        return QImage();
+    }
+    quint32 first = 0;
+    quint32 last = sheet->tileCount;
+    while ((last - first) > 1) {
+        const quint32 middle = first + ((last - first) / 2);
+        if (sheet->position(middle) <= target) {
+            first = middle;
+        } else {
+            last = middle;
+        }
+    }
+    const QImage image = sheet->image(first);
+    if (image.isNull()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        hits.fetch_add(1, std::memory_order_relaxed);
+    }
+    scheduleStatisticsChanged();
+    return image;
+}
+
+bool MpvSpriteSheetCache::generate(const QUrl &source, qreal interval) {
+    const QString fileName = sheetFileName(source);
+    if (fileName.isEmpty() || (interval <= 0.0)) {
+        return false;
+    }
+    {
+        QMutexLocker locker(&mutex);
+        if (jobs.contains(fileName)) {
+            return false;
+        }
+        const SheetPtr *sheet = sheets.object(fileName);
+        if (((sheet != nullptr) && !sheet->isNull() &&
+             ((*sheet)->tileCount != 0)) ||
+            QFile::exists(fileName)) {
+            return false;
+        }
+        auto job = JobPtr::create();
+        job->source = source;
+        job->interval = interval;
+        job->tileWidth = currentTileWidth;
+        job->fileName = fileName;
+        jobs.insert(fileName, job);
+        threadPool.start(new MpvSpriteSheetJob(this, job));
+    }
+    Q_EMIT pendingJobsChanged();
+    return true;
+}
+
+void MpvSpriteSheetCache::cancel(const QUrl &source) {
+    const QString fileName = sheetFileName(source);
+    QMutexLocker locker(&mutex);
+    const JobPtr job = jobs.value(fileName);
+    if (!job.isNull()) {
+        job->cancelled = true;
+    }
+}
+
+bool MpvSpriteSheetCache::isCached(const QUrl &source) const {
+    const QString fileName = sheetFileName(source);
+    return !fileName.isEmpty() && QFile::exists(fileName);
+}
+
+qreal MpvSpriteSheetCache::progress(const QUrl &source) const {
+    const QString fileName = sheetFileName(source);
+    QMutexLocker locker(&mutex);
+    const JobPtr job = jobs.value(fileName);
+    return job.isNull() ? -1.0 : job->progress.load();
+}
+
+void MpvSpriteSheetCache::remove(const QUrl &source) {
+    const QString fileName = sheetFileName(source);
+    if (fileName.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&mutex);
+    // Lookups that are still using the mapping keep their own reference,
+    // the file is unmapped once the last one is done.
+    sheets.remove(fileName);
+    QFile::remove(fileName);
+}
+
+void MpvSpriteSheetCache::resetStatistics() {
+    hits.store(0, std::memory_order_relaxed);
+    misses.store(0, std::memory_order_relaxed);
+    Q_EMIT statisticsChanged();
+}
+
+QString MpvSpriteSheetCache::sheetFileName(const QUrl &source) const {
+    if (!source.isLocalFile()) {
+        return QString();
+    }
+    const QFileInfo fileInfo(source.toLocalFile());
+    if (!fileInfo.isFile()) {
+        return QString();
+    }
+    const QByteArray identity = fileInfo.absoluteFilePath().toUtf8() + '\n' +
+        QByteArray::number(fileInfo.size()) + '\n' +
+        QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch());
+    const QString hash = QString::fromLatin1(
+        QCryptographicHash::hash(identity, QCryptographicHash::Sha1).toHex());
+    QMutexLocker locker(&mutex);
+    const QString fileName = currentCacheDirectory + QChar::fromLatin1('/') +
+        hash + QString::fromUtf8(".sprites");
+    auto sourceIdentity = new SourceIdentity;
+    sourceIdentity->sheetFileName = fileName;
+    sourceIdentity->age.start();
+    identities.insert(source, sourceIdentity);
+    return fileName;
+}
+
+QString MpvSpriteSheetCache::cachedSheetFileName(const QUrl &source) const {
+    {
+        QMutexLocker locker(&mutex);
+        const SourceIdentity *identity = identities.object(source);
+        if ((identity != nullptr) &&
+            !identity->age.hasExpired(identityLifetime)) {
+            return identity->sheetFileName;
+        }
+    }
+    return sheetFileName(source);
+}
+
+MpvSpriteSheetCache::SheetPtr
+MpvSpriteSheetCache::openSheet(const QString &fileName) const {
+    auto sheet = SheetPtr::create();
+    sheet->file.setFileName(fileName);
+    if (!sheet->file.open(QFile::ReadOnly)) {
+        return SheetPtr();
+    }
+    sheet->size = sheet->file.size();
+    if (sheet->size < static_cast<qint64>(sizeof(SheetHeader))) {
+        return SheetPtr();
+    }
+    sheet->data = sheet->file.map(0, sheet->size);
+    if (sheet->data == nullptr) {
+        return SheetPtr();
+    }
+    if ((std::memcmp(sheet->data, sheetMagic, sizeof(sheetMagic)) != 0) ||
+        (qFromLittleEndian<quint32>(sheet->data +
+                                    offsetof(SheetHeader, version)) !=
+         sheetVersion)) {
+        qWarning().noquote() << "Ignoring invalid sprite sheet:" << fileName;
+        return SheetPtr();
+    }
+    const auto tileCount = qFromLittleEndian<quint32>(
+        sheet->data + offsetof(SheetHeader, tileCount));
+    if ((sizeof(SheetHeader) + (static_cast<quint64>(tileCount) *
+                                sizeof(SheetIndexEntry))) >
+        static_cast<quint64>(sheet->size)) {
+        qWarning().noquote() << "Ignoring truncated sprite sheet:" << fileName;
+        return SheetPtr();
+    }
+    sheet->tileCount = tileCount;
+    return sheet;
+}
+
+void MpvSpriteSheetCache::runJob(const JobPtr &job) {
+    MpvHeadlessPlayer player(job->tileWidth);
+    if (!player.load(job->source, 30000)) {
+        finishJob(job, false);
+        return;
+    }
+    const qreal duration = player.property("duration").toReal();
+    if (duration <= 0.0) {
+        finishJob(job, false);
+        return;
+    }
+    QVector<qint64> positions;
+    QVector<QByteArray> tiles;
+    QSize tileSize;
+    qreal lastReported = 0.0;
+    for (qreal position = 0.0; position < duration;
+         position += job->interval) {
+        if (job->cancelled) {
+            finishJob(job, false);
+            return;
+        }
+        if (!player.seek(position)) {
+            continue;
+        }
+        const QImage image = player.grab();
+        if (image.isNull()) {
+            continue;
+        }
+        QByteArray tile;
+        QBuffer buffer(&tile);
+        buffer.open(QBuffer::WriteOnly);
+        if (!image.save(&buffer, "JPG", tileQuality)) {
+            continue;
+        }
+        tileSize = image.size();
+        positions.append(qRound64(position * 1000.0));
+        tiles.append(tile);
+        const qreal progress = qMin(position / duration, 1.0);
+        job->progress = progress;
+        // Good enough for a progress bar, without flooding the GUI thread.
+        if ((progress - lastReported) >= 0.01) {
+            lastReported = progress;
+            const QUrl source = job->source;
+            QMetaObject::invokeMethod(
+                this,
+                [this, source, progress]() {
+                    Q_EMIT progressChanged(source, progress);
+                },
+                Qt::QueuedConnection);
+        }
+    }
+    if (tiles.isEmpty()) {
+        finishJob(job, false);
+        return;
+    }
+
+    const QFileInfo sourceInfo(job->source.toLocalFile());
+    SheetHeader header;
+    std::memcpy(header.magic, sheetMagic, sizeof(sheetMagic));
+    header.version = qToLittleEndian(sheetVersion);
+    header.tileCount = qToLittleEndian(static_cast<quint32>(tiles.count()));
+    header.interval =
+        qToLittleEndian(static_cast<quint32>(qRound(job->interval * 1000.0)));
+    header.tileWidth = qToLittleEndian(static_cast<quint32>(tileSize.width()));
+    header.tileHeight =
+        qToLittleEndian(static_cast<quint32>(tileSize.height()));
+    header.reserved = 0;
+    header.sourceSize =
+        qToLittleEndian(static_cast<quint64>(sourceInfo.size()));
+    header.sourceModified =
+        qToLittleEndian(sourceInfo.lastModified().toMSecsSinceEpoch());
+
+    QVector<SheetIndexEntry> index(tiles.count());
+    quint64 offset = sizeof(SheetHeader) +
+        (static_cast<quint64>(tiles.count()) * sizeof(SheetIndexEntry));
+    for (int i = 0; i != tiles.count(); ++i) {
+        index[i].position = qToLittleEndian(positions.at(i));
+        index[i].offset = qToLittleEndian(offset);
+        index[i].size =
+            qToLittleEndian(static_cast<quint32>(tiles.at(i).size()));
+        index[i].reserved = 0;
+        offset += tiles.at(i).size();
+    }
+
+    QDir().mkpath(QFileInfo(job->fileName).absolutePath());
+    // Readers never see a half written sheet.
+    QSaveFile file(job->fileName);
+    if (!file.open(QSaveFile::WriteOnly)) {
+        qWarning().noquote() << "Failed to create sprite sheet:"
+                             << job->fileName;
+        finishJob(job, false);
+        return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(index.constData()),
+               static_cast<qint64>(index.count() * sizeof(SheetIndexEntry)));
+    for (auto &&tile : std::as_const(tiles)) {
+        file.write(tile);
+    }
+    const bool success = file.commit();
+    if (success) {
+        trimCacheDirectory(job->fileName);
+    }
+    finishJob(job, success);
+}
+
+void MpvSpriteSheetCache::trimCacheDirectory(const QString &keep) {
+    QString directory;
+    qint64 limit = 0;
+    {
+        QMutexLocker locker(&mutex);
+        directory = currentCacheDirectory;
+        limit = currentMaximumCacheSize;
+    }
+    // Oldest first.
+    const QFileInfoList fileInfos = QDir(directory).entryInfoList(
+        QStringList{QString::fromUtf8("*.sprites")}, QDir::Files,
+        QDir::Time | QDir::Reversed);
+    qint64 total = 0;
+    for (auto &&fileInfo : std::as_const(fileInfos)) {
+        total += fileInfo.size();
+    }
+    for (auto &&fileInfo : std::as_const(fileInfos)) {
+        if (total <= limit) {
+            break;
+        }
+        const QString fileName = fileInfo.filePath();
+        if (fileName == keep) {
+            continue;
+        }
+        QMutexLocker locker(&mutex);
+        if (jobs.contains(fileName)) {
+            continue;
+        }
+        // Same as remove(), lookups still using the mapping keep it.
+        sheets.remove(fileName);
+        if (QFile::remove(fileName)) {
+            total -= fileInfo.size();
+        }
+    }
+}
+
+void MpvSpriteSheetCache::finishJob(const JobPtr &job, bool success) {
+    {
+        QMutexLocker locker(&mutex);
+        jobs.remove(job->fileName);
+        // Forget that there was no sheet.
+        sheets.remove(job->fileName);
+    }
+    const QUrl source = job->source;
+    QMetaObject::invokeMethod(
+        this,
+        [this, source, success]() {
+            if (success) {
+                Q_EMIT progressChanged(source, 1.0);
+            }
+            Q_EMIT pendingJobsChanged();
+            Q_EMIT finished(source, success);
+        },
+        Qt::QueuedConnection);
+}
+
+void MpvSpriteSheetCache::scheduleStatisticsChanged() {
+    // Lookups happen on the image provider threads, possibly dozens per
+    // second, one notification per event loop iteration is enough.
+    if (!statisticsPending.testAndSetOrdered(0, 1)) {
+        return;
+    }
+    QMetaObject::invokeMethod(
+        this,
+        [this]() {
+            statisticsPending.storeRelease(0);
+            Q_EMIT statisticsChanged();
+        },
+        Qt::QueuedConnection);
+}
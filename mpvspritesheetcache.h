@@ -0,0 +1,145 @@
+#pragma once
+
+#include <QAtomicInt>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QUrl>
+#include <atomic>
+
+// Precomputed seek previews for long local files. generate() decodes a
+// keyframe every few seconds with a headless mpv instance and packs the
+// JPEG compressed tiles into one file per media:
+//   header (magic, version, tile count, interval, tile size, identity)
+//   index  (position, offset and size of every tile)
+//   tiles
+// The file name is derived from the media's identity (path, size and
+// modification time), so a modified file never gets stale previews (after
+// at most a few seconds, the identity of a source is remembered that long).
+// Sheets are memory mapped when first used and unmapped again when they
+// haven't been used for a while, a lookup is a binary search over the index
+// plus decoding one small JPEG. Once the cache directory holds more than
+// maximumCacheSize, the oldest sheets are deleted.
+// MpvThumbnailEngine asks here first, so seek bar previews of files with a
+// sheet are available instantly.
+class MpvSpriteSheetCache : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvSpriteSheetCache)
+
+    Q_PROPERTY(QString cacheDirectory READ cacheDirectory WRITE
+                   setCacheDirectory NOTIFY cacheDirectoryChanged)
+    Q_PROPERTY(int tileWidth READ tileWidth WRITE setTileWidth NOTIFY
+                   tileWidthChanged)
+    Q_PROPERTY(qint64 maximumCacheSize READ maximumCacheSize WRITE
+                   setMaximumCacheSize NOTIFY maximumCacheSizeChanged)
+    Q_PROPERTY(int pendingJobs READ pendingJobs NOTIFY pendingJobsChanged)
+    Q_PROPERTY(qint64 cacheHits READ cacheHits NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 cacheMisses READ cacheMisses NOTIFY statisticsChanged)
+
+public:
+    explicit MpvSpriteSheetCache(QObject *parent = nullptr);
+    ~MpvSpriteSheetCache() override;
+
+    static MpvSpriteSheetCache *instance();
+
+    // Defaults to "mpvsprites" in the application's cache location.
+    QString cacheDirectory() const;
+    // Width of the tiles of newly generated sheets.
+    int tileWidth() const;
+    // Bytes all sheets in the cache directory may take up together. Checked
+    // whenever a sheet has been generated, the oldest ones go first.
+    qint64 maximumCacheSize() const;
+    // Sheets that are queued or being generated.
+    int pendingJobs() const;
+    // Lookups answered from a sheet, and lookups of files without one.
+    qint64 cacheHits() const;
+    qint64 cacheMisses() const;
+
+    void setCacheDirectory(const QString &cacheDirectory);
+    void setTileWidth(int tileWidth);
+    void setMaximumCacheSize(qint64 maximumCacheSize);
+
+    // Thread-safe. The tile closest to (but not after) the given position,
+    // in seconds. Null if there is no sheet for the file or the position is
+    // before its first tile.
+    QImage thumbnail(const QUrl &source, qreal position);
+
+public Q_SLOTS:
+    // Queue the generation of a sheet with a tile every interval seconds.
+    // Only local files are supported. Returns false if there's nothing to
+    // do, either because the sheet exists already or because the file
+    // can't be used.
+    bool generate(const QUrl &source, qreal interval = 10.0);
+    void cancel(const QUrl &source);
+    bool isCached(const QUrl &source) const;
+    // Generation progress of the given file, 0.0-1.0, or -1 if it's not
+    // being generated.
+    qreal progress(const QUrl &source) const;
+    // Unmaps and deletes the sheet of the given file.
+    void remove(const QUrl &source);
+    void resetStatistics();
+
+private:
+    friend class MpvSpriteSheetJob;
+
+    struct Sheet;
+    using SheetPtr = QSharedPointer<Sheet>;
+
+    struct Job {
+        QUrl source;
+        qreal interval = 10.0;
+        int tileWidth = 0;
+        QString fileName;
+        std::atomic_bool cancelled{false};
+        std::atomic<qreal> progress{0.0};
+    };
+    using JobPtr = QSharedPointer<Job>;
+
+    struct SourceIdentity {
+        QString sheetFileName;
+        QElapsedTimer age;
+    };
+
+    // Empty if the source is not a local file.
+    QString sheetFileName(const QUrl &source) const;
+    // Same, but reuses the result of the last few seconds instead of
+    // reading the file's metadata and hashing it on every lookup.
+    QString cachedSheetFileName(const QUrl &source) const;
+    SheetPtr openSheet(const QString &fileName) const;
+    void runJob(const JobPtr &job);
+    void finishJob(const JobPtr &job, bool success);
+    // Deletes the oldest sheets of the cache directory until they fit into
+    // maximumCacheSize, except for the given one and those being generated.
+    void trimCacheDirectory(const QString &keep = QString());
+    void scheduleStatisticsChanged();
+
+private:
+    mutable QMutex mutex;
+    QString currentCacheDirectory;
+    int currentTileWidth = 160;
+    qint64 currentMaximumCacheSize = 256 * 1024 * 1024;
+    // Mapped sheets by sheet file name, null for files known to have none.
+    // Evicted sheets are unmapped once the lookups using them are done.
+    mutable QCache<QString, SheetPtr> sheets;
+    // By source URL.
+    mutable QCache<QUrl, SourceIdentity> identities;
+    QHash<QString, JobPtr> jobs;
+    QThreadPool threadPool;
+    std::atomic<qint64> hits{0};
+    std::atomic<qint64> misses{0};
+    QAtomicInt statisticsPending = 0;
+
+Q_SIGNALS:
+    void cacheDirectoryChanged();
+    void tileWidthChanged();
+    void maximumCacheSizeChanged();
+    void pendingJobsChanged();
+    void statisticsChanged();
+    void progressChanged(const QUrl &source, qreal progress);
+    void finished(const QUrl &source, bool success);
+};
@@ -0,0 +1,284 @@
+#include "mpvstatsoverlay.h"
+
+#include <QCoreApplication>
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QPainter>
+#include <QQuickWindow>
+#include <QSGSimpleTextureNode>
+#include <QThreadPool>
+
+namespace {
+
+// Read in one go on a worker thread, so that a busy mpv core never blocks
+// the GUI thread.
+const char *const sampledProperties[] = {
+    "decoder-frame-drop-count",
+    "frame-drop-count",
+    "vo-delayed-frame-count",
+    "avsync",
+    "estimated-vf-fps",
+    "container-fps",
+    "display-fps",
+    "estimated-display-fps",
+    "demuxer-cache-duration",
+    "cache-buffering-state",
+    "paused-for-cache",
+    "cache-speed",
+    "hwdec-current"};
+
+QString valueOrNa(const QVariant &value) {
+    return value.isValid() ? value.toString() : QString::fromUtf8("n/a");
+}
+
+QString decimalOrNa(const QVariant &value, int precision,
+                    qreal factor = 1.0) {
+    return value.isValid()
+        ? QString::number(value.toDouble() * factor, 'f', precision)
+        : QString::fromUtf8("n/a");
+}
+
+// Histogram values are microseconds.
+QString percentiles(const QVariantMap &histogram) {
+    const auto milliseconds = [&histogram](const char *key) {
+        return QString::number(
+            histogram.value(QString::fromUtf8(key)).toDouble() / 1000.0, 'f',
+            1);
+    };
+    return QString::fromUtf8("p50 %1 p90 %2 p99 %3 max %4 ms")
+        .arg(milliseconds("p50"), milliseconds("p90"), milliseconds("p99"),
+             milliseconds("max"));
+}
+
+} // namespace
+
+MpvStatsOverlay::MpvStatsOverlay(QQuickItem *parent) : QQuickItem(parent) {
+    setFlag(ItemHasContents);
+    timer.setInterval(currentInterval);
+    connect(&timer, &QTimer::timeout, this, &MpvStatsOverlay::sample);
+}
+
+MpvStatsOverlay::~MpvStatsOverlay() = default;
+
+MpvObject *MpvStatsOverlay::player() const { return currentPlayer; }
+
+int MpvStatsOverlay::interval() const { return currentInterval; }
+
+QColor MpvStatsOverlay::textColor() const { return currentTextColor; }
+
+QColor MpvStatsOverlay::backgroundColor() const {
+    return currentBackgroundColor;
+}
+
+QVariantMap MpvStatsOverlay::statistics() const { return currentStatistics; }
+
+void MpvStatsOverlay::setPlayer(MpvObject *player) {
+    if (currentPlayer == player) {
+        return;
+    }
+    if (!currentPlayer.isNull()) {
+        disconnect(currentPlayer, nullptr, this, nullptr);
+    }
+    currentPlayer = player;
+    if (player != nullptr) {
+        connect(player, &QObject::destroyed, this,
+                &MpvStatsOverlay::updateTimer);
+    }
+    currentStatistics.clear();
+    updateTimer();
+    Q_EMIT playerChanged();
+}
+
+void MpvStatsOverlay::setInterval(int interval) {
+    interval = qMax(interval, 100);
+    if (interval == currentInterval) {
+        return;
+    }
+    currentInterval = interval;
+    timer.setInterval(interval);
+    Q_EMIT intervalChanged();
+}
+
+void MpvStatsOverlay::setTextColor(const QColor &color) {
+    if (color == currentTextColor) {
+        return;
+    }
+    currentTextColor = color;
+    redraw();
+    Q_EMIT textColorChanged();
+}
+
+void MpvStatsOverlay::setBackgroundColor(const QColor &color) {
+    if (color == currentBackgroundColor) {
+        return;
+    }
+    currentBackgroundColor = color;
+    redraw();
+    Q_EMIT backgroundColorChanged();
+}
+
+QSGNode *MpvStatsOverlay::updatePaintNode(QSGNode *oldNode,
+                                          UpdatePaintNodeData *data) {
+    Q_UNUSED(data)
+    auto node = static_cast<QSGSimpleTextureNode *>(oldNode);
+    if (image.isNull()) {
+        delete node;
+        return nullptr;
+    }
+    if (node == nullptr) {
+        node = new QSGSimpleTextureNode;
+        node->setOwnsTexture(true);
+        imageDirty = true;
+    }
+    if (imageDirty) {
+        node->setTexture(window()->createTextureFromImage(image));
+        imageDirty = false;
+    }
+    node->setRect(
+        QRectF(QPointF(0.0, 0.0),
+               QSizeF(image.size()) / image.devicePixelRatio()));
+    return node;
+}
+
+void MpvStatsOverlay::itemChange(ItemChange change,
+                                 const ItemChangeData &value) {
+    QQuickItem::itemChange(change, value);
+    if ((change == ItemVisibleHasChanged) || (change == ItemSceneChange)) {
+        updateTimer();
+    }
+}
+
+void MpvStatsOverlay::sample() {
+    // Never more than one sample in flight, a stuck mpv core must not pile
+    // up jobs.
+    if (samplePending || currentPlayer.isNull() ||
+        (currentPlayer->mpv == nullptr)) {
+        return;
+    }
+    samplePending = true;
+    // The handle copy keeps mpv alive until the job is done.
+    const mpv::qt::Handle handle = currentPlayer->mpv;
+    const QPointer<MpvStatsOverlay> guard(this);
+    QThreadPool::globalInstance()->start([handle, guard]() {
+        QVariantMap properties;
+        for (auto &&name : sampledProperties) {
+            const QVariant value = mpv::qt::get_property(handle, name);
+            if (!mpv::qt::is_error(value)) {
+                properties[QString::fromUtf8(name)] = value;
+            }
+        }
+        // The guard may only be checked on the GUI thread.
+        QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [guard, properties]() {
+                if (!guard.isNull()) {
+                    guard->applySample(properties);
+                }
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void MpvStatsOverlay::updateTimer() {
+    if (isVisible() && (window() != nullptr) && !currentPlayer.isNull()) {
+        if (!timer.isActive()) {
+            timer.start();
+            sample();
+        }
+        return;
+    }
+    timer.stop();
+    if (currentPlayer.isNull() && !image.isNull()) {
+        image = QImage();
+        update();
+    }
+}
+
+void MpvStatsOverlay::applySample(const QVariantMap &properties) {
+    samplePending = false;
+    if (currentPlayer.isNull()) {
+        return;
+    }
+    currentStatistics = properties;
+    currentStatistics[QString::fromUtf8("renderTime")] =
+        currentPlayer->renderTimeHistogram().toVariantMap();
+    currentStatistics[QString::fromUtf8("eventDrainTime")] =
+        currentPlayer->eventDrainHistogram().toVariantMap();
+    redraw();
+    Q_EMIT sampled();
+}
+
+QStringList MpvStatsOverlay::lines() const {
+    const auto value = [this](const char *name) {
+        return currentStatistics.value(QString::fromUtf8(name));
+    };
+    QStringList result;
+    result.append(
+        QString::fromUtf8("Dropped: decoder %1, output %2, delayed %3")
+            .arg(valueOrNa(value("decoder-frame-drop-count")),
+                 valueOrNa(value("frame-drop-count")),
+                 valueOrNa(value("vo-delayed-frame-count"))));
+    result.append(QString::fromUtf8("A/V sync: %1 ms")
+                      .arg(decimalOrNa(value("avsync"), 1, 1000.0)));
+    result.append(
+        QString::fromUtf8("FPS: %1 (container %2), display %3 (measured %4)")
+            .arg(decimalOrNa(value("estimated-vf-fps"), 3),
+                 decimalOrNa(value("container-fps"), 3),
+                 decimalOrNa(value("display-fps"), 3),
+                 decimalOrNa(value("estimated-display-fps"), 3)));
+    QString cache = QString::fromUtf8("Cache: %1 s, %2%, %3 KiB/s")
+                        .arg(decimalOrNa(value("demuxer-cache-duration"), 1),
+                             valueOrNa(value("cache-buffering-state")),
+                             decimalOrNa(value("cache-speed"), 0,
+                                         1.0 / 1024.0));
+    if (value("paused-for-cache").toBool()) {
+        cache += QString::fromUtf8(" (buffering)");
+    }
+    result.append(cache);
+    result.append(QString::fromUtf8("Hardware decoding: %1")
+                      .arg(valueOrNa(value("hwdec-current"))));
+    result.append(
+        QString::fromUtf8("Render: %1")
+            .arg(percentiles(value("renderTime").toMap())));
+    result.append(
+        QString::fromUtf8("Event drain: %1")
+            .arg(percentiles(value("eventDrainTime").toMap())));
+    return result;
+}
+
+void MpvStatsOverlay::redraw() {
+    if (currentStatistics.isEmpty()) {
+        return;
+    }
+    const qreal devicePixelRatio =
+        (window() != nullptr) ? window()->effectiveDevicePixelRatio() : 1.0;
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setPixelSize(12);
+    const QFontMetrics metrics(font);
+    const QStringList text = lines();
+    const int padding = 6;
+    int width = 0;
+    for (auto &&line : std::as_const(text)) {
+        width = qMax(width, metrics.horizontalAdvance(line));
+    }
+    const QSize size(width + (2 * padding),
+                     (metrics.height() * text.count()) + (2 * padding));
+    // Only a few times per second and never per frame, so painting on the
+    // GUI thread is fine.
+    image = QImage(size * devicePixelRatio,
+                   QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(devicePixelRatio);
+    image.fill(currentBackgroundColor);
+    QPainter painter(&image);
+    painter.setFont(font);
+    painter.setPen(currentTextColor);
+    int y = padding + metrics.ascent();
+    for (auto &&line : std::as_const(text)) {
+        painter.drawText(padding, y, line);
+        y += metrics.height();
+    }
+    painter.end();
+    imageDirty = true;
+    setImplicitSize(size.width(), size.height());
+    update();
+}
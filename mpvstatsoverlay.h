@@ -0,0 +1,84 @@
+#pragma once
+
+#include "mpvobject.h"
+#include <QColor>
+#include <QImage>
+#include <QPointer>
+#include <QQuickItem>
+#include <QTimer>
+#include <QVariant>
+
+// Playback statistics of one player, drawn as a single textured node on
+// top of whatever it's placed over: dropped frames, A/V sync, frame rates,
+// cache state, hardware decoding and the render and event drain time
+// percentiles. A timer samples the player at a fixed low rate, the mpv
+// properties are read on a worker thread and the text is only redrawn
+// when a sample arrives, so neither the GUI nor the render thread do any
+// extra work per frame. Nothing is sampled while the item is hidden.
+class MpvStatsOverlay : public QQuickItem {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvStatsOverlay)
+
+    Q_PROPERTY(MpvObject *player READ player WRITE setPlayer NOTIFY
+                   playerChanged)
+    Q_PROPERTY(int interval READ interval WRITE setInterval NOTIFY
+                   intervalChanged)
+    Q_PROPERTY(QColor textColor READ textColor WRITE setTextColor NOTIFY
+                   textColorChanged)
+    Q_PROPERTY(QColor backgroundColor READ backgroundColor WRITE
+                   setBackgroundColor NOTIFY backgroundColorChanged)
+    Q_PROPERTY(QVariantMap statistics READ statistics NOTIFY sampled)
+
+    QML_ELEMENT
+
+public:
+    explicit MpvStatsOverlay(QQuickItem *parent = nullptr);
+    ~MpvStatsOverlay() override;
+
+    MpvObject *player() const;
+    // Sampling interval, in milliseconds. Never less than 100.
+    int interval() const;
+    QColor textColor() const;
+    QColor backgroundColor() const;
+    // The last sample: the raw mpv property values, plus "renderTime" and
+    // "eventDrainTime" (see MpvHistogram::toVariantMap()).
+    QVariantMap statistics() const;
+
+    void setPlayer(MpvObject *player);
+    void setInterval(int interval);
+    void setTextColor(const QColor &color);
+    void setBackgroundColor(const QColor &color);
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode,
+                             UpdatePaintNodeData *data) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
+
+private Q_SLOTS:
+    void sample();
+
+private:
+    void updateTimer();
+    void applySample(const QVariantMap &properties);
+    QStringList lines() const;
+    void redraw();
+
+private:
+    QPointer<MpvObject> currentPlayer;
+    QTimer timer;
+    int currentInterval = 500;
+    QColor currentTextColor = QColor(255, 255, 255);
+    QColor currentBackgroundColor = QColor(0, 0, 0, 160);
+    QVariantMap currentStatistics;
+    bool samplePending = false;
+    // Handed to the scene graph in updatePaintNode().
+    QImage image;
+    bool imageDirty = false;
+
+Q_SIGNALS:
+    void playerChanged();
+    void intervalChanged();
+    void textColorChanged();
+    void backgroundColorChanged();
+    void sampled();
+};
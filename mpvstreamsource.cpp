@@ -0,0 +1,536 @@
+#include "mpvstreamsource.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QPointer>
+#include <QResource>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mpv/stream_cb.h>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char resourceProtocol[] = "qrc";
+constexpr char streamProtocol[] = "qtstream";
+constexpr char mappedProtocol[] = "mmap";
+constexpr char resourcePrefix[] = "qrc://";
+constexpr char streamPrefix[] = "qtstream://";
+constexpr char mappedPrefix[] = "mmap://";
+// Pages behind the window are dropped in steps of at least this much.
+constexpr qint64 dropGranularity = 4 * 1024 * 1024;
+
+// How long a read from a sequential device waits for data at once, before
+// checking whether it has been cancelled.
+constexpr int readPollInterval = 50;
+
+struct Source {
+    QByteArray data;
+    MpvStreamSource::DeviceFactory factory;
+};
+
+// Not part of the singleton, the streams are opened by mpv's threads,
+// and headless players register the protocols from worker threads.
+struct Registry {
+    QMutex mutex;
+    QHash<QString, Source> sources;
+};
+
+Registry &registry() {
+    static Registry sources;
+    return sources;
+}
+
+// Settings and counters of the mmap:// streams.
+struct MappingState {
+    std::atomic_bool mapLocalFiles{false};
+    std::atomic<qint64> readAhead{32 * 1024 * 1024};
+    std::atomic<qint64> keepBehind{64 * 1024 * 1024};
+    std::atomic<qint64> openFiles{0};
+    std::atomic<quint64> bytesRead{0};
+    std::atomic<quint64> residentReads{0};
+    std::atomic<quint64> faultingReads{0};
+    std::atomic<quint64> bytesPrefetched{0};
+    std::atomic<quint64> bytesDropped{0};
+    std::atomic<quint64> seeks{0};
+};
+
+MappingState &mapping() {
+    static MappingState state;
+    return state;
+}
+
+qint64 pageSize() {
+#ifdef Q_OS_UNIX
+    static const qint64 size = sysconf(_SC_PAGESIZE);
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+qint64 alignToPage(qint64 offset) { return offset - (offset % pageSize()); }
+
+// One open stream, used by one of mpv's threads at a time (cancellation
+// comes from another one).
+struct Stream {
+    Stream() = default;
+    ~Stream() {
+        if (mappedFile) {
+            mapping().openFiles.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    Q_DISABLE_COPY_MOVE(Stream)
+
+    // Memory streams are served from here without a device, and without
+    // copying the data anywhere but into mpv's buffer. The byte array or
+    // the mapped file own the memory.
+    const char *data = nullptr;
+    qint64 size = 0;
+    qint64 offset = 0;
+    QByteArray memory;
+    std::unique_ptr<QFile> mappedFile;
+    // Everything before these has been prefetched (mmap://), or dropped.
+    qint64 prefetchedUntil = 0;
+    qint64 droppedUntil = 0;
+    std::unique_ptr<QIODevice> device;
+    std::atomic_bool cancelled{false};
+};
+
+void setMemory(Stream *stream, const QByteArray &memory) {
+    stream->memory = memory;
+    stream->data = stream->memory.constData();
+    stream->size = stream->memory.size();
+}
+
+#ifdef Q_OS_UNIX
+void adviseMapping(Stream *stream, qint64 offset, qint64 length,
+                   int advice) {
+    madvise(const_cast<char *>(stream->data) + offset,
+            static_cast<size_t>(length), advice);
+}
+#endif
+
+#ifdef Q_OS_LINUX
+void adviseFile(Stream *stream, qint64 offset, qint64 length, int advice) {
+    posix_fadvise(stream->mappedFile->handle(), offset, length, advice);
+}
+#endif
+
+// Keeps the kernel reading ahead of mpv and lets go of what mpv's own
+// cache has taken over, so that several large files don't fight for the
+// page cache.
+void followReadPosition(Stream *stream) {
+#ifdef Q_OS_UNIX
+    MappingState &state = mapping();
+    const qint64 position = stream->offset;
+    const qint64 readAhead = state.readAhead.load(std::memory_order_relaxed);
+    // Renewed once half of the prefetched range has been consumed.
+    if ((readAhead > 0) &&
+        ((position + (readAhead / 2)) > stream->prefetchedUntil)) {
+        const qint64 start =
+            alignToPage(qMax(position, stream->prefetchedUntil));
+        const qint64 end = qMin(position + readAhead, stream->size);
+        if (end > start) {
+            adviseMapping(stream, start, end - start, MADV_WILLNEED);
+#ifdef Q_OS_LINUX
+            adviseFile(stream, start, end - start, POSIX_FADV_WILLNEED);
+#endif
+            state.bytesPrefetched.fetch_add(
+                static_cast<quint64>(end - start), std::memory_order_relaxed);
+            stream->prefetchedUntil = end;
+        }
+    }
+    const qint64 keepBehind =
+        state.keepBehind.load(std::memory_order_relaxed);
+    if (keepBehind > 0) {
+        const qint64 end = alignToPage(position - keepBehind);
+        if ((end - stream->droppedUntil) >= dropGranularity) {
+            const qint64 length = end - stream->droppedUntil;
+            // Only unmaps the pages from this process, they stay in the
+            // page cache for whoever else reads the file.
+            adviseMapping(stream, stream->droppedUntil, length,
+                          MADV_DONTNEED);
+            state.bytesDropped.fetch_add(static_cast<quint64>(length),
+                                         std::memory_order_relaxed);
+            stream->droppedUntil = end;
+        }
+    }
+#else
+    Q_UNUSED(stream)
+#endif
+}
+
+// Whether the page at the read position was already in memory, sampled
+// per read.
+void sampleResidency(Stream *stream) {
+#ifdef Q_OS_LINUX
+    unsigned char resident = 0;
+    if (mincore(const_cast<char *>(stream->data) +
+                    alignToPage(stream->offset),
+                static_cast<size_t>(pageSize()), &resident) != 0) {
+        return;
+    }
+    ((resident & 1) ? mapping().residentReads : mapping().faultingReads)
+        .fetch_add(1, std::memory_order_relaxed);
+#else
+    Q_UNUSED(stream)
+#endif
+}
+
+int64_t readStream(void *cookie, char *buffer, uint64_t size) {
+    auto stream = static_cast<Stream *>(cookie);
+    if (stream->cancelled.load(std::memory_order_relaxed)) {
+        return -1;
+    }
+    const qint64 maximum =
+        static_cast<qint64>(qMin(size, static_cast<uint64_t>(INT64_MAX)));
+    if (!stream->device) {
+        const qint64 count = qMin(maximum, stream->size - stream->offset);
+        if (count <= 0) {
+            return 0;
+        }
+        if (stream->mappedFile) {
+            sampleResidency(stream);
+        }
+        std::memcpy(buffer, stream->data + stream->offset,
+                    static_cast<size_t>(count));
+        stream->offset += count;
+        if (stream->mappedFile) {
+            mapping().bytesRead.fetch_add(static_cast<quint64>(count),
+                                          std::memory_order_relaxed);
+            followReadPosition(stream);
+        }
+        return count;
+    }
+    QIODevice *device = stream->device.get();
+    qint64 count = device->read(buffer, maximum);
+    // mpv takes 0 as the end of the stream, so sequential devices have to
+    // wait for more data instead. A device that returns from
+    // waitForReadyRead() right away either can't wait or has been closed.
+    while ((count == 0) && device->isSequential()) {
+        if (stream->cancelled.load(std::memory_order_relaxed)) {
+            return -1;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        if (!device->waitForReadyRead(readPollInterval) &&
+            (timer.elapsed() < (readPollInterval / 2))) {
+            break;
+        }
+        count = device->read(buffer, maximum);
+    }
+    return (count < 0) ? -1 : count;
+}
+
+int64_t seekStream(void *cookie, int64_t offset) {
+    auto stream = static_cast<Stream *>(cookie);
+    if (!stream->device) {
+        if ((offset < 0) || (offset > stream->size)) {
+            return MPV_ERROR_GENERIC;
+        }
+        stream->offset = offset;
+        if (stream->mappedFile) {
+            mapping().seeks.fetch_add(1, std::memory_order_relaxed);
+            // Start over from here, in both directions.
+            stream->prefetchedUntil = alignToPage(offset);
+            stream->droppedUntil = alignToPage(qMax(
+                offset - mapping().keepBehind.load(std::memory_order_relaxed),
+                qint64(0)));
+            followReadPosition(stream);
+        }
+        return offset;
+    }
+    return stream->device->seek(offset) ? offset : MPV_ERROR_GENERIC;
+}
+
+int64_t streamSize(void *cookie) {
+    auto stream = static_cast<Stream *>(cookie);
+    if (!stream->device) {
+        return stream->size;
+    }
+    return stream->device->isSequential() ? MPV_ERROR_UNSUPPORTED
+                                          : stream->device->size();
+}
+
+void closeStream(void *cookie) { delete static_cast<Stream *>(cookie); }
+
+#if MPV_CLIENT_API_VERSION >= MPV_MAKE_VERSION(1, 106)
+void cancelStream(void *cookie) {
+    static_cast<Stream *>(cookie)->cancelled.store(true,
+                                                    std::memory_order_relaxed);
+}
+#endif
+
+bool openResource(Stream *stream, const QString &path) {
+    const QString resourcePath = QChar::fromLatin1(':') + path;
+    const QResource resource(resourcePath);
+    if (!resource.isValid()) {
+        return false;
+    }
+    // Uncompressed resources are plain memory, usually mapped from the
+    // executable.
+    if ((resource.compressionAlgorithm() == QResource::NoCompression) &&
+        (resource.data() != nullptr)) {
+        setMemory(stream, QByteArray::fromRawData(
+                              reinterpret_cast<const char *>(resource.data()),
+                              static_cast<int>(resource.size())));
+        return true;
+    }
+    stream->device = std::make_unique<QFile>(resourcePath);
+    return true;
+}
+
+bool openRegistered(Stream *stream, const QByteArray &location) {
+    const int slash = location.indexOf('/');
+    const QString name = QString::fromUtf8(location.left(slash)).toLower();
+    const QString path = (slash < 0)
+        ? QString()
+        : QUrl::fromPercentEncoding(location.mid(slash));
+    Source source;
+    {
+        Registry &sources = registry();
+        const QMutexLocker locker(&sources.mutex);
+        const auto it = sources.sources.constFind(name);
+        if (it == sources.sources.constEnd()) {
+            return false;
+        }
+        source = *it;
+    }
+    if (!source.factory) {
+        setMemory(stream, source.data);
+        return true;
+    }
+    stream->device.reset(source.factory(path));
+    return static_cast<bool>(stream->device);
+}
+
+bool openMapped(Stream *stream, const QByteArray &uri) {
+    QUrl url(QString::fromUtf8(uri));
+    url.setScheme(QString::fromUtf8("file"));
+    auto file = std::make_unique<QFile>(url.toLocalFile());
+    if (!file->open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        qWarning().noquote() << "Failed to open" << file->fileName() << ":"
+                             << file->errorString();
+        return false;
+    }
+    const qint64 size = file->size();
+    uchar *data = (size > 0) ? file->map(0, size) : nullptr;
+    if (data == nullptr) {
+        // Empty, not a regular file or too large for the address space,
+        // read it like any other device.
+        stream->device = std::move(file);
+        return true;
+    }
+    stream->data = reinterpret_cast<const char *>(data);
+    stream->size = size;
+    stream->mappedFile = std::move(file);
+    mapping().openFiles.fetch_add(1, std::memory_order_relaxed);
+#ifdef Q_OS_UNIX
+    adviseMapping(stream, 0, size, MADV_SEQUENTIAL);
+#endif
+#ifdef Q_OS_LINUX
+    adviseFile(stream, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    followReadPosition(stream);
+    return true;
+}
+
+int openStream(void *userData, char *uri, mpv_stream_cb_info *info) {
+    Q_UNUSED(userData)
+    const QByteArray url(uri);
+    auto stream = std::make_unique<Stream>();
+    bool found = false;
+    if (url.startsWith(resourcePrefix)) {
+        found = openResource(
+            stream.get(),
+            QString::fromUtf8(
+                url.mid(static_cast<int>(sizeof(resourcePrefix)) - 1)));
+    } else if (url.startsWith(streamPrefix)) {
+        found = openRegistered(
+            stream.get(), url.mid(static_cast<int>(sizeof(streamPrefix)) - 1));
+    } else if (url.startsWith(mappedPrefix)) {
+        found = openMapped(stream.get(), url);
+    }
+    if (!found) {
+        qWarning().noquote() << "Nothing to stream for:" << url;
+        return MPV_ERROR_LOADING_FAILED;
+    }
+    QIODevice *device = stream->device.get();
+    if (device != nullptr) {
+        // Unbuffered: mpv asks for large blocks, they go straight into its
+        // buffer instead of through QIODevice's small one.
+        if (!device->isOpen() &&
+            !device->open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            qWarning().noquote()
+                << "Failed to open" << url << ":" << device->errorString();
+            return MPV_ERROR_LOADING_FAILED;
+        }
+        if (!device->isReadable()) {
+            qWarning().noquote() << "Device for" << url << "is not readable.";
+            return MPV_ERROR_LOADING_FAILED;
+        }
+    }
+    info->read_fn = readStream;
+    // No seek function makes the stream unseekable for mpv.
+    info->seek_fn =
+        ((device != nullptr) && device->isSequential()) ? nullptr : seekStream;
+    info->size_fn = streamSize;
+    info->close_fn = closeStream;
+#if MPV_CLIENT_API_VERSION >= MPV_MAKE_VERSION(1, 106)
+    info->cancel_fn = cancelStream;
+#endif
+    info->cookie = stream.release();
+    return 0;
+}
+
+bool isValidName(const QString &name) {
+    return !name.isEmpty() && !name.contains(QChar::fromLatin1('/')) &&
+        !name.contains(QChar::fromLatin1(':'));
+}
+
+QUrl registerSource(const QString &name, const Source &source) {
+    if (!isValidName(name)) {
+        qWarning().noquote() << "Invalid stream name:" << name;
+        return QUrl();
+    }
+    Registry &sources = registry();
+    const QMutexLocker locker(&sources.mutex);
+    sources.sources.insert(name.toLower(), source);
+    return QUrl(QString::fromUtf8(streamPrefix) + name.toLower());
+}
+
+} // namespace
+
+MpvStreamSource::MpvStreamSource(QObject *parent) : QObject(parent) {}
+
+MpvStreamSource::~MpvStreamSource() = default;
+
+MpvStreamSource *MpvStreamSource::instance() {
+    static QPointer<MpvStreamSource> source;
+    if (source.isNull()) {
+        source = new MpvStreamSource(QCoreApplication::instance());
+    }
+    return source;
+}
+
+void MpvStreamSource::registerProtocols(mpv_handle *handle) {
+    if (handle == nullptr) {
+        return;
+    }
+    for (auto &&protocol :
+         {resourceProtocol, streamProtocol, mappedProtocol}) {
+        if (mpv_stream_cb_add_ro(handle, protocol, nullptr, openStream) < 0) {
+            qWarning().noquote()
+                << "Failed to register the stream protocol:" << protocol;
+        }
+    }
+}
+
+QString MpvStreamSource::mpvPath(const QUrl &url, bool visiblePlayer) {
+    if (url.isLocalFile()) {
+        if (visiblePlayer &&
+            mapping().mapLocalFiles.load(std::memory_order_relaxed)) {
+            return QString::fromUtf8(mappedPrefix) +
+                url.path(QUrl::FullyEncoded);
+        }
+        return url.toLocalFile();
+    }
+    // mpv only recognizes protocols followed by "://".
+    if (url.scheme() == QString::fromUtf8(resourceProtocol)) {
+        return QString::fromUtf8(resourcePrefix) + url.path();
+    }
+    return url.url();
+}
+
+QUrl MpvStreamSource::registerDevice(const QString &name,
+                                     const DeviceFactory &factory) {
+    if (!factory) {
+        return QUrl();
+    }
+    Source source;
+    source.factory = factory;
+    return registerSource(name, source);
+}
+
+QUrl MpvStreamSource::registerBuffer(const QString &name,
+                                     const QByteArray &data) {
+    Source source;
+    source.data = data;
+    return registerSource(name, source);
+}
+
+void MpvStreamSource::unregister(const QString &name) {
+    Registry &sources = registry();
+    const QMutexLocker locker(&sources.mutex);
+    sources.sources.remove(name.toLower());
+}
+
+bool MpvStreamSource::mapLocalFiles() const {
+    return mapping().mapLocalFiles.load(std::memory_order_relaxed);
+}
+
+qint64 MpvStreamSource::mapReadAhead() const {
+    return mapping().readAhead.load(std::memory_order_relaxed);
+}
+
+qint64 MpvStreamSource::mapKeepBehind() const {
+    return mapping().keepBehind.load(std::memory_order_relaxed);
+}
+
+void MpvStreamSource::setMapLocalFiles(bool mapLocalFiles) {
+    if (mapping().mapLocalFiles.exchange(mapLocalFiles) != mapLocalFiles) {
+        Q_EMIT mapLocalFilesChanged();
+    }
+}
+
+void MpvStreamSource::setMapReadAhead(qint64 mapReadAhead) {
+    mapReadAhead = qMax(mapReadAhead, qint64(0));
+    if (mapping().readAhead.exchange(mapReadAhead) != mapReadAhead) {
+        Q_EMIT mapReadAheadChanged();
+    }
+}
+
+void MpvStreamSource::setMapKeepBehind(qint64 mapKeepBehind) {
+    mapKeepBehind = qMax(mapKeepBehind, qint64(0));
+    if (mapping().keepBehind.exchange(mapKeepBehind) != mapKeepBehind) {
+        Q_EMIT mapKeepBehindChanged();
+    }
+}
+
+QVariantMap MpvStreamSource::mappingStatistics() const {
+    const MappingState &state = mapping();
+    QVariantMap map;
+    map[QString::fromUtf8("openFiles")] =
+        state.openFiles.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("bytesRead")] =
+        state.bytesRead.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("residentReads")] =
+        state.residentReads.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("faultingReads")] =
+        state.faultingReads.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("bytesPrefetched")] =
+        state.bytesPrefetched.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("bytesDropped")] =
+        state.bytesDropped.load(std::memory_order_relaxed);
+    map[QString::fromUtf8("seeks")] =
+        state.seeks.load(std::memory_order_relaxed);
+    return map;
+}
+
+bool MpvStreamSource::isRegistered(const QString &name) const {
+    Registry &sources = registry();
+    const QMutexLocker locker(&sources.mutex);
+    return sources.sources.contains(name.toLower());
+}
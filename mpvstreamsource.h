@@ -0,0 +1,101 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QUrl>
+#include <QVariant>
+#include <functional>
+#include <mpv/client.h>
+
+class QIODevice;
+
+// Lets mpv read media straight from Qt instead of from the file system,
+// through stream callbacks (mpv_stream_cb_add_ro()) registered for every
+// mpv handle of the plugin:
+//
+// qrc:/path/to/file - Qt resources. Uncompressed resources are read from
+// the memory they're mapped to, compressed ones through QFile.
+// qtstream://name/path - buffers and device factories registered here.
+// mmap:///path/to/file - local files, memory mapped. The kernel is told to
+// read ahead of the read position (madvise()/posix_fadvise() WILLNEED)
+// and what is further behind it than mapKeepBehind is dropped from the
+// mapping (madvise() DONTNEED), which keeps the player's own footprint
+// small. The page cache itself is left alone, other players and
+// MpvWarmUp may still need those pages. Used for the local files of the
+// visible players if mapLocalFiles is set.
+//
+// Buffers are shared with the caller (QByteArray is implicitly shared), so
+// nothing is copied or written to disk.
+class MpvStreamSource : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvStreamSource)
+
+    Q_PROPERTY(bool mapLocalFiles READ mapLocalFiles WRITE setMapLocalFiles
+                   NOTIFY mapLocalFilesChanged)
+    Q_PROPERTY(qint64 mapReadAhead READ mapReadAhead WRITE setMapReadAhead
+                   NOTIFY mapReadAheadChanged)
+    Q_PROPERTY(qint64 mapKeepBehind READ mapKeepBehind WRITE
+                   setMapKeepBehind NOTIFY mapKeepBehindChanged)
+
+public:
+    // Called on one of mpv's stream threads whenever mpv opens the stream,
+    // which may happen more than once per file and concurrently. path is the
+    // part of the url after the name (starting with '/', possibly empty).
+    // The returned device must not be open yet, or be open for reading; mpv
+    // takes ownership. Returning nullptr fails the load.
+    using DeviceFactory = std::function<QIODevice *(const QString &path)>;
+
+    explicit MpvStreamSource(QObject *parent = nullptr);
+    ~MpvStreamSource() override;
+
+    static MpvStreamSource *instance();
+
+    // Called by every mpv handle of the plugin after mpv_initialize(),
+    // there's no need to call it manually. Thread-safe.
+    static void registerProtocols(mpv_handle *handle);
+    // What to pass to loadfile for the given url. Local files are only
+    // mapped (see mapLocalFiles) for the visible players, the thumbnail,
+    // probe and standby handles read a few megabytes at most.
+    static QString mpvPath(const QUrl &url, bool visiblePlayer = false);
+
+    // Open the local files of the visible players through mmap:// instead
+    // of mpv's own file stream. Only affects files opened afterwards.
+    // mpv only autoloads external files for plain paths, so sub-auto and
+    // audio-file-auto don't apply to mapped files. Add the subtitles and
+    // audio files next to them explicitly ("sub-add", "audio-add"), see
+    // MpvMediaScanner for finding them.
+    bool mapLocalFiles() const;
+    // Bytes ahead of the read position the kernel is asked to prefetch.
+    qint64 mapReadAhead() const;
+    // Bytes behind the read position that are kept, zero keeps everything.
+    // mpv's demuxer cache holds what it needs itself, this is only there
+    // for seeking back.
+    qint64 mapKeepBehind() const;
+
+    void setMapLocalFiles(bool mapLocalFiles);
+    void setMapReadAhead(qint64 mapReadAhead);
+    void setMapKeepBehind(qint64 mapKeepBehind);
+
+    // Thread-safe. Names end up as the host of the url, so they're
+    // case-insensitive and should stick to letters, digits, '-' and '.'.
+    // Returns the url to open, empty if the name is invalid. Registering a
+    // name again replaces it.
+    QUrl registerDevice(const QString &name, const DeviceFactory &factory);
+
+public Q_SLOTS:
+    // Same as registerDevice(), served from the given data.
+    QUrl registerBuffer(const QString &name, const QByteArray &data);
+    // Streams that are already open keep working.
+    void unregister(const QString &name);
+    bool isRegistered(const QString &name) const;
+    // Counters of the mmap:// streams since startup: openFiles, bytesRead,
+    // residentReads and faultingReads (whether the data was in memory
+    // already when mpv read it, Linux only), bytesPrefetched,
+    // bytesDropped (from the mappings, not the page cache) and seeks.
+    QVariantMap mappingStatistics() const;
+
+Q_SIGNALS:
+    void mapLocalFilesChanged();
+    void mapReadAheadChanged();
+    void mapKeepBehindChanged();
+};
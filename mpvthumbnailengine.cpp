@@ -0,0 +1,281 @@
+#include "mpvthumbnailengine.h"
+#include "mpvheadlessplayer.h"
+#include "mpvspritesheetcache.h"
+
+#include <QCoreApplication>
+#include <QPointer>
+#include <QRunnable>
+#include <limits>
+
+class MpvThumbnailJob : public QRunnable {
+    Q_DISABLE_COPY_MOVE(MpvThumbnailJob)
+
+public:
+    MpvThumbnailJob(MpvThumbnailEngine *engine,
+                    const MpvThumbnailEngine::RequestPtr &request)
+        : engine(engine), request(request) {}
+    ~MpvThumbnailJob() override = default;
+
+    void run() override { engine->process(request); }
+
+private:
+    MpvThumbnailEngine *engine = nullptr;
+    MpvThumbnailEngine::RequestPtr request;
+};
+
+MpvThumbnailEngine::MpvThumbnailEngine(QObject *parent) : QObject(parent) {
+    cache.setMaxCost(32 * 1024 * 1024);
+    threadPool.setMaxThreadCount(currentPoolSize);
+}
+
+MpvThumbnailEngine::~MpvThumbnailEngine() {
+    // Whatever hasn't started yet is dropped, the running jobs still need
+    // the players and the cache.
+    threadPool.clear();
+    threadPool.waitForDone();
+}
+
+MpvThumbnailEngine *MpvThumbnailEngine::instance() {
+    static QPointer<MpvThumbnailEngine> engine;
+    if (engine.isNull()) {
+        engine = new MpvThumbnailEngine(QCoreApplication::instance());
+    }
+    return engine;
+}
+
+int MpvThumbnailEngine::poolSize() const { return currentPoolSize; }
+
+qint64 MpvThumbnailEngine::cacheLimit() const {
+    QMutexLocker locker(&mutex);
+    return cache.maxCost();
+}
+
+qint64 MpvThumbnailEngine::cacheUsage() const {
+    QMutexLocker locker(&mutex);
+    return cache.totalCost();
+}
+
+int MpvThumbnailEngine::thumbnailWidth() const {
+    QMutexLocker locker(&mutex);
+    return currentThumbnailWidth;
+}
+
+int MpvThumbnailEngine::timeBucket() const {
+    QMutexLocker locker(&mutex);
+    return currentTimeBucket;
+}
+
+void MpvThumbnailEngine::setPoolSize(int poolSize) {
+    poolSize = qMax(poolSize, 1);
+    if (poolSize == currentPoolSize) {
+        return;
+    }
+    currentPoolSize = poolSize;
+    threadPool.setMaxThreadCount(currentPoolSize);
+    {
+        QMutexLocker locker(&mutex);
+        while (idlePlayers.count() > currentPoolSize) {
+            idlePlayers.removeFirst();
+        }
+    }
+    Q_EMIT poolSizeChanged();
+}
+
+void MpvThumbnailEngine::setCacheLimit(qint64 cacheLimit) {
+    // QCache counts in int.
+    cacheLimit = qBound(qint64(0), cacheLimit,
+                        static_cast<qint64>(std::numeric_limits<int>::max()));
+    {
+        QMutexLocker locker(&mutex);
+        if (cacheLimit == cache.maxCost()) {
+            return;
+        }
+        cache.setMaxCost(static_cast<int>(cacheLimit));
+    }
+    Q_EMIT cacheLimitChanged();
+    Q_EMIT cacheUsageChanged();
+}
+
+void MpvThumbnailEngine::setThumbnailWidth(int thumbnailWidth) {
+    thumbnailWidth = qMax(thumbnailWidth, 0);
+    {
+        QMutexLocker locker(&mutex);
+        if (thumbnailWidth == currentThumbnailWidth) {
+            return;
+        }
+        currentThumbnailWidth = thumbnailWidth;
+        // Players and thumbnails of the old size are of no use anymore.
+        idlePlayers.clear();
+        cache.clear();
+    }
+    Q_EMIT thumbnailWidthChanged();
+    Q_EMIT cacheUsageChanged();
+}
+
+void MpvThumbnailEngine::setTimeBucket(int timeBucket) {
+    timeBucket = qMax(timeBucket, 1);
+    {
+        QMutexLocker locker(&mutex);
+        if (timeBucket == currentTimeBucket) {
+            return;
+        }
+        currentTimeBucket = timeBucket;
+        cache.clear();
+    }
+    Q_EMIT timeBucketChanged();
+    Q_EMIT cacheUsageChanged();
+}
+
+void MpvThumbnailEngine::request(const RequestPtr &request) {
+    if (request.isNull()) {
+        return;
+    }
+    // Precomputed sheets don't need any decoding at all.
+    const QImage sprite = MpvSpriteSheetCache::instance()->thumbnail(
+        request->source, static_cast<qreal>(request->position) / 1000.0);
+    if (!sprite.isNull()) {
+        if (request->finished) {
+            request->finished(sprite);
+        }
+        return;
+    }
+    int priority = 0;
+    {
+        QMutexLocker locker(&mutex);
+        const QImage *cached =
+            cache.object(cacheKey(request->source, request->position));
+        if (cached != nullptr) {
+            const QImage image = *cached;
+            locker.unlock();
+            if (request->finished) {
+                request->finished(image);
+            }
+            return;
+        }
+        priority = ++requestSerial;
+    }
+    threadPool.start(new MpvThumbnailJob(this, request), priority);
+}
+
+QUrl MpvThumbnailEngine::thumbnailSource(const QUrl &source,
+                                         qreal position) const {
+    if (!source.isValid()) {
+        return QUrl();
+    }
+    // Base64 survives the url handling of the QML engine unharmed, which
+    // can't be said about nested percent encoding.
+    return QUrl(QString::fromUtf8("image://mpvthumbnail/%1/%2")
+                    .arg(qRound64(qMax(position, 0.0) * 1000.0))
+                    .arg(QString::fromLatin1(source.toEncoded().toBase64(
+                        QByteArray::Base64UrlEncoding |
+                        QByteArray::OmitTrailingEquals))));
+}
+
+QImage MpvThumbnailEngine::cachedThumbnail(const QUrl &source,
+                                           qreal position) const {
+    QMutexLocker locker(&mutex);
+    const QImage *cached =
+        cache.object(cacheKey(source, qRound64(position * 1000.0)));
+    return (cached != nullptr) ? *cached : QImage();
+}
+
+void MpvThumbnailEngine::clearCache() {
+    {
+        QMutexLocker locker(&mutex);
+        cache.clear();
+    }
+    Q_EMIT cacheUsageChanged();
+}
+
+QString MpvThumbnailEngine::cacheKey(const QUrl &source,
+                                     qint64 position) const {
+    return source.toString() + QChar::fromLatin1('#') +
+        QString::number(position / currentTimeBucket);
+}
+
+qint64 MpvThumbnailEngine::bucketPosition(qint64 position) const {
+    return (qMax(position, qint64(0)) / currentTimeBucket) *
+        currentTimeBucket;
+}
+
+void MpvThumbnailEngine::process(const RequestPtr &request) {
+    QImage image;
+    QString key;
+    qint64 position = 0;
+    {
+        QMutexLocker locker(&mutex);
+        key = cacheKey(request->source, request->position);
+        position = bucketPosition(request->position);
+        // Another request for the same bucket may have been served in the
+        // meantime.
+        const QImage *cached = cache.object(key);
+        if (cached != nullptr) {
+            image = *cached;
+        }
+    }
+    if (image.isNull() && !request->cancelled) {
+        int decodedWidth = 0;
+        const QSharedPointer<MpvHeadlessPlayer> player =
+            acquirePlayer(request->source);
+        if (!player.isNull()) {
+            decodedWidth = player->width();
+            bool ok = player->source() == request->source;
+            if (!ok) {
+                ok = player->load(request->source);
+            }
+            // Loading may take a while, check again before decoding.
+            if (ok && !request->cancelled) {
+                if (player->seek(static_cast<qreal>(position) / 1000.0)) {
+                    image = player->grab();
+                }
+            }
+            releasePlayer(player);
+        }
+        if (!image.isNull()) {
+            {
+                QMutexLocker locker(&mutex);
+                // The width may have changed while decoding.
+                if (decodedWidth == currentThumbnailWidth) {
+                    cache.insert(key, new QImage(image),
+                                 static_cast<int>(image.sizeInBytes()));
+                }
+            }
+            QMetaObject::invokeMethod(this, "cacheUsageChanged",
+                                      Qt::QueuedConnection);
+        }
+    }
+    if (request->finished) {
+        request->finished(request->cancelled ? QImage() : image);
+    }
+}
+
+QSharedPointer<MpvHeadlessPlayer>
+MpvThumbnailEngine::acquirePlayer(const QUrl &source) {
+    int width = 0;
+    {
+        QMutexLocker locker(&mutex);
+        // One that has the file loaded already saves opening it again.
+        for (int i = 0; i != idlePlayers.count(); ++i) {
+            if (idlePlayers.at(i)->source() == source) {
+                return idlePlayers.takeAt(i);
+            }
+        }
+        if (!idlePlayers.isEmpty()) {
+            return idlePlayers.takeLast();
+        }
+        width = currentThumbnailWidth;
+    }
+    // The thread pool never runs more jobs than there are players allowed.
+    auto player = QSharedPointer<MpvHeadlessPlayer>::create(width);
+    return player->isValid() ? player : QSharedPointer<MpvHeadlessPlayer>();
+}
+
+void MpvThumbnailEngine::releasePlayer(
+    const QSharedPointer<MpvHeadlessPlayer> &player) {
+    QMutexLocker locker(&mutex);
+    if ((player->width() != currentThumbnailWidth) ||
+        (idlePlayers.count() >= threadPool.maxThreadCount())) {
+        return;
+    }
+    idlePlayers.append(player);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QUrl>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+class MpvHeadlessPlayer;
+
+// Seek bar previews for arbitrary positions of arbitrary files. Frames are
+// decoded by a small pool of headless mpv instances on worker threads and
+// kept in a byte bounded LRU cache, keyed by file and time bucket. The
+// newest request is always served first, and cancelled requests are
+// dropped before anything gets decoded, so sweeping over a seek bar only
+// decodes the positions that are still wanted.
+// QML reaches it through the "image://mpvthumbnail/" provider, see
+// thumbnailSource().
+class MpvThumbnailEngine : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvThumbnailEngine)
+
+    Q_PROPERTY(int poolSize READ poolSize WRITE setPoolSize NOTIFY
+                   poolSizeChanged)
+    Q_PROPERTY(qint64 cacheLimit READ cacheLimit WRITE setCacheLimit NOTIFY
+                   cacheLimitChanged)
+    Q_PROPERTY(qint64 cacheUsage READ cacheUsage NOTIFY cacheUsageChanged)
+    Q_PROPERTY(int thumbnailWidth READ thumbnailWidth WRITE setThumbnailWidth
+                   NOTIFY thumbnailWidthChanged)
+    Q_PROPERTY(int timeBucket READ timeBucket WRITE setTimeBucket NOTIFY
+                   timeBucketChanged)
+
+public:
+    struct Request {
+        QUrl source;
+        // In milliseconds.
+        qint64 position = 0;
+        std::atomic_bool cancelled{false};
+        // Invoked exactly once, on a worker thread (or right away if the
+        // thumbnail is cached). The image is null if the request was
+        // cancelled or failed.
+        std::function<void(const QImage &)> finished;
+    };
+    using RequestPtr = QSharedPointer<Request>;
+
+    explicit MpvThumbnailEngine(QObject *parent = nullptr);
+    ~MpvThumbnailEngine() override;
+
+    static MpvThumbnailEngine *instance();
+
+    // Maximum number of headless players (and decoding threads).
+    int poolSize() const;
+    // In bytes.
+    qint64 cacheLimit() const;
+    qint64 cacheUsage() const;
+    // Width of the decoded frames, the height follows the aspect ratio.
+    int thumbnailWidth() const;
+    // Positions within the same bucket (in milliseconds) share one
+    // thumbnail. Keyframe seeks can't be more precise anyway.
+    int timeBucket() const;
+
+    void setPoolSize(int poolSize);
+    void setCacheLimit(qint64 cacheLimit);
+    void setThumbnailWidth(int thumbnailWidth);
+    void setTimeBucket(int timeBucket);
+
+    // Thread-safe.
+    void request(const RequestPtr &request);
+
+public Q_SLOTS:
+    // Url for a QML Image showing the given position (in seconds).
+    QUrl thumbnailSource(const QUrl &source, qreal position) const;
+    // Thread-safe. Null if the thumbnail hasn't been decoded yet.
+    QImage cachedThumbnail(const QUrl &source, qreal position) const;
+    void clearCache();
+
+private:
+    friend class MpvThumbnailJob;
+
+    QString cacheKey(const QUrl &source, qint64 position) const;
+    qint64 bucketPosition(qint64 position) const;
+    void process(const RequestPtr &request);
+    QSharedPointer<MpvHeadlessPlayer> acquirePlayer(const QUrl &source);
+    void releasePlayer(const QSharedPointer<MpvHeadlessPlayer> &player);
+
+private:
+    mutable QMutex mutex;
+    QCache<QString, QImage> cache;
+    QVector<QSharedPointer<MpvHeadlessPlayer>> idlePlayers;
+    QThreadPool threadPool;
+    int currentPoolSize = 2;
+    int currentThumbnailWidth = 240;
+    int currentTimeBucket = 2000;
+    // Newer requests get a higher priority in the thread pool.
+    int requestSerial = 0;
+
+Q_SIGNALS:
+    void poolSizeChanged();
+    void cacheLimitChanged();
+    void cacheUsageChanged();
+    void thumbnailWidthChanged();
+    void timeBucketChanged();
+};
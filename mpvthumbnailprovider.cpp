@@ -0,0 +1,78 @@
+#include "mpvthumbnailprovider.h"
+#include "mpvthumbnailengine.h"
+
+namespace {
+
+class MpvThumbnailResponse : public QQuickImageResponse {
+    Q_DISABLE_COPY_MOVE(MpvThumbnailResponse)
+
+public:
+    MpvThumbnailResponse(const QString &id, const QSize &requestedSize) {
+        const int separator = id.indexOf(QChar::fromLatin1('/'));
+        bool ok = false;
+        const qint64 position =
+            (separator > 0) ? id.left(separator).toLongLong(&ok) : 0;
+        const QUrl source = ok
+            ? QUrl::fromEncoded(QByteArray::fromBase64(
+                  id.mid(separator + 1).toLatin1(),
+                  QByteArray::Base64UrlEncoding))
+            : QUrl();
+        if (!source.isValid()) {
+            error = QString::fromUtf8("Invalid thumbnail id: ") + id;
+            // The engine only listens once this constructor has returned.
+            QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+            return;
+        }
+        request = MpvThumbnailEngine::RequestPtr::create();
+        request->source = source;
+        request->position = position;
+        // The engine keeps this response alive until finished() has been
+        // emitted, even if it has been cancelled.
+        request->finished = [this, requestedSize](const QImage &result) {
+            if (result.isNull()) {
+                error = request->cancelled
+                    ? QString::fromUtf8("Cancelled.")
+                    : QString::fromUtf8("Failed to decode the thumbnail.");
+            } else if (requestedSize.isValid() &&
+                       ((result.width() > requestedSize.width()) ||
+                        (result.height() > requestedSize.height()))) {
+                image = result.scaled(requestedSize, Qt::KeepAspectRatio,
+                                      Qt::SmoothTransformation);
+            } else {
+                image = result;
+            }
+            QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+        };
+        MpvThumbnailEngine::instance()->request(request);
+    }
+    ~MpvThumbnailResponse() override = default;
+
+    QQuickTextureFactory *textureFactory() const override {
+        return QQuickTextureFactory::textureFactoryForImage(image);
+    }
+
+    QString errorString() const override { return error; }
+
+    void cancel() override {
+        if (!request.isNull()) {
+            request->cancelled = true;
+        }
+    }
+
+private:
+    MpvThumbnailEngine::RequestPtr request;
+    QImage image;
+    QString error;
+};
+
+} // namespace
+
+MpvThumbnailProvider::MpvThumbnailProvider() = default;
+
+MpvThumbnailProvider::~MpvThumbnailProvider() = default;
+
+QQuickImageResponse *
+MpvThumbnailProvider::requestImageResponse(const QString &id,
+                                           const QSize &requestedSize) {
+    return new MpvThumbnailResponse(id, requestedSize);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QQuickAsyncImageProvider>
+
+// Serves MpvThumbnailEngine's thumbnails to QML as
+// "image://mpvthumbnail/<position in ms>/<base64url encoded source>". Use
+// MpvThumbnailEngine::thumbnailSource() (or MpvObject::thumbnailSource())
+// instead of building such urls manually.
+// An Image that changes its source cancels the previous request, which is
+// what keeps fast mouse movement over a seek bar cheap.
+class MpvThumbnailProvider : public QQuickAsyncImageProvider {
+    Q_DISABLE_COPY_MOVE(MpvThumbnailProvider)
+
+public:
+    MpvThumbnailProvider();
+    ~MpvThumbnailProvider() override;
+
+    QQuickImageResponse *
+    requestImageResponse(const QString &id,
+                         const QSize &requestedSize) override;
+};
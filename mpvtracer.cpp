@@ -0,0 +1,436 @@
+#include "mpvtracer.h"
+#include "mpvhistogram.hpp"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QPointer>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+// Triggered traces cover the same ring content anyway.
+constexpr qint64 minimumTriggerInterval = 5000000000;
+
+void copyString(char *target, const char *source, size_t size) {
+    size_t length = 0;
+    if (source != nullptr) {
+        length = qstrnlen(source, static_cast<uint>(size - 1));
+        std::memcpy(target, source, length);
+    }
+    target[length] = '\0';
+}
+
+const char *categoryName(MpvTracer::Category category) {
+    switch (category) {
+    case MpvTracer::Category::Events:
+        return "events";
+    case MpvTracer::Category::Properties:
+        return "properties";
+    case MpvTracer::Category::Render:
+        return "render";
+    case MpvTracer::Category::Commands:
+        return "commands";
+    case MpvTracer::Category::Seek:
+        return "seek";
+    }
+    return "other";
+}
+
+void appendJsonString(QByteArray &json, const QByteArray &text) {
+    json += '"';
+    for (const char c : text) {
+        switch (c) {
+        case '"':
+            json += "\\\"";
+            break;
+        case '\\':
+            json += "\\\\";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                json += "\\u00";
+                json += QByteArray::number(static_cast<int>(c), 16)
+                            .rightJustified(2, '0');
+            } else {
+                json += c;
+            }
+            break;
+        }
+    }
+    json += '"';
+}
+
+// steady_clock nanoseconds to the trace format's microseconds.
+QByteArray microseconds(qint64 nanoseconds) {
+    return QByteArray::number(nanoseconds / 1000.0, 'f', 3);
+}
+
+} // namespace
+
+// Same seqlock as MpvLog's ring: zero while being written.
+struct MpvTracer::Event {
+    std::atomic<quint64> sequence{0};
+    qint64 timestamp = 0;
+    // -1 for instants.
+    qint64 duration = -1;
+    int threadId = 0;
+    Category category = Category::Events;
+    char name[32] = {};
+    char detail[48] = {};
+};
+
+// Written by its owning thread only. Never freed, threads that are gone
+// hand theirs to new ones, so there are never more buffers than threads
+// that were recording at the same time.
+struct MpvTracer::ThreadBuffer {
+    std::unique_ptr<Event[]> events{new Event[ringSize]};
+    std::atomic<quint64> head{0};
+    std::atomic<quint64> clearedSequence{0};
+    std::atomic_bool inUse{true};
+    int threadId = 0;
+};
+
+struct MpvTracer::RecordedEvent {
+    qint64 timestamp = 0;
+    qint64 duration = -1;
+    int threadId = 0;
+    Category category = Category::Events;
+    QByteArray name;
+    QByteArray detail;
+};
+
+struct MpvTracer::Snapshot {
+    QVector<RecordedEvent> events;
+    QHash<int, QString> threadNames;
+};
+
+namespace {
+
+struct ThreadBufferOwner {
+    void *buffer = nullptr;
+    std::atomic_bool *inUse = nullptr;
+    ~ThreadBufferOwner() {
+        if (inUse != nullptr) {
+            inUse->store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadBufferOwner threadBufferOwner;
+
+} // namespace
+
+std::atomic_bool MpvTracer::recording{false};
+std::atomic<MpvTracer *> MpvTracer::currentTracer{nullptr};
+
+MpvTracer::MpvTracer(QObject *parent)
+    : QObject(parent),
+      currentTraceDirectory(
+          QStandardPaths::writableLocation(QStandardPaths::TempLocation)) {
+    currentTracer.store(this, std::memory_order_release);
+}
+
+MpvTracer::~MpvTracer() {
+    recording.store(false, std::memory_order_relaxed);
+    currentTracer.store(nullptr, std::memory_order_release);
+}
+
+MpvTracer *MpvTracer::instance() {
+    static QPointer<MpvTracer> tracer;
+    if (tracer.isNull()) {
+        tracer = new MpvTracer(QCoreApplication::instance());
+    }
+    return tracer;
+}
+
+void MpvTracer::instant(Category category, const char *name,
+                        const char *detail) {
+    if (!isEnabled()) {
+        return;
+    }
+    record(category, name, detail, steadyClockNanoseconds(), -1);
+}
+
+void MpvTracer::complete(Category category, const char *name,
+                         qint64 startTime, qint64 endTime,
+                         const char *detail) {
+    if (!isEnabled()) {
+        return;
+    }
+    record(category, name, detail, startTime,
+           qMax(endTime - startTime, qint64(0)));
+}
+
+bool MpvTracer::enabled() const { return isEnabled(); }
+
+bool MpvTracer::triggerOnFrameDrop() const {
+    return currentTriggerOnFrameDrop;
+}
+
+QString MpvTracer::traceDirectory() const { return currentTraceDirectory; }
+
+void MpvTracer::setEnabled(bool enabled) {
+    if (enabled == isEnabled()) {
+        return;
+    }
+    recording.store(enabled, std::memory_order_relaxed);
+    Q_EMIT enabledChanged();
+}
+
+void MpvTracer::setTriggerOnFrameDrop(bool trigger) {
+    if (trigger == currentTriggerOnFrameDrop) {
+        return;
+    }
+    currentTriggerOnFrameDrop = trigger;
+    Q_EMIT triggerOnFrameDropChanged();
+}
+
+void MpvTracer::setTraceDirectory(const QString &directory) {
+    if (directory == currentTraceDirectory) {
+        return;
+    }
+    currentTraceDirectory = directory;
+    Q_EMIT traceDirectoryChanged();
+}
+
+void MpvTracer::frameDropped() {
+    if (!isEnabled() || !currentTriggerOnFrameDrop) {
+        return;
+    }
+    const qint64 now = steadyClockNanoseconds();
+    if ((lastTriggerTime != 0) &&
+        ((now - lastTriggerTime) < minimumTriggerInterval)) {
+        return;
+    }
+    lastTriggerTime = now;
+    trigger(QString::fromUtf8("frame drop"));
+}
+
+QByteArray MpvTracer::traceJson() const { return toJson(snapshot()); }
+
+bool MpvTracer::writeTrace(const QString &filePath) const {
+    QSaveFile file(filePath);
+    if (!file.open(QFile::WriteOnly)) {
+        qWarning().noquote() << "Failed to write a trace to" << filePath;
+        return false;
+    }
+    file.write(traceJson());
+    return file.commit();
+}
+
+void MpvTracer::trigger(const QString &reason) {
+    const QString filePath =
+        QDir(currentTraceDirectory)
+            .filePath(QString::fromUtf8("quickmpv-trace-%1.json")
+                          .arg(QDateTime::currentDateTime().toString(
+                              QString::fromUtf8("yyyyMMdd-hhmmss-zzz"))));
+    // Only the copy is made here, turning it into JSON takes longer.
+    const auto events = std::make_shared<Snapshot>(snapshot());
+    const QPointer<MpvTracer> guard(this);
+    QThreadPool::globalInstance()->start([events, filePath, reason, guard]() {
+        QSaveFile file(filePath);
+        bool written = false;
+        if (file.open(QFile::WriteOnly)) {
+            file.write(toJson(*events));
+            written = file.commit();
+        }
+        if (!written) {
+            qWarning().noquote() << "Failed to write a trace to" << filePath;
+        }
+        QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [guard, filePath, reason, written]() {
+                if (!guard.isNull()) {
+                    Q_EMIT guard->traceWritten(
+                        written ? filePath : QString(), reason);
+                }
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void MpvTracer::clear() {
+    QMutexLocker locker(&buffersMutex);
+    for (auto &&buffer : std::as_const(buffers)) {
+        buffer->clearedSequence.store(
+            buffer->head.load(std::memory_order_acquire),
+            std::memory_order_relaxed);
+    }
+}
+
+MpvTracer::ThreadBuffer *MpvTracer::threadBuffer() {
+    if (threadBufferOwner.buffer != nullptr) {
+        return static_cast<ThreadBuffer *>(threadBufferOwner.buffer);
+    }
+    MpvTracer *tracer = currentTracer.load(std::memory_order_acquire);
+    if (tracer == nullptr) {
+        return nullptr;
+    }
+    QThread *thread = QThread::currentThread();
+    QString threadName = thread->objectName();
+    if ((QCoreApplication::instance() != nullptr) &&
+        (thread == QCoreApplication::instance()->thread())) {
+        threadName = QString::fromUtf8("GUI thread");
+    }
+    QMutexLocker locker(&tracer->buffersMutex);
+    ThreadBuffer *buffer = nullptr;
+    for (auto &&candidate : std::as_const(tracer->buffers)) {
+        bool expected = false;
+        if (candidate->inUse.compare_exchange_strong(
+                expected, true, std::memory_order_acq_rel)) {
+            buffer = candidate;
+            break;
+        }
+    }
+    if (buffer == nullptr) {
+        buffer = new ThreadBuffer;
+        tracer->buffers.append(buffer);
+    }
+    buffer->threadId = tracer->nextThreadId++;
+    tracer->threadNames.insert(
+        buffer->threadId,
+        threadName.isEmpty()
+            ? QString::fromUtf8("Thread %1").arg(buffer->threadId)
+            : threadName);
+    threadBufferOwner.buffer = buffer;
+    threadBufferOwner.inUse = &buffer->inUse;
+    return buffer;
+}
+
+void MpvTracer::record(Category category, const char *name,
+                       const char *detail, qint64 timestamp,
+                       qint64 duration) {
+    ThreadBuffer *buffer = threadBuffer();
+    if (buffer == nullptr) {
+        return;
+    }
+    // Only this thread writes to the buffer.
+    const quint64 sequence = buffer->head.load(std::memory_order_relaxed) + 1;
+    Event &event = buffer->events[(sequence - 1) & (ringSize - 1)];
+    event.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.timestamp = timestamp;
+    event.duration = duration;
+    event.threadId = buffer->threadId;
+    event.category = category;
+    copyString(event.name, name, sizeof(event.name));
+    copyString(event.detail, detail, sizeof(event.detail));
+    event.sequence.store(sequence, std::memory_order_release);
+    buffer->head.store(sequence, std::memory_order_release);
+}
+
+MpvTracer::Snapshot MpvTracer::snapshot() const {
+    static_assert((ringSize & (ringSize - 1)) == 0,
+                  "The ring size must be a power of two.");
+    Snapshot result;
+    QMutexLocker locker(&buffersMutex);
+    result.threadNames = threadNames;
+    for (auto &&buffer : std::as_const(buffers)) {
+        const quint64 last = buffer->head.load(std::memory_order_acquire);
+        quint64 first =
+            buffer->clearedSequence.load(std::memory_order_relaxed) + 1;
+        if (last > static_cast<quint64>(ringSize)) {
+            first = qMax(first, last - ringSize + 1);
+        }
+        for (quint64 sequence = first; sequence <= last; ++sequence) {
+            const Event &event =
+                buffer->events[(sequence - 1) & (ringSize - 1)];
+            if (event.sequence.load(std::memory_order_acquire) != sequence) {
+                continue;
+            }
+            RecordedEvent copy;
+            copy.timestamp = event.timestamp;
+            copy.duration = event.duration;
+            copy.threadId = event.threadId;
+            copy.category = event.category;
+            char name[sizeof(event.name)];
+            char detail[sizeof(event.detail)];
+            std::memcpy(name, event.name, sizeof(name));
+            std::memcpy(detail, event.detail, sizeof(detail));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (event.sequence.load(std::memory_order_relaxed) != sequence) {
+                continue;
+            }
+            name[sizeof(name) - 1] = '\0';
+            detail[sizeof(detail) - 1] = '\0';
+            copy.name = QByteArray(name);
+            copy.detail = QByteArray(detail);
+            result.events.append(copy);
+        }
+    }
+    std::sort(result.events.begin(), result.events.end(),
+              [](const RecordedEvent &lhs, const RecordedEvent &rhs) {
+                  return lhs.timestamp < rhs.timestamp;
+              });
+    return result;
+}
+
+QByteArray MpvTracer::toJson(const Snapshot &snapshot) {
+    const QByteArray pid =
+        QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray json;
+    json.reserve(snapshot.events.count() * 128);
+    json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    const auto separator = [&json, &first]() {
+        if (!first) {
+            json += ",\n";
+        }
+        first = false;
+    };
+    for (auto it = snapshot.threadNames.cbegin();
+         it != snapshot.threadNames.cend(); ++it) {
+        separator();
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid +
+            ",\"tid\":" + QByteArray::number(it.key()) +
+            ",\"args\":{\"name\":";
+        appendJsonString(json, it.value().toUtf8());
+        json += "}}";
+    }
+    for (auto &&event : std::as_const(snapshot.events)) {
+        separator();
+        json += "{\"name\":";
+        appendJsonString(json, event.name);
+        json += ",\"cat\":\"";
+        json += categoryName(event.category);
+        json += "\",\"pid\":" + pid +
+            ",\"tid\":" + QByteArray::number(event.threadId) +
+            ",\"ts\":" + microseconds(event.timestamp);
+        if (event.duration < 0) {
+            json += ",\"ph\":\"i\",\"s\":\"t\"";
+        } else {
+            json += ",\"ph\":\"X\",\"dur\":" + microseconds(event.duration);
+        }
+        if (!event.detail.isEmpty()) {
+            json += ",\"args\":{\"detail\":";
+            appendJsonString(json, event.detail);
+            json += '}';
+        }
+        json += '}';
+    }
+    json += "]}\n";
+    return json;
+}
+
+MpvTraceSpan::MpvTraceSpan(MpvTracer::Category category, const char *name,
+                           const char *detail)
+    : spanCategory(category), spanName(name), spanDetail(detail) {
+    if (MpvTracer::isEnabled()) {
+        startTime = steadyClockNanoseconds();
+    }
+}
+
+MpvTraceSpan::~MpvTraceSpan() {
+    if (startTime != 0) {
+        MpvTracer::complete(spanCategory, spanName, startTime,
+                            steadyClockNanoseconds(), spanDetail);
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+#include <atomic>
+
+// Opt-in flight recorder for player timelines. Spans and instants go into
+// a ring buffer of the recording thread (lock-free, no allocation after
+// the first event of a thread), so the GUI and the render thread never
+// contend. The buffers can be written as Chrome trace JSON, which Perfetto
+// and about:tracing load, either on request or automatically when a
+// player drops a frame. While disabled, every recording site costs one
+// relaxed atomic load.
+class MpvTracer : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvTracer)
+
+    Q_PROPERTY(bool enabled READ enabled WRITE setEnabled NOTIFY
+                   enabledChanged)
+    Q_PROPERTY(bool triggerOnFrameDrop READ triggerOnFrameDrop WRITE
+                   setTriggerOnFrameDrop NOTIFY triggerOnFrameDropChanged)
+    Q_PROPERTY(QString traceDirectory READ traceDirectory WRITE
+                   setTraceDirectory NOTIFY traceDirectoryChanged)
+
+public:
+    enum class Category { Events, Properties, Render, Commands, Seek };
+
+    // Events kept per thread, the oldest ones are overwritten.
+    static constexpr int ringSize = 16384;
+
+    explicit MpvTracer(QObject *parent = nullptr);
+    ~MpvTracer() override;
+
+    static MpvTracer *instance();
+
+    static bool isEnabled() {
+        return recording.load(std::memory_order_relaxed);
+    }
+    // Both are no-ops while tracing is disabled. Names and details are
+    // copied (and truncated), they don't have to outlive the call.
+    // Timestamps are steady_clock nanoseconds.
+    static void instant(Category category, const char *name,
+                        const char *detail = nullptr);
+    static void complete(Category category, const char *name,
+                         qint64 startTime, qint64 endTime,
+                         const char *detail = nullptr);
+
+    bool enabled() const;
+    // Write a trace when a player reports a dropped frame, at most once
+    // every few seconds.
+    bool triggerOnFrameDrop() const;
+    // Where triggered traces go, the temporary directory by default.
+    QString traceDirectory() const;
+
+    void setEnabled(bool enabled);
+    void setTriggerOnFrameDrop(bool trigger);
+    void setTraceDirectory(const QString &directory);
+
+    // Called by MpvObject.
+    void frameDropped();
+
+public Q_SLOTS:
+    // Everything recorded so far, as Chrome trace JSON.
+    QByteArray traceJson() const;
+    bool writeTrace(const QString &filePath) const;
+    // Writes a trace into traceDirectory in the background, see
+    // traceWritten().
+    void trigger(const QString &reason = QString());
+    void clear();
+
+private:
+    struct Event;
+    struct ThreadBuffer;
+    struct RecordedEvent;
+    struct Snapshot;
+
+    static ThreadBuffer *threadBuffer();
+    static void record(Category category, const char *name,
+                       const char *detail, qint64 timestamp,
+                       qint64 duration);
+    // Copies everything out of the rings, cheap enough for the GUI thread.
+    Snapshot snapshot() const;
+    static QByteArray toJson(const Snapshot &snapshot);
+
+private:
+    static std::atomic_bool recording;
+    static std::atomic<MpvTracer *> currentTracer;
+
+    mutable QMutex buffersMutex;
+    // Buffers of finished threads are handed to new ones.
+    QVector<ThreadBuffer *> buffers;
+    QHash<int, QString> threadNames;
+    int nextThreadId = 1;
+    bool currentTriggerOnFrameDrop = false;
+    QString currentTraceDirectory;
+    qint64 lastTriggerTime = 0;
+
+Q_SIGNALS:
+    void enabledChanged();
+    void triggerOnFrameDropChanged();
+    void traceDirectoryChanged();
+    // filePath is empty if writing failed.
+    void traceWritten(const QString &filePath, const QString &reason);
+};
+
+// Records the lifetime of the object as a span. The name and the detail
+// must stay valid until then.
+class MpvTraceSpan {
+    Q_DISABLE_COPY_MOVE(MpvTraceSpan)
+
+public:
+    MpvTraceSpan(MpvTracer::Category category, const char *name,
+                 const char *detail = nullptr);
+    ~MpvTraceSpan();
+
+private:
+    MpvTracer::Category spanCategory;
+    const char *spanName = nullptr;
+    const char *spanDetail = nullptr;
+    // Zero if tracing was disabled at construction.
+    qint64 startTime = 0;
+};
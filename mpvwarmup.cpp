@@ -0,0 +1,228 @@
+#include "mpvwarmup.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPointer>
+#include <QThread>
+#include <memory>
+
+namespace {
+
+// Bytes read at once, small enough for the throttling to be smooth.
+constexpr qint64 chunkSize = 256 * 1024;
+
+QPointer<MpvWarmUp> warmUpInstance;
+
+} // namespace
+
+MpvWarmUp::MpvWarmUp(QObject *parent) : QObject(parent) {
+    // One file after the other, the bandwidth limit is for all of them.
+    threadPool.setMaxThreadCount(1);
+}
+
+MpvWarmUp::~MpvWarmUp() {
+    stopping = true;
+    threadPool.clear();
+    threadPool.waitForDone();
+}
+
+MpvWarmUp *MpvWarmUp::instance() {
+    if (warmUpInstance.isNull()) {
+        warmUpInstance = new MpvWarmUp(QCoreApplication::instance());
+    }
+    return warmUpInstance;
+}
+
+bool MpvWarmUp::hasPendingChecks() {
+    if (warmUpInstance.isNull()) {
+        return false;
+    }
+    QMutexLocker locker(&warmUpInstance->mutex);
+    return !warmUpInstance->files.isEmpty();
+}
+
+qint64 MpvWarmUp::bandwidthLimit() const { return currentBandwidthLimit; }
+
+qint64 MpvWarmUp::headBytes() const { return currentHeadBytes; }
+
+qint64 MpvWarmUp::tailBytes() const { return currentTailBytes; }
+
+void MpvWarmUp::setBandwidthLimit(qint64 bandwidthLimit) {
+    bandwidthLimit = qMax(bandwidthLimit, qint64(0));
+    if (currentBandwidthLimit.exchange(bandwidthLimit) != bandwidthLimit) {
+        Q_EMIT bandwidthLimitChanged();
+    }
+}
+
+void MpvWarmUp::setHeadBytes(qint64 headBytes) {
+    headBytes = qMax(headBytes, qint64(0));
+    if (currentHeadBytes.exchange(headBytes) != headBytes) {
+        Q_EMIT headBytesChanged();
+    }
+}
+
+void MpvWarmUp::setTailBytes(qint64 tailBytes) {
+    tailBytes = qMax(tailBytes, qint64(0));
+    if (currentTailBytes.exchange(tailBytes) != tailBytes) {
+        Q_EMIT tailBytesChanged();
+    }
+}
+
+void MpvWarmUp::recordLoad(const QUrl &url) {
+    const QString path = localPath(url);
+    if (path.isEmpty()) {
+        return;
+    }
+    bool hit = false;
+    {
+        QMutexLocker locker(&mutex);
+        const auto it = files.constFind(path);
+        if (it == files.constEnd()) {
+            return;
+        }
+        hit = (*it == State::Warm);
+        // Only the first load after warming counts.
+        files.erase(it);
+        fileOrder.removeOne(path);
+        if (hit) {
+            ++hits;
+        } else {
+            ++misses;
+        }
+    }
+    Q_EMIT loadChecked(url, hit);
+}
+
+bool MpvWarmUp::warm(const QUrl &url) {
+    const QString path = localPath(url);
+    if (path.isEmpty()) {
+        return false;
+    }
+    {
+        QMutexLocker locker(&mutex);
+        if (files.contains(path)) {
+            return true;
+        }
+        files.insert(path, State::Queued);
+        fileOrder.append(path);
+        while (fileOrder.count() > maximumFiles) {
+            files.remove(fileOrder.takeFirst());
+        }
+    }
+    ++requested;
+    threadPool.start([this, path]() { warmFile(path); });
+    return true;
+}
+
+bool MpvWarmUp::isWarm(const QUrl &url) const {
+    QMutexLocker locker(&mutex);
+    return files.value(localPath(url), State::Queued) == State::Warm;
+}
+
+QVariantMap MpvWarmUp::statistics() const {
+    QVariantMap map;
+    map[QString::fromUtf8("requested")] = requested.load();
+    map[QString::fromUtf8("warmed")] = warmed.load();
+    map[QString::fromUtf8("failed")] = failed.load();
+    map[QString::fromUtf8("bytesRead")] = bytesRead.load();
+    QMutexLocker locker(&mutex);
+    map[QString::fromUtf8("hits")] = hits;
+    map[QString::fromUtf8("misses")] = misses;
+    return map;
+}
+
+QString MpvWarmUp::localPath(const QUrl &url) {
+    if (url.isLocalFile()) {
+        return url.toLocalFile();
+    }
+    // See MpvStreamSource.
+    if (url.scheme() == QString::fromUtf8("mmap")) {
+        QUrl file = url;
+        file.setScheme(QString::fromUtf8("file"));
+        return file.toLocalFile();
+    }
+    return QString();
+}
+
+void MpvWarmUp::warmFile(const QString &path) {
+    if (stopping) {
+        return;
+    }
+    setState(path, State::Warming);
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        qWarning().noquote() << "Failed to warm up" << path << ":"
+                             << file.errorString();
+        ++failed;
+        setState(path, State::Failed);
+        return;
+    }
+    const qint64 size = file.size();
+    const qint64 headEnd = qMin(currentHeadBytes.load(), size);
+    const qint64 tailStart = qMax(headEnd, size - currentTailBytes.load());
+    // Reading is what brings the pages in, on every platform. Unlike
+    // posix_fadvise(WILLNEED), it can also be throttled.
+    const auto buffer = std::make_unique<char[]>(chunkSize);
+    QElapsedTimer timer;
+    timer.start();
+    qint64 total = 0;
+    bool ok = true;
+    for (auto &&range : {qMakePair(qint64(0), headEnd),
+                         qMakePair(tailStart, size)}) {
+        if (!ok || (range.first >= range.second) ||
+            !file.seek(range.first)) {
+            continue;
+        }
+        for (qint64 offset = range.first; ok && (offset < range.second);) {
+            if (stopping) {
+                return;
+            }
+            const qint64 count = file.read(
+                buffer.get(), qMin(chunkSize, range.second - offset));
+            if (count <= 0) {
+                ok = (count == 0);
+                break;
+            }
+            offset += count;
+            total += count;
+            bytesRead += static_cast<quint64>(count);
+            const qint64 limit = currentBandwidthLimit.load();
+            if (limit <= 0) {
+                continue;
+            }
+            // In short naps, so that shutting down doesn't have to wait.
+            const qint64 due = (total * 1000) / limit;
+            while (!stopping && (due > timer.elapsed())) {
+                QThread::msleep(static_cast<unsigned long>(
+                    qMin(due - timer.elapsed(), qint64(100))));
+            }
+        }
+    }
+    if (!ok) {
+        qWarning().noquote() << "Failed to warm up" << path << ":"
+                             << file.errorString();
+        ++failed;
+        setState(path, State::Failed);
+        return;
+    }
+    ++warmed;
+    setState(path, State::Warm);
+    const qint64 duration = timer.elapsed();
+    QMetaObject::invokeMethod(
+        this,
+        [this, path, total, duration]() {
+            Q_EMIT fileWarmed(QUrl::fromLocalFile(path), total, duration);
+        },
+        Qt::QueuedConnection);
+}
+
+void MpvWarmUp::setState(const QString &path, State state) {
+    QMutexLocker locker(&mutex);
+    // Forgotten in the meantime, or already loaded.
+    const auto it = files.find(path);
+    if (it != files.end()) {
+        *it = state;
+    }
+}
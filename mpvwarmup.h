@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+#include <QUrl>
+#include <QVariant>
+#include <QVector>
+#include <atomic>
+
+// Pulls the beginning and the end of local files (where containers keep
+// their headers and indexes, followed by the first GOPs) into the page
+// cache before they are played, so that the next item of a playlist on
+// slow storage starts as fast as the current one. Files are read one at a
+// time on a background thread, throttled to bandwidthLimit so that the
+// file that is playing right now is never starved.
+// Players report every file they load, which tells whether warming it
+// paid off (see loadChecked()).
+class MpvWarmUp : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MpvWarmUp)
+
+    Q_PROPERTY(qint64 bandwidthLimit READ bandwidthLimit WRITE
+                   setBandwidthLimit NOTIFY bandwidthLimitChanged)
+    Q_PROPERTY(qint64 headBytes READ headBytes WRITE setHeadBytes NOTIFY
+                   headBytesChanged)
+    Q_PROPERTY(qint64 tailBytes READ tailBytes WRITE setTailBytes NOTIFY
+                   tailBytesChanged)
+
+public:
+    explicit MpvWarmUp(QObject *parent = nullptr);
+    ~MpvWarmUp() override;
+
+    static MpvWarmUp *instance();
+    // Whether a file passed to warm() hasn't been loaded yet, recordLoad()
+    // has nothing to check otherwise. Doesn't create the instance.
+    static bool hasPendingChecks();
+
+    // In bytes per second, zero means unlimited.
+    qint64 bandwidthLimit() const;
+    // How much of the beginning and of the end of each file is read.
+    qint64 headBytes() const;
+    qint64 tailBytes() const;
+
+    void setBandwidthLimit(qint64 bandwidthLimit);
+    void setHeadBytes(qint64 headBytes);
+    void setTailBytes(qint64 tailBytes);
+
+    // Called by MpvObject for every file it loads.
+    void recordLoad(const QUrl &url);
+
+public Q_SLOTS:
+    // Local files only (including mmap:// urls). Files warmed or queued
+    // already are not read again.
+    bool warm(const QUrl &url);
+    bool isWarm(const QUrl &url) const;
+    // requested, warmed, failed, bytesRead, hits and misses since startup.
+    QVariantMap statistics() const;
+
+private:
+    enum class State { Queued, Warming, Warm, Failed };
+
+    static QString localPath(const QUrl &url);
+    void warmFile(const QString &path);
+    void setState(const QString &path, State state);
+
+private:
+    // Files remembered at most, the oldest ones are forgotten first.
+    static constexpr int maximumFiles = 64;
+
+    mutable QMutex mutex;
+    QHash<QString, State> files;
+    QVector<QString> fileOrder;
+    QThreadPool threadPool;
+    std::atomic<qint64> currentBandwidthLimit{32 * 1024 * 1024};
+    std::atomic<qint64> currentHeadBytes{8 * 1024 * 1024};
+    std::atomic<qint64> currentTailBytes{1024 * 1024};
+    std::atomic_bool stopping{false};
+    std::atomic<quint64> requested{0};
+    std::atomic<quint64> warmed{0};
+    std::atomic<quint64> failed{0};
+    std::atomic<quint64> bytesRead{0};
+    quint64 hits = 0;
+    quint64 misses = 0;
+
+Q_SIGNALS:
+    void bandwidthLimitChanged();
+    void headBytesChanged();
+    void tailBytesChanged();
+    // A file has been read, duration is in milliseconds.
+    void fileWarmed(const QUrl &url, qint64 bytes, qint64 duration);
+    // A file that had been passed to warm() was loaded by a player. hit is
+    // false if warming it hadn't finished (or had failed) by then.
+    void loadChecked(const QUrl &url, bool hit);
+};
@@ -1,3 +1,16 @@
+#include "mpvframecapture.h"
+#include "mpvloadstatistics.h"
+#include "mpvlog.h"
+#include "mpvmediaprobe.h"
+#include "mpvmemorybudget.h"
+#include "mpvmetrics.h"
+#include "mpvspritesheetcache.h"
+#include "mpvstreamsource.h"
+#include "mpvthumbnailengine.h"
+#include "mpvthumbnailprovider.h"
+#include "mpvtracer.h"
+#include "mpvwarmup.h"
+#include <QQmlEngine>
 #include <QQmlEngineExtensionPlugin>
 
 extern void qml_register_types_wangwenx190_QuickMpv();
@@ -14,6 +27,40 @@ public:
         Q_UNUSED(registration)
     }
     ~MpvDeclarativeWrapper() override = default;
+
+    void initializeEngine(QQmlEngine *engine, const char *uri) override {
+        // The engine takes ownership.
+        engine->addImageProvider(QString::fromUtf8("mpvthumbnail"),
+                                 new MpvThumbnailProvider);
+        // These objects are shared by all players of the process, so they
+        // can't be created by the QML engine itself.
+        static bool singletonsRegistered = false;
+        if (!singletonsRegistered) {
+            singletonsRegistered = true;
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvMemoryBudget",
+                                         MpvMemoryBudget::instance());
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvLoadStatistics",
+                                         MpvLoadStatistics::instance());
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvThumbnailEngine",
+                                         MpvThumbnailEngine::instance());
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvSpriteSheetCache",
+                                         MpvSpriteSheetCache::instance());
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvFrameCapture",
+                                         MpvFrameCapture::instance());
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvMetrics",
+                                         MpvMetrics::instance());
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvLog",
+                                         MpvLog::instance());
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvTracer",
+                                         MpvTracer::instance());
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvStreamSource",
+                                         MpvStreamSource::instance());
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvWarmUp",
+                                         MpvWarmUp::instance());
+            qmlRegisterSingletonInstance(uri, 1, 0, "MpvMediaProbe",
+                                         MpvMediaProbe::instance());
+        }
+    }
 };
 
 #include "plugin.moc"